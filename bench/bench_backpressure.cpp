@@ -0,0 +1,145 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 不读取回复的客户端对服务器内存的影响
+// 用法：bench_backpressure [秒数] [值的大小]
+// 在进程内启动服务器，客户端写入一个较大的值后不断地以 pipeline 发送 GET 但不读取
+// 回复，打印进程的 RSS 变化，最后读取所有回复
+
+#include <fcntl.h>
+#include <fmt/core.h>
+
+#include <chrono>
+#include <config.hpp>
+#include <cstdlib>
+#include <db/inst.hpp>
+#include <fstream>
+#include <future>
+#include <net/loop.hpp>
+#include <server/server.hpp>
+#include <string>
+#include <thread>
+
+#include "load.hpp"
+
+using fmt::print;
+using mydss::ServerConfig;
+using mydss::bench::Connect;
+using mydss::bench::Encode;
+using mydss::db::Inst;
+using mydss::net::InetType;
+using mydss::net::Loop;
+using mydss::server::Server;
+using std::promise;
+using std::string;
+using std::thread;
+using std::chrono::steady_clock;
+
+static constexpr uint16_t kPort = 16581;
+
+static void StartServer() {
+  promise<void> started;
+  auto future = started.get_future();
+  thread([&started] {
+    auto loop = Loop::New();
+    ServerConfig config;
+    config.set_type(InetType::kIPv4);
+    config.set_ip("127.0.0.1");
+    config.set_port(kPort);
+
+    auto server = Server::New(loop, config);
+    auto status = server->Start();
+    if (status.error()) {
+      print("start server failed: {}\n", status.ToString());
+      exit(EXIT_FAILURE);
+    }
+    started.set_value();
+    loop->Run();
+  }).detach();
+  future.get();
+}
+
+// 当前进程的 RSS，单位为 MiB
+static long RssMiB() {
+  std::ifstream in("/proc/self/status");
+  string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 6, "VmRSS:") == 0) {
+      return atol(line.c_str() + 6) / 1024;
+    }
+  }
+  return -1;
+}
+
+int main(int argc, char** argv) {
+  int secs = argc > 1 ? atoi(argv[1]) : 3;
+  size_t value_size = argc > 2 ? atol(argv[2]) : 60000;
+
+  Inst::Init(16);
+  StartServer();
+
+  int fd = Connect("127.0.0.1", kPort);
+  if (fd == -1) {
+    print("connect failed\n");
+    return EXIT_FAILURE;
+  }
+  auto set = Encode({"SET", "key", string(value_size, 'x')});
+  if (write(fd, set.data(), set.size()) != static_cast<ssize_t>(set.size())) {
+    print("write failed\n");
+    return EXIT_FAILURE;
+  }
+  char tmp[65536];
+  if (read(fd, tmp, sizeof(tmp)) <= 0) {
+    print("read failed\n");
+    return EXIT_FAILURE;
+  }
+
+  string batch;
+  for (int i = 0; i < 1000; i++) {
+    batch += Encode({"GET", "key"});
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  // 修改前：服务器缓存所有回复，RSS 随发送的请求持续增长；
+  // 修改后：输出缓冲区积压时暂停处理请求，RSS 保持稳定
+  long base = RssMiB();
+  size_t sent = 0;
+  auto deadline = steady_clock::now() + std::chrono::seconds(secs);
+  while (steady_clock::now() < deadline) {
+    auto nbytes = write(fd, batch.data(), batch.size());
+    if (nbytes > 0) {
+      sent += nbytes;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  print("sent={} requests rss={}MiB (base {}MiB)\n",
+        sent / Encode({"GET", "key"}).size(), RssMiB(), base);
+
+  // 读取回复，确认暂停的会话可以恢复
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+  size_t received = 0;
+  size_t expected = 64 * 1024 * 1024;
+  while (received < expected) {
+    auto nbytes = read(fd, tmp, sizeof(tmp));
+    if (nbytes <= 0) {
+      print("read failed\n");
+      return EXIT_FAILURE;
+    }
+    received += nbytes;
+  }
+  print("received={}MiB rss={}MiB\n", received / 1024 / 1024, RssMiB());
+  close(fd);
+  return 0;
+}
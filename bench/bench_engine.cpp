@@ -0,0 +1,94 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 比较 epoll 引擎与 io_uring 引擎的吞吐量
+// 用法：bench_engine [客户端数] [pipeline 深度] [秒数]
+// 在进程内分别以两种引擎启动服务器，使用相同的负载进行测试
+
+#include <fmt/core.h>
+
+#include <config.hpp>
+#include <cstdlib>
+#include <db/inst.hpp>
+#include <future>
+#include <net/loop.hpp>
+#include <server/server.hpp>
+#include <thread>
+
+#include "load.hpp"
+
+using fmt::print;
+using mydss::ServerConfig;
+using mydss::bench::RunLoad;
+using mydss::db::Inst;
+using mydss::err::Status;
+using mydss::net::Engine;
+using mydss::net::InetType;
+using mydss::net::Loop;
+using mydss::server::Server;
+using std::promise;
+using std::thread;
+
+static constexpr uint16_t kPort = 16379;
+
+// 在新的线程中以 engine 启动服务器，返回服务器实际使用的引擎
+static Engine StartServer(Engine engine, uint16_t port) {
+  promise<Engine> started;
+  auto future = started.get_future();
+  thread([engine, port, &started] {
+    auto loop = Loop::New(Loop::kDefaultMaxEvents, engine);
+    ServerConfig sc;
+    sc.set_type(InetType::kIPv4);
+    sc.set_ip("127.0.0.1");
+    sc.set_port(port);
+    auto server = Server::New(loop, sc);
+    auto status = server->Start();
+    if (status.error()) {
+      print("start server failed: {}\n", status.ToString());
+      exit(EXIT_FAILURE);
+    }
+    started.set_value(loop->engine());
+    loop->Run();
+  }).detach();
+  return future.get();
+}
+
+int main(int argc, char** argv) {
+  int clients = argc > 1 ? atoi(argv[1]) : 8;
+  int pipeline = argc > 2 ? atoi(argv[2]) : 16;
+  int secs = argc > 3 ? atoi(argv[3]) : 5;
+
+  Inst::Init(16);
+
+  const struct {
+    const char* name;
+    Engine engine;
+  } engines[] = {{"epoll", Engine::kEpoll}, {"io_uring", Engine::kUring}};
+
+  uint16_t port = kPort;
+  for (const auto& e : engines) {
+    auto engine = StartServer(e.engine, port);
+    if (engine != e.engine) {
+      print("engine={:<9} unavailable\n", e.name);
+      continue;
+    }
+
+    auto result = RunLoad("127.0.0.1", port, clients, pipeline, secs);
+    print("engine={:<9} clients={} pipeline={} requests={} ops/sec={:.0f}{}\n",
+          e.name, clients, pipeline, result.requests, result.ops,
+          result.failed ? " (some clients failed)" : "");
+    port++;
+  }
+  return 0;
+}
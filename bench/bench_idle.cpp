@@ -0,0 +1,167 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 大量空闲连接占用的内存
+// 用法：bench_idle [连接数] [epoll|io_uring]
+// 在进程内启动服务器，依次建立连接并在每个连接上执行一次 SET 和 GET，
+// 之后所有连接保持空闲，打印进程 RSS 的增长量和平均每个连接占用的内存
+
+#include <fmt/core.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <config.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <db/inst.hpp>
+#include <fstream>
+#include <future>
+#include <net/loop.hpp>
+#include <server/server.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "load.hpp"
+
+using fmt::print;
+using mydss::ServerConfig;
+using mydss::bench::Connect;
+using mydss::bench::Encode;
+using mydss::db::Inst;
+using mydss::net::Engine;
+using mydss::net::InetType;
+using mydss::net::Loop;
+using mydss::server::Server;
+using std::promise;
+using std::string;
+using std::thread;
+using std::vector;
+
+static constexpr uint16_t kPort = 16582;
+
+static void StartServer(Engine engine) {
+  promise<void> started;
+  auto future = started.get_future();
+  thread([&started, engine] {
+    auto loop = Loop::New(Loop::kDefaultMaxEvents, engine);
+    ServerConfig config;
+    config.set_type(InetType::kIPv4);
+    config.set_ip("127.0.0.1");
+    config.set_port(kPort);
+    config.set_backlog(4096);
+
+    // 不限制客户端的数目
+    mydss::ClientConfig client;
+    client.set_max_clients(0);
+    auto server = Server::New(loop, config, client);
+    auto status = server->Start();
+    if (status.error()) {
+      print("start server failed: {}\n", status.ToString());
+      exit(EXIT_FAILURE);
+    }
+    started.set_value();
+    loop->Run();
+  }).detach();
+  future.get();
+}
+
+// 当前进程的 RSS，单位为 KiB
+static long RssKiB() {
+  std::ifstream in("/proc/self/status");
+  string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 6, "VmRSS:") == 0) {
+      return atol(line.c_str() + 6);
+    }
+  }
+  return -1;
+}
+
+// 发送 req 并读取完整的回复，回复的长度为 len
+static bool RoundTrip(int fd, const string& req, size_t len) {
+  if (write(fd, req.data(), req.size()) != static_cast<ssize_t>(req.size())) {
+    return false;
+  }
+  char buf[4096];
+  size_t received = 0;
+  while (received < len) {
+    auto nbytes = read(fd, buf, sizeof(buf));
+    if (nbytes <= 0) {
+      return false;
+    }
+    received += nbytes;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int nconns = argc > 1 ? atoi(argv[1]) : 10000;
+  auto engine = Engine::kEpoll;
+  if (argc > 2 && strcmp(argv[2], "io_uring") == 0) {
+    engine = Engine::kUring;
+  }
+
+  // 客户端和服务器的连接都在同一个进程中
+  rlimit limit;
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  if (limit.rlim_cur < static_cast<rlim_t>(nconns) * 2 + 64) {
+    print("RLIMIT_NOFILE {} is too small\n", limit.rlim_cur);
+    return EXIT_FAILURE;
+  }
+
+  Inst::Init(16);
+  StartServer(engine);
+
+  string value(1000, 'x');
+  auto set = Encode({"SET", "key", value});
+  auto get = Encode({"GET", "key"});
+  size_t get_len =
+      fmt::format("${}\r\n", value.size()).size() + value.size() + 2;
+
+  // 先建立少量连接，使对象池等一次性的分配计入基准
+  vector<int> fds;
+  for (int i = 0; i < 100; i++) {
+    int fd = Connect("127.0.0.1", kPort);
+    if (fd == -1 || !RoundTrip(fd, set, 5) || !RoundTrip(fd, get, get_len)) {
+      print("request failed\n");
+      return EXIT_FAILURE;
+    }
+    fds.push_back(fd);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  long base = RssKiB();
+
+  for (int i = 0; i < nconns; i++) {
+    int fd = Connect("127.0.0.1", kPort);
+    if (fd == -1 || !RoundTrip(fd, set, 5) || !RoundTrip(fd, get, get_len)) {
+      print("request failed after {} connections\n", i);
+      return EXIT_FAILURE;
+    }
+    fds.push_back(fd);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  long rss = RssKiB();
+
+  print("{} idle connections: rss {}KiB -> {}KiB, {:.0f} bytes per "
+        "connection\n",
+        nconns, base, rss, (rss - base) * 1024.0 / nconns);
+
+  for (int fd : fds) {
+    close(fd);
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 比较每次 epoll_wait 获取一个事件与批量获取事件时，每个请求所需的系统调用数目
+// 用法：bench_loop [连接数] [轮数]
+// 每一轮中所有客户端各发送一个字节的请求，模拟大量客户端同时发送请求的情形
+
+#include <fmt/core.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <net/loop.hpp>
+#include <vector>
+
+using fmt::print;
+using mydss::net::Loop;
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+// 模拟服务器端的连接，读取所有到达的数据
+class Reader : public Loop::Watcher {
+ public:
+  Reader(int fd, uint64_t& handled, uint64_t& reads)
+      : fd_(fd), handled_(handled), reads_(reads) {}
+
+  void OnReadable() override {
+    char buf[64];
+    for (;;) {
+      auto nbytes = read(fd_, buf, sizeof(buf));
+      reads_++;
+      if (nbytes <= 0) {
+        return;
+      }
+      handled_ += nbytes;
+    }
+  }
+
+ private:
+  int fd_;
+  uint64_t& handled_;
+  uint64_t& reads_;
+};
+
+static void Bench(int max_events, int conns, int rounds) {
+  auto loop = Loop::New(max_events);
+
+  // clients[i] 模拟客户端，servers[i] 模拟服务器端的连接
+  vector<int> clients(conns);
+  vector<int> servers(conns);
+  vector<unique_ptr<Reader>> readers;
+  uint64_t handled = 0;
+  uint64_t reads = 0;
+  for (int i = 0; i < conns; i++) {
+    int fds[2];
+    int ret = socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+    assert(ret == 0);
+    clients[i] = fds[0];
+    servers[i] = fds[1];
+
+    readers.push_back(make_unique<Reader>(servers[i], handled, reads));
+    auto status = loop->Add(servers[i], EPOLLIN, readers.back().get());
+    assert(status.ok());
+  }
+
+  auto start = steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (int fd : clients) {
+      auto nbytes = write(fd, "*", 1);
+      assert(nbytes == 1);
+    }
+    uint64_t target = static_cast<uint64_t>(r + 1) * conns;
+    while (handled < target) {
+      loop->RunOnce(-1);
+    }
+  }
+  auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+  double reqs = static_cast<double>(handled);
+  const auto& stats = loop->stats();
+  print("max_events={:<6} requests={:<9} epoll_wait/req={:<8.4f} "
+        "syscalls/req={:<8.4f} ns/req={:.1f}\n",
+        max_events, handled, stats.polls / reqs, (stats.polls + reads) / reqs,
+        elapsed.count() / reqs);
+
+  for (int i = 0; i < conns; i++) {
+    auto status = loop->Remove(servers[i]);
+    assert(status.ok());
+    close(servers[i]);
+    close(clients[i]);
+  }
+}
+
+int main(int argc, char** argv) {
+  int conns = argc > 1 ? atoi(argv[1]) : 1000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 100;
+
+  // 修改前：每次 epoll_wait 只获取一个事件
+  Bench(1, conns, rounds);
+  // 修改后：批量获取事件
+  Bench(Loop::kDefaultMaxEvents, conns, rounds);
+  Bench(1024, conns, rounds);
+  return 0;
+}
@@ -0,0 +1,174 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 测量请求解析器解析流水线请求的吞吐量，以及查找行尾和解析长度的扫描函数
+// 在当前 CPU 支持的各个指令集下的吞吐量
+// 用法：bench_parser [每轮的数据量，单位为 MiB]
+// 数据按 16 KiB 一段交给解析器，与会话每次接收的数据大小相当，
+// 因此请求会跨越多段数据
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <server/parser.hpp>
+#include <string>
+#include <util/scan.hpp>
+#include <util/slice.hpp>
+#include <vector>
+
+using fmt::format;
+using fmt::print;
+using mydss::module::Req;
+using mydss::server::ReqParser;
+using mydss::util::FindCrlf;
+using mydss::util::Isa;
+using mydss::util::IsaName;
+using mydss::util::ParseDec;
+using mydss::util::ScanIsa;
+using mydss::util::SetScanIsa;
+using mydss::util::Slice;
+using std::string;
+using std::vector;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+// 每次交给解析器的数据大小
+constexpr size_t kChunk = 16 * 1024;
+
+// 以 RESP 数组编码一个请求
+static string Encode(const vector<string>& args) {
+  string result = format("*{}\r\n", args.size());
+  for (const auto& arg : args) {
+    result += format("${}\r\n", arg.size());
+    result += arg;
+    result += "\r\n";
+  }
+  return result;
+}
+
+// 重复 req 直到数据不少于 bytes，返回请求的数目
+static size_t Pipeline(const string& req, size_t bytes, string& data) {
+  data.clear();
+  size_t nreqs = 0;
+  while (data.size() < bytes) {
+    data += req;
+    nreqs++;
+  }
+  return nreqs;
+}
+
+// 依次查找流水线中所有的行尾
+static void BenchFindCrlf(const char* name, const vector<string>& args,
+                          size_t bytes) {
+  string data;
+  Pipeline(Encode(args), bytes, data);
+  const char* end = data.data() + data.size();
+
+  size_t lines = 0;
+  auto start = steady_clock::now();
+  for (const char* p = data.data(); (p = FindCrlf(p, end)) != nullptr; p += 2) {
+    lines++;
+  }
+  duration<double> elapsed = steady_clock::now() - start;
+  print("{:<6} {:<12} lines={:<10} ns/line={:<7.2f} GB/s={:.3f}\n",
+        IsaName(ScanIsa()), name, lines, elapsed.count() * 1e9 / lines,
+        data.size() / elapsed.count() / 1e9);
+}
+
+// 解析请求中常见的长度
+static void BenchParseDec() {
+  const char* lens[] = {"1", "3", "16", "32", "512", "1024", "65535"};
+  const size_t n = 10000000;
+  uint64_t sum = 0;
+  auto start = steady_clock::now();
+  for (size_t i = 0; i < n; i++) {
+    const char* len = lens[i % std::size(lens)];
+    uint64_t value;
+    if (ParseDec(len, strlen(len), value)) {
+      sum += value;
+    }
+  }
+  duration<double> elapsed = steady_clock::now() - start;
+  print("{:<6} parse_dec    lens={:<11} ns/len={:<8.2f} sum={}\n",
+        IsaName(ScanIsa()), n, elapsed.count() * 1e9 / n, sum);
+}
+
+static void Bench(const char* name, const string& req, size_t bytes) {
+  string data;
+  size_t nreqs = Pipeline(req, bytes, data);
+  // 预先将数据分段复制到接收缓冲区中，只测量解析的时间
+  vector<Slice> chunks;
+  for (size_t off = 0; off < data.size(); off += kChunk) {
+    size_t len = std::min(kChunk, data.size() - off);
+    auto& chunk = chunks.emplace_back(len);
+    memcpy(chunk.data(), data.data() + off, len);
+  }
+  size_t total = data.size();
+  string().swap(data);
+
+  ReqParser parser;
+  vector<Req> reqs;
+  auto start = steady_clock::now();
+  for (const auto& chunk : chunks) {
+    // 与会话相同，每段数据中的请求在接收下一段数据前处理完并释放
+    auto status = parser.Parse(chunk, reqs);
+    if (status.error()) {
+      break;
+    }
+    reqs.clear();
+  }
+  duration<double> elapsed = steady_clock::now() - start;
+
+  print("{:<6} {:<12} req_size={:<7} reqs={:<9} ns/req={:<9.1f} GB/s={:.3f}\n",
+        IsaName(ScanIsa()), name, req.size(), nreqs,
+        elapsed.count() * 1e9 / nreqs,
+        total / elapsed.count() / 1e9);
+}
+
+int main(int argc, char** argv) {
+  size_t bytes = (argc > 1 ? atoll(argv[1]) : 256) * 1024 * 1024;
+
+  vector<string> set = {"SET", "key:000000000001", string(32, 'v')};
+  // 参数较多的请求，头部的解析占主要部分
+  vector<string> mget = {"MGET"};
+  for (int i = 0; i < 64; i++) {
+    mget.push_back(format("key:{:012}", i));
+  }
+
+  for (auto isa : {Isa::kScalar, Isa::kSse, Isa::kAvx2}) {
+    if (!SetScanIsa(isa)) {
+      continue;
+    }
+    // 行较短时主要是每次调用的开销，行较长时主要是扫描的吞吐量
+    BenchFindCrlf("crlf_short", set, bytes);
+    BenchFindCrlf("crlf_long", {"SET", "key", string(4096, 'v')}, bytes);
+    BenchParseDec();
+    Bench("ping", Encode({"PING"}), bytes);
+    // 健康检查等客户端发送的内联命令
+    Bench("ping_inline", "PING\r\n", bytes);
+    Bench("get_inline", "GET key:000000000001\r\n", bytes);
+    Bench("get", Encode({"GET", "key:000000000001"}), bytes);
+    Bench("set", Encode(set), bytes);
+    Bench("mget_64", Encode(mget), bytes);
+    // 较大的值，数据部分的复制占主要部分
+    Bench("set_1k", Encode({"SET", "key:000000000001", string(1024, 'v')}),
+          bytes);
+    Bench("set_60k",
+          Encode({"SET", "key:000000000001", string(60 * 1024, 'v')}), bytes);
+  }
+  return 0;
+}
@@ -0,0 +1,72 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 测量其他线程通过 Loop::Post 向事件循环提交任务的吞吐量
+// 用法：bench_post [生产者线程数] [每个线程提交的任务数]
+
+#include <fmt/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <net/loop.hpp>
+#include <thread>
+#include <vector>
+
+using fmt::print;
+using mydss::net::Loop;
+using std::thread;
+using std::vector;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+static void Bench(int producers, int posts) {
+  auto loop = Loop::New();
+  uint64_t done = 0;
+  uint64_t total = static_cast<uint64_t>(producers) * posts;
+
+  auto start = steady_clock::now();
+  vector<thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < posts; i++) {
+        loop->Post([&done] { done++; });
+      }
+    });
+  }
+  while (done < total) {
+    loop->RunOnce(-1);
+  }
+  duration<double> elapsed = steady_clock::now() - start;
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  const auto& stats = loop->stats();
+  print("producers={:<3} posts={:<9} posts/sec={:<12.0f} polls/post={:.4f}\n",
+        producers, total, total / elapsed.count(),
+        static_cast<double>(stats.polls) / total);
+}
+
+int main(int argc, char** argv) {
+  int posts = argc > 2 ? atoi(argv[2]) : 1000000;
+  if (argc > 1) {
+    Bench(atoi(argv[1]), posts);
+    return 0;
+  }
+  for (int producers : {1, 2, 4, 8}) {
+    Bench(producers, posts);
+  }
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 重连风暴下的建立连接吞吐
+// 用法：bench_reconnect [线程数] [秒数] [突发连接数]
+// 在进程内启动服务器，每个客户端线程不断地建立连接、发送 PING、等待回复并关闭连接；
+// 随后一次性建立大量连接，测量服务器接受并回复所有连接所需的时间
+
+#include <fmt/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <config.hpp>
+#include <cstdlib>
+#include <db/inst.hpp>
+#include <future>
+#include <net/loop.hpp>
+#include <server/server.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "load.hpp"
+
+using fmt::print;
+using mydss::ServerConfig;
+using mydss::bench::Connect;
+using mydss::bench::Encode;
+using mydss::bench::SkipReply;
+using mydss::db::Inst;
+using mydss::net::InetType;
+using mydss::net::Loop;
+using mydss::server::Server;
+using std::atomic;
+using std::promise;
+using std::string;
+using std::thread;
+using std::vector;
+using std::chrono::steady_clock;
+
+static constexpr uint16_t kPort = 16580;
+static constexpr int kBacklog = 4096;
+
+static void StartServer() {
+  promise<void> started;
+  auto future = started.get_future();
+  thread([&started] {
+    auto loop = Loop::New();
+    ServerConfig config;
+    config.set_type(InetType::kIPv4);
+    config.set_ip("127.0.0.1");
+    config.set_port(kPort);
+    config.set_backlog(kBacklog);
+
+    auto server = Server::New(loop, config);
+    auto status = server->Start();
+    if (status.error()) {
+      print("start server failed: {}\n", status.ToString());
+      exit(EXIT_FAILURE);
+    }
+    started.set_value();
+    loop->Run();
+  }).detach();
+  future.get();
+}
+
+// 发送 PING 并等待回复
+static bool Ping(int fd, const string& req) {
+  if (write(fd, req.data(), req.size()) != static_cast<ssize_t>(req.size())) {
+    return false;
+  }
+  string buf;
+  char tmp[256];
+  size_t pos = 0;
+  while (!SkipReply(buf, pos)) {
+    auto nbytes = read(fd, tmp, sizeof(tmp));
+    if (nbytes <= 0) {
+      return false;
+    }
+    buf.append(tmp, nbytes);
+  }
+  return true;
+}
+
+// 每个线程不断地建立连接、发送 PING 并关闭连接，持续 secs 秒
+static void Storm(int threads, int secs) {
+  auto req = Encode({"PING"});
+  atomic<uint64_t> conns{0};
+  atomic<uint64_t> failures{0};
+  auto start = steady_clock::now();
+  auto deadline = start + std::chrono::seconds(secs);
+
+  vector<thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&] {
+      uint64_t done = 0;
+      uint64_t failed = 0;
+      while (steady_clock::now() < deadline) {
+        int fd = Connect("127.0.0.1", kPort);
+        if (fd == -1) {
+          failed++;
+          continue;
+        }
+        if (Ping(fd, req)) {
+          done++;
+        } else {
+          failed++;
+        }
+        close(fd);
+      }
+      conns += done;
+      failures += failed;
+    });
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+  std::chrono::duration<double> elapsed = steady_clock::now() - start;
+  print("storm  threads={} conns={} conns/s={:.0f} failures={}\n", threads,
+        conns.load(), conns / elapsed.count(), failures.load());
+}
+
+// 先建立 n 个连接，使其堆积在积压队列中，再在每个连接上发送 PING 并等待回复
+static void Burst(int n) {
+  auto req = Encode({"PING"});
+  auto start = steady_clock::now();
+  vector<int> fds;
+  fds.reserve(n);
+  int failures = 0;
+  for (int i = 0; i < n; i++) {
+    int fd = Connect("127.0.0.1", kPort);
+    if (fd == -1) {
+      failures++;
+      continue;
+    }
+    fds.push_back(fd);
+  }
+  for (int fd : fds) {
+    if (!Ping(fd, req)) {
+      failures++;
+    }
+  }
+  std::chrono::duration<double> elapsed = steady_clock::now() - start;
+  for (int fd : fds) {
+    close(fd);
+  }
+  print("burst  conns={} elapsed={:.2f}ms failures={}\n", n,
+        elapsed.count() * 1000, failures);
+}
+
+int main(int argc, char** argv) {
+  int threads = argc > 1 ? atoi(argv[1]) : 8;
+  int secs = argc > 2 ? atoi(argv[2]) : 5;
+  int burst = argc > 3 ? atoi(argv[3]) : 2000;
+
+  Inst::Init(16);
+  StartServer();
+
+  // 修改前：每次可读事件只接受一个连接，Conn 和 Session 逐个分配；
+  // 修改后：每次可读事件接受积压队列中的所有连接，对象来自线程的对象池
+  Storm(threads, secs);
+  Burst(burst);
+  return 0;
+}
@@ -0,0 +1,47 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 对运行中的 MyDSS 进行 SET/GET 压力测试，输出吞吐量
+// 用法：bench_server [ip] [port] [客户端数] [pipeline 深度] [秒数] [值的大小]
+// 每个客户端使用一个线程和一个连接，交替发送 SET 和 GET 请求
+// 可以分别以不同的 loop.threads 和 loop.threaded_io 配置运行服务器，
+// 比较吞吐量随线程数的变化
+
+#include <fmt/core.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "load.hpp"
+
+using fmt::print;
+using mydss::bench::RunLoad;
+
+int main(int argc, char** argv) {
+  const char* ip = argc > 1 ? argv[1] : "127.0.0.1";
+  uint16_t port = argc > 2 ? atoi(argv[2]) : 6379;
+  int clients = argc > 3 ? atoi(argv[3]) : 8;
+  int pipeline = argc > 4 ? atoi(argv[4]) : 16;
+  int secs = argc > 5 ? atoi(argv[5]) : 5;
+  size_t value_size = argc > 6 ? atol(argv[6]) : 5;
+
+  auto result =
+      RunLoad(ip, port, clients, pipeline, secs, std::string(value_size, 'v'));
+  if (result.failed) {
+    print("some clients failed\n");
+  }
+  print("clients={} pipeline={} value={} requests={} ops/sec={:.0f}\n",
+        clients, pipeline, value_size, result.requests, result.ops);
+  return result.failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,80 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 测量时间轮添加、取消和执行定时器的开销
+// 用法：bench_timer [定时器数目]
+// 定时器的延迟在 1 毫秒到 1 小时之间随机分布，覆盖时间轮的各层
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <net/timer.hpp>
+#include <random>
+#include <vector>
+
+using fmt::print;
+using mydss::net::TimerId;
+using mydss::net::TimerWheel;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+static double Elapsed(steady_clock::time_point start) {
+  return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? atoll(argv[1]) : 1000000;
+  const uint64_t kMaxDelay = 3600 * 1000;
+
+  std::mt19937_64 rng(42);
+  vector<uint64_t> delays(n);
+  for (auto& delay : delays) {
+    delay = rng() % kMaxDelay + 1;
+  }
+
+  TimerWheel wheel(0);
+  vector<TimerId> ids(n);
+  uint64_t fired = 0;
+
+  auto start = steady_clock::now();
+  for (size_t i = 0; i < n; i++) {
+    ids[i] = wheel.Add(delays[i], [&fired] { fired++; });
+  }
+  print("add     timers={:<9} ns/op={:.1f}\n", n, Elapsed(start) / n);
+
+  // 取消一半的定时器
+  start = steady_clock::now();
+  for (size_t i = 0; i < n; i += 2) {
+    wheel.Cancel(ids[i]);
+  }
+  print("cancel  timers={:<9} ns/op={:.1f}\n", n / 2, Elapsed(start) / (n / 2));
+
+  // 节点被复用，再次添加不需要分配内存
+  start = steady_clock::now();
+  for (size_t i = 0; i < n; i += 2) {
+    ids[i] = wheel.Add(delays[i], [&fired] { fired++; });
+  }
+  print("re-add  timers={:<9} ns/op={:.1f}\n", n / 2, Elapsed(start) / (n / 2));
+
+  // 每次推进 1 毫秒，直到所有定时器执行完毕
+  start = steady_clock::now();
+  for (uint64_t now = 1; wheel.size() > 0; now++) {
+    wheel.Advance(now);
+  }
+  print("expire  timers={:<9} ns/op={:.1f}\n", fired, Elapsed(start) / fired);
+  return 0;
+}
@@ -0,0 +1,138 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 比较通过回环接口的 TCP 连接与 Unix 域套接字的请求延迟
+// 用法：bench_unix [请求数]
+// 在进程内启动同时监听两种地址的服务器，单个客户端依次发送 GET 请求并等待回复
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <config.hpp>
+#include <cstdlib>
+#include <db/inst.hpp>
+#include <future>
+#include <net/loop.hpp>
+#include <server/server.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "load.hpp"
+
+using fmt::print;
+using mydss::ServerConfig;
+using mydss::bench::Connect;
+using mydss::bench::ConnectUnix;
+using mydss::bench::Encode;
+using mydss::bench::SkipReply;
+using mydss::db::Inst;
+using mydss::net::InetType;
+using mydss::net::Loop;
+using mydss::server::Server;
+using std::promise;
+using std::string;
+using std::thread;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+static constexpr uint16_t kPort = 16579;
+static constexpr const char* kPath = "/tmp/mydss_bench.sock";
+
+static void StartServer() {
+  promise<void> started;
+  auto future = started.get_future();
+  thread([&started] {
+    auto loop = Loop::New();
+    ServerConfig tcp;
+    tcp.set_type(InetType::kIPv4);
+    tcp.set_ip("127.0.0.1");
+    tcp.set_port(kPort);
+    ServerConfig uds;
+    uds.set_type(InetType::kUnix);
+    uds.set_path(kPath);
+
+    vector<std::shared_ptr<Server>> servers;
+    for (const auto& sc : {tcp, uds}) {
+      auto server = Server::New(loop, sc);
+      auto status = server->Start();
+      if (status.error()) {
+        print("start server failed: {}\n", status.ToString());
+        exit(EXIT_FAILURE);
+      }
+      servers.push_back(server);
+    }
+    started.set_value();
+    loop->Run();
+  }).detach();
+  future.get();
+}
+
+// 通过 fd 依次发送 n 个请求，打印每个请求往返时间的分布
+static void Bench(const char* name, int fd, int n) {
+  if (fd == -1) {
+    print("connect failed\n");
+    exit(EXIT_FAILURE);
+  }
+
+  auto req = Encode({"GET", "key"});
+  vector<int64_t> rtts;
+  rtts.reserve(n);
+  string buf;
+  char tmp[4096];
+  for (int i = 0; i < n; i++) {
+    auto start = steady_clock::now();
+    if (write(fd, req.data(), req.size()) != static_cast<ssize_t>(req.size())) {
+      print("write failed\n");
+      exit(EXIT_FAILURE);
+    }
+    buf.clear();
+    size_t pos = 0;
+    while (!SkipReply(buf, pos)) {
+      auto nbytes = read(fd, tmp, sizeof(tmp));
+      if (nbytes <= 0) {
+        print("read failed\n");
+        exit(EXIT_FAILURE);
+      }
+      buf.append(tmp, nbytes);
+    }
+    rtts.push_back(duration_cast<nanoseconds>(steady_clock::now() - start)
+                       .count());
+  }
+  close(fd);
+
+  std::sort(rtts.begin(), rtts.end());
+  double sum = 0;
+  for (auto rtt : rtts) {
+    sum += rtt;
+  }
+  print("{:<5} requests={} avg={:.2f}us p50={:.2f}us p99={:.2f}us\n", name, n,
+        sum / n / 1000, rtts[n / 2] / 1000.0, rtts[n * 99 / 100] / 1000.0);
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 100000;
+
+  Inst::Init(16);
+  StartServer();
+
+  // 修改前：只能通过 TCP 连接；修改后：同一台机器上的客户端可以使用 Unix 域套接字
+  Bench("tcp", Connect("127.0.0.1", kPort), n);
+  Bench("unix", ConnectUnix(kPath), n);
+  unlink(kPath);
+  return 0;
+}
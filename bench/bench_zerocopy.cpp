@@ -0,0 +1,170 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 比较 GET 较大的值时普通发送与零拷贝发送的吞吐量
+// 用法：bench_zerocopy [ip] [客户端数] [秒数]
+// 在进程内分别以不同的 zerocopy_threshold 启动服务器，监听 ip
+// ip 默认为 127.0.0.1，通过回环接口发送时内核仍会复制数据，
+// 使用网卡的地址才能体现 MSG_ZEROCOPY 的收益
+
+#include <fmt/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <config.hpp>
+#include <cstdlib>
+#include <db/inst.hpp>
+#include <future>
+#include <net/loop.hpp>
+#include <server/server.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "load.hpp"
+
+using fmt::print;
+using mydss::ServerConfig;
+using mydss::bench::Connect;
+using mydss::bench::Encode;
+using mydss::bench::SkipReply;
+using mydss::db::Inst;
+using mydss::net::InetType;
+using mydss::net::Loop;
+using mydss::server::Server;
+using std::atomic;
+using std::promise;
+using std::string;
+using std::thread;
+using std::vector;
+using std::chrono::steady_clock;
+
+static constexpr uint16_t kPort = 16479;
+// 请求中字符串的最大长度有限，通过多次 APPEND 构造较大的值
+static constexpr size_t kChunkSize = 60000;
+
+static void StartServer(const char* ip, uint16_t port, size_t threshold) {
+  promise<void> started;
+  auto future = started.get_future();
+  thread([ip, port, threshold, &started] {
+    auto loop = Loop::New();
+    ServerConfig sc;
+    sc.set_type(InetType::kIPv4);
+    sc.set_ip(ip);
+    sc.set_port(port);
+    sc.set_zerocopy_threshold(threshold);
+    auto server = Server::New(loop, sc);
+    auto status = server->Start();
+    if (status.error()) {
+      print("start server failed: {}\n", status.ToString());
+      exit(EXIT_FAILURE);
+    }
+    started.set_value();
+    loop->Run();
+  }).detach();
+  future.get();
+}
+
+// 发送 req 并读取 n 个回复，回复的内容存放在 buf 中
+static bool Call(int fd, const string& req, int n, string& buf) {
+  if (write(fd, req.data(), req.size()) != static_cast<ssize_t>(req.size())) {
+    return false;
+  }
+  buf.clear();
+  size_t pos = 0;
+  char tmp[65536];
+  for (int replies = 0; replies < n;) {
+    if (SkipReply(buf, pos)) {
+      replies++;
+      continue;
+    }
+    auto nbytes = read(fd, tmp, sizeof(tmp));
+    if (nbytes <= 0) {
+      return false;
+    }
+    buf.append(tmp, nbytes);
+  }
+  return true;
+}
+
+// 构造大小为 size 的值，key 为 "zc:<size>"
+static void SetValue(const char* ip, uint16_t port, size_t size) {
+  int fd = Connect(ip, port);
+  auto key = fmt::format("zc:{}", size);
+  string buf;
+  bool ok = Call(fd, Encode({"SET", key, ""}), 1, buf);
+  for (size_t n = 0; ok && n < size; n += kChunkSize) {
+    string chunk(std::min(kChunkSize, size - n), 'v');
+    ok = Call(fd, Encode({"APPEND", key, chunk}), 1, buf);
+  }
+  if (!ok) {
+    print("set value failed\n");
+    exit(EXIT_FAILURE);
+  }
+  close(fd);
+}
+
+// clients 个连接持续 GET 大小为 size 的值 secs 秒，返回每秒传输的字节数
+static double Run(const char* ip, uint16_t port, size_t size, int clients,
+                  int secs) {
+  auto req = Encode({"GET", fmt::format("zc:{}", size)});
+  auto deadline = steady_clock::now() + std::chrono::seconds(secs);
+  atomic<uint64_t> bytes{0};
+
+  vector<thread> threads;
+  for (int c = 0; c < clients; c++) {
+    threads.emplace_back([&] {
+      int fd = Connect(ip, port);
+      string buf;
+      uint64_t n = 0;
+      while (steady_clock::now() < deadline && Call(fd, req, 1, buf)) {
+        n += buf.size();
+      }
+      bytes += n;
+      close(fd);
+    });
+  }
+
+  auto start = steady_clock::now();
+  for (auto& t : threads) {
+    t.join();
+  }
+  std::chrono::duration<double> elapsed = steady_clock::now() - start;
+  return bytes / elapsed.count();
+}
+
+int main(int argc, char** argv) {
+  const char* ip = argc > 1 ? argv[1] : "127.0.0.1";
+  int clients = argc > 2 ? atoi(argv[2]) : 4;
+  int secs = argc > 3 ? atoi(argv[3]) : 3;
+
+  Inst::Init(16);
+
+  const size_t sizes[] = {64 * 1024, 256 * 1024, 1024 * 1024};
+  // 修改前：序列化到新的缓冲区后复制发送；修改后：值不复制，使用零拷贝发送
+  const size_t thresholds[] = {0, 16 * 1024};
+
+  uint16_t port = kPort;
+  for (size_t threshold : thresholds) {
+    StartServer(ip, port, threshold);
+    for (size_t size : sizes) {
+      SetValue(ip, port, size);
+      double rate = Run(ip, port, size, clients, secs);
+      print("zerocopy_threshold={:<6} value={:<8} clients={} MB/s={:.0f}\n",
+            threshold, size, clients, rate / (1024 * 1024));
+    }
+    port++;
+  }
+  return 0;
+}
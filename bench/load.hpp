@@ -0,0 +1,185 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_BENCH_LOAD_HPP_
+#define MYDSS_BENCH_LOAD_HPP_
+
+// 压力测试共用的客户端负载
+
+#include <arpa/inet.h>
+#include <fmt/core.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mydss::bench {
+
+// 从 buf 的 pos 处开始解析一个完整的回复，成功时返回 true 并更新 pos
+inline bool SkipReply(const std::string& buf, size_t& pos) {
+  if (pos >= buf.size()) {
+    return false;
+  }
+  auto crlf = buf.find("\r\n", pos);
+  if (crlf == std::string::npos) {
+    return false;
+  }
+  if (buf[pos] != '$') {
+    pos = crlf + 2;
+    return true;
+  }
+
+  long len = atol(buf.c_str() + pos + 1);
+  size_t end = crlf + 2;
+  if (len >= 0) {
+    end += len + 2;
+  }
+  if (end > buf.size()) {
+    return false;
+  }
+  pos = end;
+  return true;
+}
+
+inline std::string Encode(const std::vector<std::string>& args) {
+  std::string out = fmt::format("*{}\r\n", args.size());
+  for (const auto& arg : args) {
+    out += fmt::format("${}\r\n{}\r\n", arg.size(), arg);
+  }
+  return out;
+}
+
+inline int Connect(const char* ip, uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd == -1) {
+    return -1;
+  }
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  inet_pton(AF_INET, ip, &addr.sin_addr);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+inline int ConnectUnix(const char* path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    return -1;
+  }
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// 负载的结果
+struct LoadResult {
+  uint64_t requests = 0;  // 完成的请求数目
+  double ops = 0;         // 每秒完成的请求数目
+  bool failed = false;    // 是否有客户端失败
+};
+
+// 使用 clients 个线程和连接，每个连接以 pipeline 深度交替发送 SET 和 GET，
+// 持续 secs 秒，value 为 SET 的值
+inline LoadResult RunLoad(const char* ip, uint16_t port, int clients,
+                          int pipeline, int secs,
+                          const std::string& value = "value") {
+  using std::chrono::steady_clock;
+
+  std::atomic<uint64_t> total{0};
+  std::atomic<bool> failed{false};
+  auto deadline = steady_clock::now() + std::chrono::seconds(secs);
+
+  std::vector<std::thread> threads;
+  for (int c = 0; c < clients; c++) {
+    threads.emplace_back([&, c] {
+      int fd = Connect(ip, port);
+      if (fd == -1) {
+        failed = true;
+        return;
+      }
+
+      std::string batch;
+      for (int i = 0; i < pipeline; i++) {
+        auto key = fmt::format("key:{}:{}", c, i);
+        batch += i % 2 == 0
+                     ? Encode({"SET", key, value})
+                     : Encode({"GET", fmt::format("key:{}:{}", c, i - 1)});
+      }
+
+      std::string buf;
+      char tmp[16384];
+      uint64_t done = 0;
+      while (steady_clock::now() < deadline) {
+        if (write(fd, batch.data(), batch.size()) != batch.size()) {
+          failed = true;
+          break;
+        }
+
+        int replies = 0;
+        size_t pos = 0;
+        buf.clear();
+        while (replies < pipeline) {
+          if (SkipReply(buf, pos)) {
+            replies++;
+            continue;
+          }
+          auto nbytes = read(fd, tmp, sizeof(tmp));
+          if (nbytes <= 0) {
+            failed = true;
+            close(fd);
+            return;
+          }
+          buf.append(tmp, nbytes);
+        }
+        done += pipeline;
+      }
+      total += done;
+      close(fd);
+    });
+  }
+
+  auto start = steady_clock::now();
+  for (auto& t : threads) {
+    t.join();
+  }
+  std::chrono::duration<double> elapsed = steady_clock::now() - start;
+
+  LoadResult result;
+  result.requests = total;
+  result.ops = total / elapsed.count();
+  result.failed = failed;
+  return result;
+}
+
+}  // namespace mydss::bench
+
+#endif  // MYDSS_BENCH_LOAD_HPP_
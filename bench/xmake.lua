@@ -0,0 +1,140 @@
+-- Copyright 2022 Vincil Lau
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+--     http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+
+
+target("bench_loop")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_loop.cpp")
+    add_includedirs("$(projectdir)/include")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_packages("fmt", "spdlog")
+
+target("bench_server")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_server.cpp")
+    add_syslinks("pthread")
+    add_packages("fmt")
+
+target("bench_engine")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_engine.cpp")
+    add_includedirs("$(projectdir)/include")
+    add_defines("SPDLOG_ACTIVE_LEVEL=SPDLOG_LEVEL_DEBUG")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_syslinks("pthread")
+    add_packages("fmt", "nlohmann_json", "spdlog")
+
+target("bench_timer")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_timer.cpp")
+    add_includedirs("$(projectdir)/include")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_packages("fmt")
+
+target("bench_zerocopy")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_zerocopy.cpp")
+    add_includedirs("$(projectdir)/include")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_syslinks("pthread")
+    add_packages("fmt", "nlohmann_json", "spdlog")
+
+target("bench_unix")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_unix.cpp")
+    add_includedirs("$(projectdir)/include")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_syslinks("pthread")
+    add_packages("fmt", "nlohmann_json", "spdlog")
+
+target("bench_post")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_post.cpp")
+    add_includedirs("$(projectdir)/include")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_syslinks("pthread")
+    add_packages("fmt", "spdlog")
+
+target("bench_reconnect")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_reconnect.cpp")
+    add_includedirs("$(projectdir)/include")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_syslinks("pthread")
+    add_packages("fmt", "nlohmann_json", "spdlog")
+
+target("bench_backpressure")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_backpressure.cpp")
+    add_includedirs("$(projectdir)/include")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_syslinks("pthread")
+    add_packages("fmt", "nlohmann_json", "spdlog")
+
+target("bench_idle")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_idle.cpp")
+    add_includedirs("$(projectdir)/include")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_syslinks("pthread")
+    add_packages("fmt", "nlohmann_json", "spdlog")
+
+target("bench_parser")
+    set_kind("binary")
+    set_group("bench")
+
+    add_files("bench_parser.cpp")
+    add_includedirs("$(projectdir)/include")
+
+    add_deps("mydss_")
+    add_links("mydss_")
+    add_packages("fmt")
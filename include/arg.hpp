@@ -29,11 +29,13 @@ class Arg {
   [[nodiscard]] const auto& conf_file() const { return conf_file_; }
   [[nodiscard]] bool help() const { return help_; }
   [[nodiscard]] bool version() const { return version_; }
+  [[nodiscard]] bool upgrade() const { return upgrade_; }
 
  private:
   std::string conf_file_;  // 配置文件路径，为空表示没有设置该选项
   bool help_ = false;      // 是否有 --help 参数
   bool version_ = false;  // 是否有 --version 参数
+  bool upgrade_ = false;  // 是否有 --upgrade 参数
 };
 
 }  // namespace mydss
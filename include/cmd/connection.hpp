@@ -21,14 +21,17 @@ namespace mydss::cmd {
 
 class Connection {
  public:
-  static void Client(module::Ctx& ctx, module::Req req);
-  static void ClientGetName(module::Ctx& ctx, module::Req req);
-  static void ClientId(module::Ctx& ctx, module::Req req);
-  static void ClientSetName(module::Ctx& ctx, module::Req req);
-  static void Echo(module::Ctx& ctx, module::Req req);
-  static void Ping(module::Ctx& ctx, module::Req req);
-  static void Quit(module::Ctx& ctx, module::Req req);
-  static void Select(module::Ctx& ctx, module::Req req);
+  static void Client(module::Ctx& ctx, const module::Req& req);
+  static void ClientGetName(module::Ctx& ctx, const module::Req& req);
+  static void ClientId(module::Ctx& ctx, const module::Req& req);
+  static void ClientSetName(module::Ctx& ctx, const module::Req& req);
+  static void Echo(module::Ctx& ctx, const module::Req& req);
+  // HELLO [protover [AUTH username password] [SETNAME clientname]]
+  // 切换回复使用的协议版本，回复中包含服务器和连接的信息
+  static void Hello(module::Ctx& ctx, const module::Req& req);
+  static void Ping(module::Ctx& ctx, const module::Req& req);
+  static void Quit(module::Ctx& ctx, const module::Req& req);
+  static void Select(module::Ctx& ctx, const module::Req& req);
 };
 
 }  // namespace mydss::cmd
@@ -21,23 +21,23 @@ namespace mydss::cmd {
 
 class Generic {
  public:
-  static void Del(module::Ctx& ctx, module::Req req);
-  static void Exists(module::Ctx& ctx, module::Req req);
-  static void Expire(module::Ctx& ctx, module::Req req);
-  static void ExpireAt(module::Ctx& ctx, module::Req req);
-  static void Object(module::Ctx& ctx, module::Req req);
-  static void ObjectEncoding(module::Ctx& ctx, module::Req req);
-  static void ObjectIdleTime(module::Ctx& ctx, module::Req req);
-  static void ObjectRefCount(module::Ctx& ctx, module::Req req);
-  static void Persist(module::Ctx& ctx, module::Req req);
-  static void PExpire(module::Ctx& ctx, module::Req req);
-  static void PExpireAt(module::Ctx& ctx, module::Req req);
-  static void PTtl(module::Ctx& ctx, module::Req req);
-  static void Rename(module::Ctx& ctx, module::Req req);
-  static void RenameNx(module::Ctx& ctx, module::Req req);
-  static void Touch(module::Ctx& ctx, module::Req req);
-  static void Ttl(module::Ctx& ctx, module::Req req);
-  static void Type(module::Ctx& ctx, module::Req req);
+  static void Del(module::Ctx& ctx, const module::Req& req);
+  static void Exists(module::Ctx& ctx, const module::Req& req);
+  static void Expire(module::Ctx& ctx, const module::Req& req);
+  static void ExpireAt(module::Ctx& ctx, const module::Req& req);
+  static void Object(module::Ctx& ctx, const module::Req& req);
+  static void ObjectEncoding(module::Ctx& ctx, const module::Req& req);
+  static void ObjectIdleTime(module::Ctx& ctx, const module::Req& req);
+  static void ObjectRefCount(module::Ctx& ctx, const module::Req& req);
+  static void Persist(module::Ctx& ctx, const module::Req& req);
+  static void PExpire(module::Ctx& ctx, const module::Req& req);
+  static void PExpireAt(module::Ctx& ctx, const module::Req& req);
+  static void PTtl(module::Ctx& ctx, const module::Req& req);
+  static void Rename(module::Ctx& ctx, const module::Req& req);
+  static void RenameNx(module::Ctx& ctx, const module::Req& req);
+  static void Touch(module::Ctx& ctx, const module::Req& req);
+  static void Ttl(module::Ctx& ctx, const module::Req& req);
+  static void Type(module::Ctx& ctx, const module::Req& req);
 };
 
 }  // namespace mydss::cmd
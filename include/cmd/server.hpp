@@ -0,0 +1,30 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_CMD_SERVER_HPP_
+#define MYDSS_INCLUDE_CMD_SERVER_HPP_
+
+#include <module/api.hpp>
+
+namespace mydss::cmd {
+
+class Server {
+ public:
+  // INFO [section]，section 为 cpu、threads 或 busypoll，省略时返回所有部分
+  static void Info(module::Ctx& ctx, const module::Req& req);
+};
+
+}  // namespace mydss::cmd
+
+#endif  // MYDSS_INCLUDE_CMD_SERVER_HPP_
@@ -43,19 +43,19 @@ class String : public module::Object {
   void SetI64(int64_t i64);
 
  public:
-  static void Append(module::Ctx& ctx, module::Req req);
-  static void Decr(module::Ctx& ctx, module::Req req);
-  static void DecrBy(module::Ctx& ctx, module::Req req);
-  static void Get(module::Ctx& ctx, module::Req req);
-  static void GetDel(module::Ctx& ctx, module::Req req);
-  static void GetRange(module::Ctx& ctx, module::Req req);
-  static void Incr(module::Ctx& ctx, module::Req req);
-  static void IncrBy(module::Ctx& ctx, module::Req req);
-  static void MGet(module::Ctx& ctx, module::Req req);
-  static void MSet(module::Ctx& ctx, module::Req req);
-  static void MSetNx(module::Ctx& ctx, module::Req req);
-  static void Set(module::Ctx& ctx, module::Req req);
-  static void StrLen(module::Ctx& ctx, module::Req req);
+  static void Append(module::Ctx& ctx, const module::Req& req);
+  static void Decr(module::Ctx& ctx, const module::Req& req);
+  static void DecrBy(module::Ctx& ctx, const module::Req& req);
+  static void Get(module::Ctx& ctx, const module::Req& req);
+  static void GetDel(module::Ctx& ctx, const module::Req& req);
+  static void GetRange(module::Ctx& ctx, const module::Req& req);
+  static void Incr(module::Ctx& ctx, const module::Req& req);
+  static void IncrBy(module::Ctx& ctx, const module::Req& req);
+  static void MGet(module::Ctx& ctx, const module::Req& req);
+  static void MSet(module::Ctx& ctx, const module::Req& req);
+  static void MSetNx(module::Ctx& ctx, const module::Req& req);
+  static void Set(module::Ctx& ctx, const module::Req& req);
+  static void StrLen(module::Ctx& ctx, const module::Req& req);
 
  private:
   std::variant<std::string, int64_t> value_;
@@ -17,39 +17,78 @@
 
 #include <cstdint>
 #include <err/status.hpp>
+#include <net/engine.hpp>
 #include <net/inet.hpp>
+#include <net/sock_opts.hpp>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
 
 namespace mydss {
 
+// 客户端输出缓冲区的限制，即已经生成但尚未写入套接字的回复的大小，
+// 超出限制的客户端会被断开，值为 0 表示不限制
+struct OutputLimit {
+  // 超过该字节数时立即断开
+  uint64_t hard = 0;
+  // 持续超过该字节数 soft_seconds 秒时断开
+  uint64_t soft = 0;
+  uint64_t soft_seconds = 0;
+};
+
 // 服务器配置
 class ServerConfig {
  public:
   [[nodiscard]] auto type() const { return type_; }
   [[nodiscard]] const auto& ip() const { return ip_; }
   [[nodiscard]] auto port() const { return port_; }
+  [[nodiscard]] const auto& path() const { return path_; }
+  [[nodiscard]] auto perm() const { return perm_; }
   [[nodiscard]] auto backlog() const { return backlog_; }
+  [[nodiscard]] auto reuse_port() const { return reuse_port_; }
+  [[nodiscard]] auto zerocopy_threshold() const { return zerocopy_threshold_; }
+  [[nodiscard]] const auto& sock_opts() const { return sock_opts_; }
+  [[nodiscard]] auto& sock_opts() { return sock_opts_; }
+  [[nodiscard]] const auto& output_limit() const { return output_limit_; }
+  [[nodiscard]] auto& output_limit() { return output_limit_; }
 
   void set_type(net::InetType type) { type_ = type; }
   void set_ip(std::string ip) { ip_ = std::move(ip); }
   void set_port(uint16_t port) { port_ = port; }
+  void set_path(std::string path) { path_ = std::move(path); }
+  void set_perm(uint32_t perm) { perm_ = perm; }
   void set_backlog(int backlog) { backlog_ = backlog; }
+  void set_reuse_port(bool reuse_port) { reuse_port_ = reuse_port; }
+  void set_zerocopy_threshold(size_t threshold) {
+    zerocopy_threshold_ = threshold;
+  }
 
   // 从 json 中加载服务器配置，并将结果存储到 result
   static err::Status Load(const nlohmann::json& json,
                           std::vector<ServerConfig>& result);
 
  private:
-  // 地址类型，IPv4 或 IPv6
+  // 地址类型，IPv4、IPv6 或 Unix 域套接字
   net::InetType type_ = net::InetType::kIPv4;
   // 监听的 IP 地址
   std::string ip_ = "127.0.0.1";
   // 监听的端口
   uint16_t port_ = 6379;
+  // Unix 域套接字文件的路径，仅在 type_ 为 kUnix 时使用
+  std::string path_;
+  // Unix 域套接字文件的权限，为 0 时不修改
+  uint32_t perm_ = 0;
   // listen 系统调用的 backlog 参数
   int backlog_ = 512;
+  // 是否设置 SO_REUSEPORT，使多个线程可以监听同一个地址
+  bool reuse_port_ = false;
+  // 回复中的 bulk string 不小于该大小时使用 MSG_ZEROCOPY 发送，为 0 表示不使用
+  size_t zerocopy_threshold_ = 0;
+  // 监听套接字和连接套接字的选项
+  net::SockOpts sock_opts_;
+  // 通过该地址连接的客户端的输出缓冲区限制，不同类别的客户端可以通过不同的
+  // 地址连接以使用不同的限制
+  OutputLimit output_limit_;
 };
 
 // 数据库配置
@@ -66,6 +105,106 @@ class DbConfig {
   uint8_t db_num_ = 16;  // 数据库的数目
 };
 
+// 事件循环配置
+class LoopConfig {
+ public:
+  [[nodiscard]] auto max_events() const { return max_events_; }
+  [[nodiscard]] auto threads() const { return threads_; }
+  [[nodiscard]] auto engine() const { return engine_; }
+  [[nodiscard]] auto threaded_io() const { return threaded_io_; }
+  [[nodiscard]] const auto& cpu_affinity() const { return cpu_affinity_; }
+  [[nodiscard]] auto executor_cpu() const { return executor_cpu_; }
+  [[nodiscard]] auto incoming_cpu() const { return incoming_cpu_; }
+  [[nodiscard]] const auto& busy_poll() const { return busy_poll_; }
+  // 第 index 个事件循环线程绑定的 CPU，不绑定时返回 -1
+  [[nodiscard]] int LoopCpu(int index) const {
+    if (cpu_affinity_.empty()) {
+      return -1;
+    }
+    return cpu_affinity_[index % cpu_affinity_.size()];
+  }
+  // 第 index 个事件循环每轮忙等待的微秒数，不忙等待时返回 0
+  [[nodiscard]] uint64_t LoopBusyPoll(int index) const {
+    if (busy_poll_.empty()) {
+      return 0;
+    }
+    return busy_poll_[index % busy_poll_.size()];
+  }
+
+  void set_max_events(int max_events) { max_events_ = max_events; }
+  void set_threads(int threads) { threads_ = threads; }
+  void set_engine(net::Engine engine) { engine_ = engine; }
+  void set_threaded_io(bool threaded_io) { threaded_io_ = threaded_io; }
+  void set_cpu_affinity(std::vector<int> cpus) {
+    cpu_affinity_ = std::move(cpus);
+  }
+  void set_executor_cpu(int cpu) { executor_cpu_ = cpu; }
+  void set_incoming_cpu(bool incoming_cpu) { incoming_cpu_ = incoming_cpu; }
+  void set_busy_poll(std::vector<uint64_t> budgets) {
+    busy_poll_ = std::move(budgets);
+  }
+
+  // 从 json 中加载事件循环配置，并将结果存储到 result
+  [[nodiscard]] static err::Status Load(const nlohmann::json& json,
+                                        LoopConfig& result);
+
+ private:
+  int max_events_ = 128;  // 每次调用 epoll_wait 最多获取的事件数目
+  int threads_ = 1;       // 事件循环线程的数目，每个线程拥有独立的 Loop
+  net::Engine engine_ = net::Engine::kEpoll;  // I/O 引擎
+  // 为 true 时事件循环线程只负责读写和解析请求，所有命令由一个单独的线程执行
+  bool threaded_io_ = false;
+  // 第 i 个事件循环线程绑定到 cpu_affinity_[i % size] 上，为空表示不绑定
+  std::vector<int> cpu_affinity_;
+  // 执行命令的线程绑定的 CPU，为 -1 表示不绑定，只在 threaded_io_ 为 true 时有效
+  int executor_cpu_ = -1;
+  // 是否将每个线程的监听套接字的 SO_INCOMING_CPU 设置为该线程绑定的 CPU
+  bool incoming_cpu_ = false;
+  // 第 i 个事件循环每轮忙等待 busy_poll_[i % size] 微秒，为空表示都不忙等待
+  std::vector<uint64_t> busy_poll_;
+};
+
+// 热升级配置
+class UpgradeConfig {
+ public:
+  [[nodiscard]] const auto& path() const { return path_; }
+  [[nodiscard]] auto drain_timeout() const { return drain_timeout_; }
+
+  void set_path(std::string path) { path_ = std::move(path); }
+  void set_drain_timeout(uint64_t timeout) { drain_timeout_ = timeout; }
+
+  // 从 json 中加载热升级配置，并将结果存储到 result
+  [[nodiscard]] static err::Status Load(const nlohmann::json& json,
+                                        UpgradeConfig& result);
+
+ private:
+  // 交接监听套接字的 Unix 域套接字文件的路径，为空表示不支持热升级
+  std::string path_;
+  // 交接后等待已有的会话关闭的最长时间，单位为毫秒，超时后旧进程直接退出
+  uint64_t drain_timeout_ = 30000;
+};
+
+// 客户端配置，对所有地址和事件循环线程生效
+class ClientConfig {
+ public:
+  [[nodiscard]] auto max_clients() const { return max_clients_; }
+  [[nodiscard]] auto timeout() const { return timeout_; }
+
+  void set_max_clients(size_t max_clients) { max_clients_ = max_clients; }
+  void set_timeout(uint64_t timeout) { timeout_ = timeout; }
+
+  // 从 json 中加载客户端配置，并将结果存储到 result
+  [[nodiscard]] static err::Status Load(const nlohmann::json& json,
+                                        ClientConfig& result);
+
+ private:
+  // 同时连接的客户端的最大数目，达到后新的连接收到错误回复后被关闭，
+  // 为 0 表示不限制
+  size_t max_clients_ = 10000;
+  // 客户端空闲该秒数后断开连接，为 0 表示不断开
+  uint64_t timeout_ = 0;
+};
+
 // MyDSS 配置
 class Config {
  public:
@@ -75,10 +214,20 @@ class Config {
   [[nodiscard]] const auto& db() const { return db_; }
   [[nodiscard]] auto& db() { return db_; }
 
+  [[nodiscard]] const auto& loop() const { return loop_; }
+  [[nodiscard]] auto& loop() { return loop_; }
+
+  [[nodiscard]] const auto& upgrade() const { return upgrade_; }
+  [[nodiscard]] auto& upgrade() { return upgrade_; }
+
+  [[nodiscard]] const auto& client() const { return client_; }
+  [[nodiscard]] auto& client() { return client_; }
+
   // 返回默认配置
   // 默认配置为：
   // 1. 服务器监听 127.0.0.0:6379，backlog=512
   // 2. 数据库数目为 16
+  // 3. 每次调用 epoll_wait 最多获取 128 个事件，使用 1 个事件循环线程
   [[nodiscard]] static Config Default() {
     Config config;
     config.server_.push_back({});
@@ -94,6 +243,9 @@ class Config {
  private:
   std::vector<ServerConfig> server_;  // 服务器配置，支持同时监听多个地址
   DbConfig db_;                       // 数据库配置
+  LoopConfig loop_;                   // 事件循环配置
+  UpgradeConfig upgrade_;             // 热升级配置
+  ClientConfig client_;               // 客户端配置
 };
 
 }  // namespace mydss
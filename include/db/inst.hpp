@@ -15,9 +15,12 @@
 #ifndef MYDSS_INCLUDE_DB_INST_HPP_
 #define MYDSS_INCLUDE_DB_INST_HPP_
 
+#include <err/status.hpp>
 #include <functional>
 #include <module/ctx.hpp>
 #include <module/req.hpp>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include "db.hpp"
@@ -25,15 +28,24 @@
 namespace mydss::db {
 
 // 一个数据库实例
+// 多个事件循环线程共享同一个实例，命令在 Handle 中串行执行
 class Inst {
  public:
-  using Cmd = std::function<void(module::Ctx& ctx, module::Req)>;
+  // 命令不能在返回后继续引用请求的参数，需要保存的参数必须复制
+  using Cmd = std::function<void(module::Ctx& ctx, const module::Req& req)>;
 
   static void Init(int db_num);
   static std::shared_ptr<Inst> GetInst() { return inst_; }
 
   void RegisterCmd(std::string name, Cmd cmd);
-  void Handle(module::Ctx& ctx, module::Req req);
+  // 执行命令，可以在多个线程中并发调用
+  void Handle(module::Ctx& ctx, const module::Req& req);
+
+  // 将所有数据库中尚未过期的键序列化到 out，用于热升级时将数据集交给新进程
+  // 序列化期间持有锁，命令的执行会被阻塞
+  void Dump(std::string& out);
+  // 将 Dump 序列化的数据集加载到数据库中，已经存在的键被覆盖
+  [[nodiscard]] err::Status Restore(const std::string& data);
 
   [[nodiscard]] auto& db() { return dbs_[cur_db_]; }
 
@@ -54,6 +66,8 @@ class Inst {
   std::vector<Db> dbs_;
   int cur_db_ = 0;
   std::unordered_map<std::string, Cmd> cmds_;
+  // 保护数据库，保证同一时刻只有一个命令在执行
+  std::mutex mutex_;
 };
 
 }  // namespace mydss::db
@@ -32,6 +32,7 @@ static constexpr int kJsonParseErr = 1004;   // JSON 解析错误
 static constexpr int kInvalidConfig = 1005;  // 无效的配置
 static constexpr int kInvalidArgs = 1006;    // 无效的参数
 static constexpr int kInvalidAddr = 1007;    // 无效的地址
+static constexpr int kInvalidData = 1008;    // 无效的数据
 
 }  // namespace mydss::err
 
@@ -24,6 +24,8 @@ static const char* kHelpText = R"(Usage:
 
 Options:
   -c, --config file    specify configure file path
+  --upgrade            take over listening sockets and dataset from the
+                       running server at upgrade.path
   --version            show version
   --help               show help text
 )";
@@ -25,6 +25,9 @@ constexpr uint64_t kMaxStrInReq = UINT16_MAX;
 // 请求中字符串的最大长度
 constexpr uint64_t kMaxStrLenInReq = UINT16_MAX;
 
+// 内联请求一行的最大长度，不包括结尾的换行
+constexpr uint64_t kMaxInlineLen = 64 * 1024;
+
 }  // namespace mydss
 
 #endif  // MYDSS_INCLUDE_LIMIT_HPP_
@@ -16,28 +16,59 @@
 #define MYDSS_INCLUDE_MODULE_CTX_HPP_
 
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "object.hpp"
 #include "piece.hpp"
 
+namespace mydss::server {
+class Session;
+}  // namespace mydss::server
+
 namespace mydss::module {
 
 class Ctx {
  public:
-  explicit Ctx(uint64_t session_id) : session_id_(session_id) {}
+  // 回复及其使用的协议版本，piece 为 nullptr 表示发送完之前的回复后关闭连接
+  // 命令可能在执行过程中通过 HELLO 切换协议版本，因此每个回复记录各自的版本
+  struct Output {
+    std::shared_ptr<Piece> piece;
+    Proto proto;
+  };
+  using Replies = std::vector<Output>;
+
+  // 在会话所在的线程中执行命令时使用，回复直接由会话发送
+  // 调用者在命令执行期间持有会话，即使会话在执行过程中被关闭也不会被销毁
+  explicit Ctx(server::Session* session);
+  // 在会话所在的线程之外执行命令时使用，回复按顺序添加到 replies 中，
+  // 由会话所在的线程发送
+  Ctx(server::Session* session, Replies* replies);
 
-  [[nodiscard]] std::shared_ptr<Object> GetObject(const std::string& key);
-  void SetObject(const std::string& key, std::shared_ptr<Object> obj);
-  bool DeleteObject(const std::string& key);
+  [[nodiscard]] std::shared_ptr<Object> GetObject(std::string_view key);
+  void SetObject(std::string_view key, std::shared_ptr<Object> obj);
+  bool DeleteObject(std::string_view key);
   void Reply(std::shared_ptr<Piece> piece);
   [[nodiscard]] int SelectDb(int db);
   void Close();
   const std::string& GetClientName();
   const void SetClientName(std::string name);
   const int64_t GetClientId();
+  // 当前会话回复使用的协议版本，设置后对之后的回复生效
+  [[nodiscard]] Proto GetProto();
+  void SetProto(Proto proto);
+
+  // 是否已经请求关闭连接，此后不应再执行该会话的命令
+  [[nodiscard]] bool closing() const { return closing_; }
 
  private:
   uint64_t session_id_;
+  server::Session* session_;
+  Replies* replies_ = nullptr;
+  bool closing_ = false;
+  // 之后还需要省略的 Piece 的数目，见 Piece::Omitted
+  int64_t omitted_ = 0;
 };
 
 }  // namespace mydss::module
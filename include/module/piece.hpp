@@ -23,15 +23,24 @@
 
 namespace mydss::module {
 
+// 回复使用的协议版本，客户端通过 HELLO 命令协商，默认为 RESP2
+// RESP3 新增的类型在 RESP2 中序列化为与其最接近的 RESP2 类型
+enum class Proto { kResp2 = 2, kResp3 = 3 };
+
 class Piece {
  public:
-  // 计算序列化后的大小
-  [[nodiscard]] virtual size_t Size() const = 0;
-
-  // 序列化 Piece
-  // len 不能小于 Size() 的返回值
-  // 返回序列后的数据大小，与 Size() 的返回值相同
-  virtual size_t Serialize(char* buf, size_t len) const = 0;
+  // 计算以 proto 序列化后的大小
+  [[nodiscard]] virtual size_t Size(Proto proto) const = 0;
+
+  // 以 proto 序列化 Piece
+  // len 不能小于 Size(proto) 的返回值
+  // 返回序列后的数据大小，与 Size(proto) 的返回值相同
+  virtual size_t Serialize(char* buf, size_t len, Proto proto) const = 0;
+
+  // 之后作为该 Piece 的元素回复的 Piece 的数目，只有聚合类型不为 0
+  [[nodiscard]] virtual int64_t Elements() const { return 0; }
+  // 以 proto 回复时是否省略该 Piece 及其所有元素
+  [[nodiscard]] virtual bool Omitted(Proto /*proto*/) const { return false; }
 };
 
 class SimpleStringPiece : public Piece {
@@ -41,8 +50,8 @@ class SimpleStringPiece : public Piece {
   [[nodiscard]] const auto& value() const { return value_; }
   [[nodiscard]] auto& value() { return value_; }
 
-  [[nodiscard]] size_t Size() const override;
-  size_t Serialize(char* buf, size_t len) const override;
+  [[nodiscard]] size_t Size(Proto proto) const override;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override;
 
  private:
   std::string value_;
@@ -55,8 +64,8 @@ class ErrorPiece : public Piece {
   [[nodiscard]] const auto& value() const { return value_; }
   [[nodiscard]] auto& value() { return value_; }
 
-  [[nodiscard]] size_t Size() const override;
-  size_t Serialize(char* buf, size_t len) const override;
+  [[nodiscard]] size_t Size(Proto proto) const override;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override;
 
  private:
   std::string value_;
@@ -69,8 +78,8 @@ class IntegerPiece : public Piece {
   [[nodiscard]] const auto& value() const { return value_; }
   [[nodiscard]] auto& value() { return value_; }
 
-  [[nodiscard]] size_t Size() const override;
-  size_t Serialize(char* buf, size_t len) const override;
+  [[nodiscard]] size_t Size(Proto proto) const override;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override;
 
  private:
   int64_t value_;
@@ -83,35 +92,147 @@ class BulkStringPiece : public Piece {
   [[nodiscard]] const auto& value() const { return value_; }
   [[nodiscard]] auto& value() { return value_; }
 
-  [[nodiscard]] size_t Size() const override;
-  size_t Serialize(char* buf, size_t len) const override;
+  [[nodiscard]] size_t Size(Proto proto) const override;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override;
 
  private:
   std::string value_;
 };
 
+// RESP2 中为 "$-1\r\n"，RESP3 中为 "_\r\n"
 class NullPiece : public Piece {
  public:
-  [[nodiscard]] size_t Size() const override {
-    // $-1\r\n
-    return 5;
+  [[nodiscard]] size_t Size(Proto proto) const override {
+    return proto == Proto::kResp3 ? 3 : 5;
   }
-  size_t Serialize(char* buf, size_t len) const override {
-    assert(len >= Size());
-    memcpy(buf, "$-1\r\n", Size());
-    return 5;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override {
+    size_t size = Size(proto);
+    assert(len >= size);
+    memcpy(buf, proto == Proto::kResp3 ? "_\r\n" : "$-1\r\n", size);
+    return size;
   }
 };
 
-class ArrayPiece : public Piece {
+// 聚合类型只包含头部，其元素作为之后的 Piece 依次回复
+class AggregatePiece : public Piece {
  public:
-  explicit ArrayPiece(int64_t len) : len_(len) {}
+  [[nodiscard]] auto len() const { return len_; }
+
+  [[nodiscard]] size_t Size(Proto proto) const override;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override;
+  [[nodiscard]] int64_t Elements() const override { return elements_; }
+  [[nodiscard]] bool Omitted(Proto proto) const override {
+    return proto == Proto::kResp2 && resp2_type_ == 0;
+  }
 
-  [[nodiscard]] size_t Size() const override;
-  size_t Serialize(char* buf, size_t len) const override;
+ protected:
+  // elements 为之后作为元素的 Piece 的数目，RESP2 中以其作为数组的长度
+  // type 为 RESP3 中的类型字符，resp2_type 为 RESP2 中的类型字符，
+  // 为 0 表示在 RESP2 中省略该 Piece 及其所有元素
+  AggregatePiece(int64_t len, int64_t elements, char type, char resp2_type)
+      : len_(len), elements_(elements), type_(type), resp2_type_(resp2_type) {}
 
  private:
   int64_t len_;
+  int64_t elements_;
+  char type_;
+  char resp2_type_;
+};
+
+// 之后的 len 个 Piece 为数组的元素
+class ArrayPiece : public AggregatePiece {
+ public:
+  explicit ArrayPiece(int64_t len) : AggregatePiece(len, len, '*', '*') {}
+};
+
+// 之后的 len * 2 个 Piece 依次为键和值，RESP2 中为长度为 len * 2 的数组
+class MapPiece : public AggregatePiece {
+ public:
+  explicit MapPiece(int64_t len) : AggregatePiece(len, len * 2, '%', '*') {}
+};
+
+// 之后的 len 个 Piece 为集合的元素，RESP2 中为数组
+class SetPiece : public AggregatePiece {
+ public:
+  explicit SetPiece(int64_t len) : AggregatePiece(len, len, '~', '*') {}
+};
+
+// 服务器主动推送的数据，之后的 len 个 Piece 为其元素，第一个元素为推送的类型
+// RESP2 中为数组，与 RESP2 的发布订阅消息相同
+class PushPiece : public AggregatePiece {
+ public:
+  explicit PushPiece(int64_t len) : AggregatePiece(len, len, '>', '*') {}
+};
+
+// 之后的 len * 2 个 Piece 依次为属性的键和值，属性描述紧随其后的回复
+// RESP2 没有对应的类型，属性及其所有的键和值都不回复
+class AttributePiece : public AggregatePiece {
+ public:
+  explicit AttributePiece(int64_t len)
+      : AggregatePiece(len, len * 2, '|', 0) {}
+};
+
+// RESP2 中为 bulk string
+class DoublePiece : public Piece {
+ public:
+  explicit DoublePiece(double value);
+
+  [[nodiscard]] auto value() const { return value_; }
+
+  [[nodiscard]] size_t Size(Proto proto) const override;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override;
+
+ private:
+  double value_;
+  std::string str_;  // 序列化后的数值，inf、-inf 和 nan 按照 RESP3 的规定表示
+};
+
+// RESP2 中为整数 1 和 0
+class BooleanPiece : public Piece {
+ public:
+  explicit BooleanPiece(bool value) : value_(value) {}
+
+  [[nodiscard]] auto value() const { return value_; }
+
+  [[nodiscard]] size_t Size(Proto proto) const override;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override;
+
+ private:
+  bool value_;
+};
+
+// 超出 64 位整数范围的整数，value 为十进制表示，RESP2 中为 bulk string
+class BigNumberPiece : public Piece {
+ public:
+  explicit BigNumberPiece(std::string value) : value_(std::move(value)) {}
+
+  [[nodiscard]] const auto& value() const { return value_; }
+
+  [[nodiscard]] size_t Size(Proto proto) const override;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override;
+
+ private:
+  std::string value_;
+};
+
+// 带有格式的字符串，format 为 3 个字符，例如 "txt" 和 "mkd"
+// RESP2 中为只包含 value 的 bulk string
+class VerbatimStringPiece : public Piece {
+ public:
+  VerbatimStringPiece(std::string format, std::string value)
+      : format_(std::move(format)), value_(std::move(value)) {
+    assert(format_.size() == 3);
+  }
+
+  [[nodiscard]] const auto& format() const { return format_; }
+  [[nodiscard]] const auto& value() const { return value_; }
+
+  [[nodiscard]] size_t Size(Proto proto) const override;
+  size_t Serialize(char* buf, size_t len, Proto proto) const override;
+
+ private:
+  std::string format_;
+  std::string value_;
 };
 
 }  // namespace mydss::module
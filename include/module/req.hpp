@@ -15,13 +15,69 @@
 #ifndef MYDSS_INCLUDE_MODULE_REQ_HPP_
 #define MYDSS_INCLUDE_MODULE_REQ_HPP_
 
-#include <string>
+#include <initializer_list>
+#include <string_view>
+#include <util/slice.hpp>
 #include <vector>
 
 namespace mydss::module {
 
-using Req = std::vector<std::string>;
+// 请求的参数列表
+// 参数是指向缓冲区的 std::string_view，大多直接指向会话的接收缓冲区，不复制数据
+// Req 持有参数所在缓冲区的引用，因此参数在 Req 销毁前一直有效，
+// 命令只需要复制实际存储的参数，缓冲区在没有请求引用后被释放
+// 接收缓冲区来自线程的缓冲区池，因此 Req 必须在创建它的线程中销毁
+class Req {
+ public:
+  Req() = default;
+  // 复制 args 到 Req 自己分配的缓冲区中，用于构造测试中的请求
+  Req(std::initializer_list<std::string_view> args);
 
-}
+  [[nodiscard]] size_t size() const { return args_.size(); }
+  [[nodiscard]] bool empty() const { return args_.empty(); }
+  [[nodiscard]] std::string_view operator[](size_t i) const {
+    return args_[i];
+  }
+  [[nodiscard]] std::string_view front() const { return args_.front(); }
+  [[nodiscard]] std::string_view back() const { return args_.back(); }
+  [[nodiscard]] auto begin() const { return args_.begin(); }
+  [[nodiscard]] auto end() const { return args_.end(); }
+
+  void reserve(size_t n) { args_.reserve(n); }
+  void clear() {
+    args_.clear();
+    buf_ = util::Slice();
+    more_bufs_.clear();
+  }
+
+  // 追加一个位于 buf 中的参数，同一个缓冲区只会被引用一次
+  void Add(std::string_view arg, const util::Slice& buf) {
+    if (buf_.data() == nullptr) {
+      buf_ = buf;
+    } else if (buf_.data() != buf.data() &&
+               (more_bufs_.empty() || more_bufs_.back().data() != buf.data())) {
+      more_bufs_.push_back(buf);
+    }
+    args_.push_back(arg);
+  }
+  // 将位于 buf 中的参数复制到新分配的缓冲区中并释放对 buf 的引用
+  void Detach(const util::Slice& buf);
+
+  friend bool operator==(const Req& lhs, const Req& rhs) {
+    return lhs.args_ == rhs.args_;
+  }
+  friend bool operator!=(const Req& lhs, const Req& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  std::vector<std::string_view> args_;
+  // 参数所在的缓冲区，大多数请求只位于一个缓冲区中，因此第一个缓冲区单独存储，
+  // 避免为其分配数组
+  util::Slice buf_;
+  std::vector<util::Slice> more_bufs_;
+};
+
+}  // namespace mydss::module
 
 #endif  // MYDSS_INCLUDE_MODULE_REQ_HPP_
@@ -16,64 +16,91 @@
 #define MYDSS_INCLUDE_NET_ACCEPTOR_HPP_
 
 #include <functional>
-#include <list>
 
 #include "conn.hpp"
 #include "end_point.hpp"
 #include "loop.hpp"
+#include "sock_opts.hpp"
 
 namespace mydss::net {
 
-class Acceptor : public std::enable_shared_from_this<Acceptor> {
+class Acceptor : public std::enable_shared_from_this<Acceptor>,
+                 private Loop::Watcher {
  public:
-  // 接受连接事件的 handler
-  using AcceptHandler = std::function<void(err::Status)>;
+  // 接受到新连接时调用的 handler，连接已经被添加到事件循环中
+  using AcceptHandler = std::function<void(std::shared_ptr<Conn>)>;
+
+  // 每次可读事件最多接受的连接数目，剩余的连接在下一轮事件循环中接受，
+  // 避免大量涌入的连接使已经建立的连接上的请求饥饿
+  static constexpr int kMaxAcceptsPerIteration = 1000;
+  // 文件描述符或内存耗尽导致接受连接失败后重试的间隔，单位为毫秒
+  static constexpr uint64_t kAcceptRetryDelay = 100;
 
   // 保证所有的 Acceptor 对象都由 std::shared_ptr 持有
-  [[nodiscard]] static auto New(std::shared_ptr<Loop> loop, EndPoint ep) {
-    return std::shared_ptr<Acceptor>(new Acceptor(loop, std::move(ep)));
+  // opts 为监听套接字和每个接受的连接套接字的选项
+  [[nodiscard]] static auto New(std::shared_ptr<Loop> loop, EndPoint ep,
+                                SockOpts opts = {}) {
+    return std::shared_ptr<Acceptor>(
+        new Acceptor(loop, std::move(ep), std::move(opts)));
   }
 
   // 开始接受连接
   // backlog 传递给 listen 系统调用
-  [[nodiscard]] err::Status Start(int backlog);
+  // reuse_port 为 true 时设置 SO_REUSEPORT，允许多个 Acceptor 绑定同一个端点
+  // perm 为 Unix 域套接字文件的权限，为 0 时不修改
+  [[nodiscard]] err::Status Start(int backlog, bool reuse_port = false,
+                                  uint32_t perm = 0);
 
-  // 异步接受连接
-  void AsyncAccept(std::shared_ptr<Conn> conn, AcceptHandler handler);
+  // 使用从其他进程继承的、已经处于监听状态的套接字 fd，代替 Start
+  // 用于热升级，fd 的所有权转移给 Acceptor
+  [[nodiscard]] err::Status Inherit(int fd);
 
- private:
-  // 接收连接的请求
-  class Req;
+  // 停止接受连接并关闭监听套接字，已经接受的连接不受影响
+  // 其他进程持有的同一监听套接字仍然可以继续接受连接
+  void Stop();
 
-  // 构造 Acceptor 对象
-  explicit Acceptor(std::shared_ptr<Loop> loop, EndPoint ep)
-      : loop_(loop), listen_fd_(-1), ep_(std::move(ep)) {}
+  // 监听套接字，尚未开始监听或已经停止时为 -1
+  [[nodiscard]] int listen_fd() const { return listen_fd_; }
 
-  // 接受连接
-  err::Status Accept(std::shared_ptr<Conn> conn);
+  // 开始持续接受连接，每个新连接都从连接池中分配 Conn 对象并交给 handler
+  // 每次可读事件都会接受积压队列中的所有连接，直到 EAGAIN 或达到本轮的上限
+  // 只能调用一次
+  void Serve(AcceptHandler handler);
+
+ private:
+  // 构造 Acceptor 对象
+  Acceptor(std::shared_ptr<Loop> loop, EndPoint ep, SockOpts opts)
+      : loop_(loop),
+        listen_fd_(-1),
+        ep_(std::move(ep)),
+        opts_(std::move(opts)),
+        accept_op_(this, &Acceptor::OnUringAccept) {}
+
+  // 接受积压队列中的连接，直到 EAGAIN 或达到本轮的上限
+  void AcceptAll();
+  // 返回继续接受连接的任务，用于让出或出错后的重试
+  Loop::Handler Resume();
+  // 为连接套接字分配 Conn 对象并交给 handler_
+  void Deliver(int sock);
+  // 将已经建立的连接套接字交给 conn
+  err::Status Adopt(std::shared_ptr<Conn> conn, int sock);
 
   // 处理可以建立连接的事件
-  static void OnAccept(std::shared_ptr<Acceptor> acceptor);
+  void OnReadable() override;
+  // 使用 io_uring 引擎时，多次接受连接请求的完成事件处理函数
+  void OnUringAccept(int res, uint32_t flags);
 
  private:
   std::shared_ptr<Loop> loop_;  // 监听 listen_fd_ 的事件循环
   int listen_fd_;               // 监听套接字
   EndPoint ep_;                 // 绑定的端点
-  std::list<Req> reqs_;         // 建立连接的请求
-};
-
-class Acceptor::Req {
- public:
-  Req() = default;
-  Req(std::shared_ptr<Conn> conn, AcceptHandler handler)
-      : conn_(conn), handler_(std::move(handler)) {}
+  SockOpts opts_;               // 套接字选项
+  AcceptHandler handler_;       // 接受到新连接时调用的 handler
+  bool paused_ = false;         // 是否已让出或正在等待重试，此时忽略可读事件
 
-  [[nodiscard]] auto& conn() { return conn_; }
-  [[nodiscard]] const auto& handler() const { return handler_; }
-
- private:
-  std::shared_ptr<Conn> conn_;
-  AcceptHandler handler_;
+  // 以下成员仅在使用 io_uring 引擎时使用
+  Uring::MemberOp<Acceptor> accept_op_;
+  bool accept_armed_ = false;  // 多次接受连接请求是否仍在进行
 };
 
 }  // namespace mydss::net
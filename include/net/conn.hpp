@@ -15,40 +15,80 @@
 #ifndef MYDSS_INCLUDE_NET_CONN_HPP_
 #define MYDSS_INCLUDE_NET_CONN_HPP_
 
+#include <sys/socket.h>
+#include <sys/uio.h>
+
 #include <cassert>
 #include <list>
+#include <string>
+#include <util/pool.hpp>
 #include <util/slice.hpp>
+#include <utility>
+#include <vector>
 
 #include "end_point.hpp"
 #include "loop.hpp"
 
 namespace mydss::net {
 
-class Conn : public std::enable_shared_from_this<Conn> {
+class Conn : public std::enable_shared_from_this<Conn>,
+             private Loop::Watcher {
  public:
   using RecvHandler = std::function<void(err::Status, int64_t)>;
+  // 参数为接收到的数据，其长度即为接收的字节数
+  using RecvBufHandler = std::function<void(err::Status, util::Slice)>;
   using SendHandler = std::function<void(err::Status)>;
 
+  // 待发送的数据达到该大小时立即发送，而不是等到本轮事件分发结束
+  static constexpr size_t kFlushThreshold = 64 * 1024;
+  // 每次发送最多合并的请求数目
+  static constexpr int kMaxIovecs = 128;
+  // 每轮事件分发中每个连接最多读取的字节数，超出后让出到下一轮继续读取，
+  // 防止一个持续发送数据的客户端使其他客户端饥饿
+  static constexpr size_t kRecvBudget = 256 * 1024;
+  // 使用 io_uring 引擎时，没有接收请求且已接收但尚未被取走的数据达到该大小时
+  // 取消多次接收请求，使对端的发送受到 TCP 流量控制的限制
+  static constexpr size_t kMaxStash = kRecvBudget;
+  // 关闭连接后仍在等待零拷贝完成通知的数据保留的时间，单位为毫秒
+  static constexpr uint64_t kZerocopyLinger = 1000;
+
   // 保证所有的 Conn 对象都由 std::shared_ptr 持有
-  [[nodiscard]] static auto New() { return std::shared_ptr<Conn>(new Conn()); }
+  // Conn 对象的内存来自当前线程的对象池，因此必须在创建它的线程中销毁
+  [[nodiscard]] static std::shared_ptr<Conn> New();
+  // 在当前线程的对象池中预先分配 n 个 Conn 对象的内存
+  static void Reserve(size_t n);
 
   // Conn 对象在销毁前必须被关闭，防止文件描述符泄漏
   ~Conn() { assert(sock_ == -1); }
 
   [[nodiscard]] bool closed() const { return sock_ == -1; }
+  // 监听连接的事件循环，关闭后为 nullptr
+  [[nodiscard]] const auto& loop() const { return loop_; }
+  // 发送队列中尚未写入套接字的字节数
+  [[nodiscard]] size_t unsent_bytes() const { return unsent_bytes_; }
 
-  void Attach(std::shared_ptr<Loop> loop) {
-    assert(loop_ == nullptr);
-    assert(!loop->Contains(sock_));
-    loop_ = loop;
-  }
+  // 将连接添加到事件循环，需要在 Connect 之后调用
+  [[nodiscard]] err::Status Attach(std::shared_ptr<Loop> loop);
 
   // 异步接收数据
+  // 在接收回调中再次调用时，新的请求在回调返回后继续读取，直到套接字中没有数据
   void AsyncRecv(util::Slice slice, RecvHandler handler);
+  // 异步接收最多 size 字节的数据，缓冲区在有数据可读时才从当前线程的缓冲区池
+  // 中取出，因此等待数据的连接不持有接收缓冲区
+  // 回调返回后缓冲区在其最后一个引用被释放时放回缓冲区池
+  void AsyncRecv(size_t size, RecvBufHandler handler);
 
   // 发送 slice 中的数据，在发送完成后调用 handler
+  // 同一轮事件分发中的多个发送请求会被合并为一次 sendmsg 系统调用
   void AsyncSend(util::Slice slice, SendHandler handler);
 
+  // 发送的数据不小于 threshold 字节时使用 MSG_ZEROCOPY 发送，为 0 表示不使用
+  // 需要在 Attach 之后调用，使用 io_uring 引擎或套接字不支持时只记录阈值
+  void set_zerocopy_threshold(size_t threshold);
+  [[nodiscard]] auto zerocopy_threshold() const { return zerocopy_threshold_; }
+  // 是否使用 MSG_ZEROCOPY 发送，套接字不支持或者内核回退为复制发送时为 false
+  [[nodiscard]] bool zerocopy() const { return zerocopy_; }
+
   // 在建立连接时调用，将设置连接套接字 sock 和远程的地址
   void Connect(int sock, EndPoint remote) {
     sock_ = sock;
@@ -59,16 +99,54 @@ class Conn : public std::enable_shared_from_this<Conn> {
   void Close();
 
  private:
+  friend class util::Pool<Conn>;
+
   class RecvReq;
   class SendReq;
 
-  Conn() : sock_(-1) {}
+  Conn()
+      : sock_(-1),
+        recv_op_(this, &Conn::OnUringRecv),
+        send_op_(this, &Conn::OnUringSend) {}
 
   // 套接字可读事件的处理函数
   static void OnRecv(std::shared_ptr<Conn> conn);
   // 套接字可写事件的处理函数
   static void OnSend(std::shared_ptr<Conn> conn);
 
+  void OnReadable() override { OnRecv(shared_from_this()); }
+  void OnWritable() override { OnSend(shared_from_this()); }
+
+  // 将接收请求加入队列并尝试完成
+  void Recv(RecvReq req);
+  // 依次完成接收请求，直到套接字中没有数据、没有接收请求或超出本轮的读取额度
+  void DrainRecv();
+  // 发送发送队列中的数据，直到全部发送完成或套接字不可写
+  void Flush();
+  // 使用发送队列中尚未发送的数据填充 iov，返回填充的数目
+  int FillIovecs(iovec* iov) const;
+  // 完成已经发送了 nbytes 字节的发送请求
+  void CompleteSends(size_t nbytes);
+  // 发送出错时以 status 完成所有的发送请求
+  void FailSends(err::Status status);
+  // 从套接字的错误队列中读取零拷贝发送的完成通知，释放已经发送完成的数据
+  void ReapZerocopy();
+
+  // 以下函数仅在使用 io_uring 引擎时调用
+  void UringRecv(RecvReq req);
+  void UringClose();
+  // 将已接收的数据分发给等待中的接收请求
+  void DeliverRecv();
+  // 将发送队列中的数据作为一个 sendmsg 请求提交
+  void UringFlush();
+  // 接收和发送请求的完成事件处理函数
+  void OnUringRecv(int res, uint32_t flags);
+  void OnUringSend(int res, uint32_t flags);
+  // 在提交请求前调用，保证请求完成前 Conn 对象不会被销毁
+  void Pin();
+  // 在请求结束时调用
+  void Unpin();
+
  private:
   // 监听 Conn 读写事件的事件循环
   std::shared_ptr<Loop> loop_;
@@ -80,19 +158,78 @@ class Conn : public std::enable_shared_from_this<Conn> {
   std::list<RecvReq> recv_reqs_;
   // 发送数据的请求队列
   std::list<SendReq> send_reqs_;
+  // 队首的发送请求已经发送的字节数
+  size_t sent_ = 0;
+  // 发送队列中尚未发送的字节数
+  size_t unsent_bytes_ = 0;
+  // 套接字是否可读写，在读写返回 EAGAIN 时置为 false，在读写事件触发时置为 true
+  bool readable_ = true;
+  bool writable_ = true;
+  // 本轮事件分发中剩余的读取额度
+  size_t recv_budget_ = kRecvBudget;
+  // 是否正在 DrainRecv 中，此时新的接收请求只需加入队列
+  bool draining_ = false;
+  // 是否已经让出到下一轮继续读取
+  bool recv_yielded_ = false;
+  // 是否已经添加了在本轮事件分发结束后发送数据的任务
+  bool flush_deferred_ = false;
+  // 使用 MSG_ZEROCOPY 发送的数据大小的阈值，为 0 表示不使用
+  size_t zerocopy_threshold_ = 0;
+  // 是否使用 MSG_ZEROCOPY，内核回退为复制发送时置为 false
+  bool zerocopy_ = false;
+  // 下一次零拷贝发送的序号，与内核为套接字维护的计数保持一致
+  uint32_t zerocopy_seq_ = 0;
+  // 等待完成通知的零拷贝发送的序号及其引用的数据，数据在通知到达前不能被释放
+  // 使用 std::list 而不是 std::deque，后者在为空时也会分配内存
+  std::list<std::pair<uint32_t, std::vector<util::Slice>>> zerocopy_pending_;
+
+  // 以下成员仅在使用 io_uring 引擎时使用
+  Uring* uring_ = nullptr;
+  Uring::MemberOp<Conn> recv_op_;
+  Uring::MemberOp<Conn> send_op_;
+  // 尚未结束的请求数目，不为 0 时 pinned_ 持有 Conn 对象自身
+  int inflight_ = 0;
+  std::shared_ptr<Conn> pinned_;
+  // 多次接收请求是否仍在进行
+  bool recv_armed_ = false;
+  // 已接收但尚未被接收请求取走的数据，有等待中的接收请求时数据直接交给请求，
+  // 只在上层暂停接收或请求的缓冲区不足时使用，取空后释放其内存
+  std::string stash_;
+  size_t stash_off_ = 0;
+  // 接收时遇到的 EOF 或错误
+  err::Status recv_status_ = err::Status::Ok();
+  // 是否有正在进行的 sendmsg 请求，同一时刻最多只有一个
+  bool send_inflight_ = false;
+  // 正在进行的 sendmsg 请求的参数，在请求完成前必须保持有效
+  // 只在有数据需要发送时分配，发送完成后释放，使空闲的连接不占用这部分内存
+  struct SendMsg {
+    msghdr msg;
+    iovec iov[kMaxIovecs];
+  };
+  std::unique_ptr<SendMsg> send_msg_;
 };
 
 class Conn::RecvReq {
  public:
   RecvReq(const util::Slice& slice, Conn::RecvHandler handler)
       : slice_(slice), handler_(std::move(handler)) {}
-
-  [[nodiscard]] const auto& slice() const { return slice_; }
-  [[nodiscard]] const auto& handler() const { return handler_; }
+  // 缓冲区延迟到读取时分配的请求
+  RecvReq(size_t size, Conn::RecvBufHandler handler)
+      : size_(size), buf_handler_(std::move(handler)) {}
+
+  // 在读取前调用，返回接收数据的缓冲区
+  // 延迟分配的请求此时从缓冲区池中取出不超过 size_ 和 hint 的缓冲区
+  const util::Slice& Buf(size_t hint = SIZE_MAX);
+  // 读取返回 EAGAIN 时调用，延迟分配的请求将缓冲区放回缓冲区池
+  void Release();
+  // 以接收到的 nbytes 字节数据完成请求
+  void Complete(err::Status status, size_t nbytes);
 
  private:
   util::Slice slice_;
   Conn::RecvHandler handler_;
+  size_t size_ = 0;  // 延迟分配的缓冲区的最大大小，为 0 表示不延迟分配
+  Conn::RecvBufHandler buf_handler_;
 };
 
 class Conn::SendReq {
@@ -27,7 +27,8 @@
 namespace mydss::net {
 
 // 通信端点，包括 IP 地址和端口号
-// 支持 IPv4 和 IPv6
+// 支持 IPv4、IPv6 和 Unix 域套接字，Unix 域套接字的 ip 为套接字文件的路径，
+// 端口号为 0
 class EndPoint {
  public:
   EndPoint() : type_(InetType::kIPv4), ip_{}, port_(0) {}
@@ -49,7 +50,7 @@ class EndPoint {
 
  private:
   InetType type_;   // 网际协议类型
-  std::string ip_;  // IP 地址， IPv4 或 IPv6
+  std::string ip_;  // IP 地址， IPv4 或 IPv6，或 Unix 域套接字的路径
   uint16_t port_;   // 端口号
 };
 
@@ -0,0 +1,25 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_NET_ENGINE_HPP_
+#define MYDSS_INCLUDE_NET_ENGINE_HPP_
+
+namespace mydss::net {
+
+// 事件循环使用的 I/O 引擎
+enum class Engine { kEpoll, kUring };
+
+}  // namespace mydss::net
+
+#endif  // MYDSS_INCLUDE_NET_ENGINE_HPP_
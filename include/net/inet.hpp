@@ -17,8 +17,8 @@
 
 namespace mydss::net {
 
-// IP 层协议类型
-enum class InetType { kIPv4, kIPv6 };
+// 地址类型，kUnix 表示 Unix 域套接字
+enum class InetType { kIPv4, kIPv6, kUnix };
 
 }  // namespace mydss::net
 
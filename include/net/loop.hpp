@@ -16,45 +16,219 @@
 #define MYDSS_INCLUDE_NET_LOOP_HPP_
 
 #include <sys/epoll.h>
+#include <sys/types.h>
 
+#include <atomic>
 #include <cassert>
 #include <err/status.hpp>
 #include <functional>
 #include <memory>
-#include <unordered_map>
+#include <util/mpsc_queue.hpp>
+#include <vector>
+
+#include "engine.hpp"
+#include "timer.hpp"
+#include "uring.hpp"
 
 namespace mydss::net {
 
-// 事件循环，监听文件描述符的读写事件，并在事件触发时调用对应的 handler
+// 事件循环的统计信息
+struct LoopStats {
+  uint64_t polls = 0;   // 调用 epoll_wait 的次数
+  uint64_t events = 0;  // 分发的事件数目
+  uint64_t timers = 0;  // 执行的定时器数目
+  uint64_t posts = 0;   // 执行的通过 Post 提交的任务数目
+};
+
+// 忙等待的统计信息，由事件循环线程更新，可以在任意线程中读取
+// 时间的单位为微秒
+struct BusyPollStats {
+  pid_t tid = 0;  // 运行事件循环的线程 ID
+  std::atomic<uint64_t> budget{0};  // 每轮忙等待的时间上限
+  std::atomic<uint64_t> spins{0};   // 忙等待中以 0 超时轮询的次数
+  // 忙等待的时间，即事件循环为了更早地获取事件而额外消耗的 CPU 时间
+  std::atomic<uint64_t> spin_time{0};
+  // 处理事件、定时器和任务的时间，不包括等待事件的时间
+  std::atomic<uint64_t> work_time{0};
+  // 忙等待超出时间上限后转为阻塞等待的次数
+  std::atomic<uint64_t> sleeps{0};
+};
+
+// 事件循环，监听文件描述符的读写事件，并在事件触发时调用对应的 Watcher
 // 监听采用边缘触发模式
+// 使用 io_uring 引擎时，Conn 和 Acceptor 的读写请求通过 io_uring 完成，
+// 通过 Add 监听的文件描述符仍由 epoll 监听，epoll 文件描述符本身由 io_uring 监听
 class Loop {
  public:
   using Handler = std::function<void()>;
 
+  // 文件描述符读写事件的处理者，由 Conn 和 Acceptor 等拥有文件描述符的对象实现
+  // Watcher 的地址直接存储在 epoll_event 中，因此 Watcher 在销毁前必须从
+  // Loop 中移除
+  class Watcher {
+   public:
+    virtual void OnReadable() {}
+    virtual void OnWritable() {}
+
+   protected:
+    ~Watcher() = default;
+  };
+
+  // 每次调用 epoll_wait 最多获取的事件数目的默认值
+  static constexpr int kDefaultMaxEvents = 128;
+  // 每轮最多执行的通过 Post 提交的任务数目，剩余的任务在下一轮执行
+  static constexpr size_t kMaxPostsPerIteration = 4096;
+
   // 确保 Loop 对象一定被 std::shared_ptr 持有
-  [[nodiscard]] static auto New() { return std::shared_ptr<Loop>(new Loop()); }
+  // max_events 为每次调用 epoll_wait 最多获取的事件数目
+  // engine 为 Engine::kUring 但当前系统不支持时回退到 epoll
+  [[nodiscard]] static auto New(int max_events = kDefaultMaxEvents,
+                                Engine engine = Engine::kEpoll) {
+    return std::shared_ptr<Loop>(new Loop(max_events, engine));
+  }
+
+  ~Loop();
 
-  // 设置读事件的 handler
-  [[nodiscard]] err::Status SetInEvent(int fd, Handler handler);
-  // 设置写事件的 handler
-  [[nodiscard]] err::Status SetOutEvent(int fd, Handler handler);
-  // 从事件循环中移除 fd
+  // 监听 fd 的事件，events 为 EPOLLIN 和 EPOLLOUT 的组合
+  // 事件触发时调用 watcher 的 OnReadable 或 OnWritable
+  [[nodiscard]] err::Status Add(int fd, uint32_t events, Watcher* watcher);
+  // 修改 fd 监听的事件
+  [[nodiscard]] err::Status Modify(int fd, uint32_t events);
+  // 从事件循环中移除 fd，并使本批次中尚未分发的 fd 的事件失效
   [[nodiscard]] err::Status Remove(int fd);
   // 判断 fd 是否被 Loop 监听
-  [[nodiscard]] bool Contains(int fd) { return fds_.find(fd) != fds_.end(); }
+  [[nodiscard]] bool Contains(int fd) const {
+    return fd >= 0 && static_cast<size_t>(fd) < entries_.size() &&
+           entries_[fd].watcher != nullptr;
+  }
+
+  // 在本轮事件分发结束后执行 task，用于合并同一轮中产生的写操作
+  // 只能在运行事件循环的线程中调用
+  void Defer(Handler task) { deferred_.push_back(std::move(task)); }
+  // 在下一轮事件分发结束后执行 task，下一轮不会阻塞等待事件
+  // 用于将一个连接上的大量工作分摊到多轮中，使其他连接的事件先被处理
+  // 只能在运行事件循环的线程中调用
+  void Yield(Handler task) { yielded_.push_back(std::move(task)); }
+
+  // 在事件循环的线程中执行 task，可以在任意线程中调用
+  // 同一线程提交的任务按提交的顺序执行
+  void Post(Handler task);
+
+  // 添加在 delay 毫秒后执行一次的定时器
+  TimerId RunAfter(uint64_t delay, Handler cb) {
+    return timers_.Add(delay, std::move(cb));
+  }
+  // 添加每隔 interval 毫秒执行一次的定时器，interval 必须大于 0
+  TimerId RunEvery(uint64_t interval, Handler cb) {
+    assert(interval > 0);
+    return timers_.Add(interval, interval, std::move(cb));
+  }
+  // 取消定时器，可以在定时器的回调中调用
+  void Cancel(TimerId id) { timers_.Cancel(id); }
+
+  // 单调时钟的当前时间，单位为毫秒
+  [[nodiscard]] static uint64_t Now();
+
+  [[nodiscard]] const auto& stats() const { return stats_; }
+
+  // 开启忙等待，每轮在阻塞等待事件之前先以 0 超时反复轮询最多 budget 微秒，
+  // 以消耗 CPU 为代价减少事件到达后唤醒线程的延迟，为 0 表示关闭
+  // 必须在运行事件循环的线程中调用
+  void set_busy_poll(uint64_t budget);
+  [[nodiscard]] auto busy_poll() const { return busy_poll_; }
+  // 开启忙等待时返回其统计信息，否则返回 nullptr
+  [[nodiscard]] const auto& busy_stats() const { return busy_stats_; }
+  // 所有开启了忙等待且尚未销毁的事件循环的统计信息，可以在任意线程中调用
+  [[nodiscard]] static std::vector<std::shared_ptr<const BusyPollStats>>
+  AllBusyStats();
+
+  // 实际使用的 I/O 引擎
+  [[nodiscard]] Engine engine() const {
+    return uring_ != nullptr ? Engine::kUring : Engine::kEpoll;
+  }
+  // 使用 epoll 引擎时返回 nullptr
+  [[nodiscard]] Uring* uring() const { return uring_.get(); }
 
   // 运行事件循环
   [[noreturn]] void Run();
 
+  // 等待一次事件并分发本批次获取到的所有事件
+  // timeout 为等待的超时时间，单位为毫秒，-1 表示一直等待
+  void RunOnce(int timeout);
+
  private:
-  Loop() : epfd_(epoll_create(1)) { assert(epfd_ != -1); }
+  // 监听 eventfd，在其他线程提交任务后唤醒事件循环
+  class Notifier : public Watcher {
+   public:
+    explicit Notifier(Loop* loop) : loop_(loop) {}
+    void OnReadable() override { loop_->OnNotified(); }
+
+   private:
+    Loop* loop_;
+  };
+
+  // 以 fd 为下标的监听记录
+  struct Entry {
+    Watcher* watcher = nullptr;  // 事件的处理者，为 nullptr 表示未被监听
+    uint32_t events = 0;         // 监听的事件
+  };
+
+  Loop(int max_events, Engine engine);
+
+  // 调用 epoll_wait 等待一批事件
+  void Wait(int timeout);
+  // 以 0 超时反复轮询，直到有事件就绪或超出忙等待的时间上限，返回是否有事件就绪
+  // 使用 epoll 引擎时就绪的事件已经被 Wait 获取，由调用者分发
+  bool Spin(int timeout);
+  // 分发 Wait 获取到的事件
+  void Dispatch();
+  // 使用 io_uring 引擎时，epoll 文件描述符可读的处理函数
+  void OnEpollReady(int res, uint32_t flags);
+  // 执行所有延迟的任务，包括执行过程中新添加的任务
+  void RunDeferred();
+  // 根据最近的定时器缩短等待的超时时间
+  int Timeout(int timeout) const;
+  // eventfd 可读时的处理函数
+  void OnNotified();
+  // 批量执行通过 Post 提交的任务
+  void RunPosted();
 
  private:
   // epoll 文件描述符
   int epfd_;
-  // 添加到事件循环的文件描述符
-  // key 为 fd，value 分别为该 fd 的读事件 handler 和写事件 handler
-  std::unordered_map<int, std::pair<Handler, Handler>> fds_;
+  // 以 fd 为下标的监听记录，大小随监听的最大 fd 增长
+  std::vector<Entry> entries_;
+  // 被监听的 fd 的数目
+  size_t nfds_;
+  // epoll_wait 获取到的事件，其大小即为每批次最多获取的事件数目
+  std::vector<epoll_event> events_;
+  // 正在分发的事件在 events_ 中的下标
+  int cur_;
+  // 本批次获取到的事件数目
+  int nevents_;
+  // 统计信息
+  LoopStats stats_;
+  // 延迟到本轮事件分发结束后执行的任务
+  std::vector<Handler> deferred_;
+  // 让出到下一轮事件分发结束后执行的任务
+  std::vector<Handler> yielded_;
+  // 定时器
+  TimerWheel timers_;
+  // 其他线程通过 Post 提交的任务
+  util::MpscQueue<Handler> posted_;
+  // 用于唤醒事件循环的 eventfd
+  int notify_fd_;
+  // 是否已经写入 eventfd 且事件循环尚未开始执行任务，为 true 时 Post 不需要
+  // 再写入 eventfd
+  std::atomic<bool> notified_;
+  Notifier notifier_;
+  // io_uring 实例，使用 epoll 引擎时为 nullptr
+  std::unique_ptr<Uring> uring_;
+  // 监听 epoll 文件描述符的请求
+  Uring::MemberOp<Loop> epoll_op_;
+  // 每轮忙等待的时间上限，单位为微秒，为 0 表示不忙等待
+  uint64_t busy_poll_ = 0;
+  std::shared_ptr<BusyPollStats> busy_stats_;
 };
 
 }  // namespace mydss::net
@@ -0,0 +1,56 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_NET_SOCK_OPTS_HPP_
+#define MYDSS_INCLUDE_NET_SOCK_OPTS_HPP_
+
+#include <err/status.hpp>
+
+#include "inet.hpp"
+
+namespace mydss::net {
+
+// 监听套接字和连接套接字的选项，值为 0 表示使用内核的默认值
+// TCP 相关的选项对 Unix 域套接字无效，会被忽略
+struct SockOpts {
+  // TCP_NODELAY，关闭 Nagle 算法，避免较小的回复被延迟发送
+  bool nodelay = true;
+  // SO_SNDBUF 和 SO_RCVBUF，单位为字节
+  int sndbuf = 0;
+  int rcvbuf = 0;
+  // 连接空闲该秒数后开始发送 keepalive 探测，此后每隔三分之一的时间探测一次，
+  // 连续 3 次没有响应时断开连接
+  int keepalive = 0;
+  // TCP_DEFER_ACCEPT，连接建立后最多等待该秒数，直到收到数据才接受连接
+  int defer_accept = 0;
+  // SO_BUSY_POLL，在接收队列为空时忙等待该微秒数
+  int busy_poll = 0;
+  // TCP_FASTOPEN，等待接受的 Fast Open 连接的最大数目
+  int fastopen = 0;
+  // SO_INCOMING_CPU，设置在监听套接字上，为 -1 表示不设置
+  // 多个线程通过 SO_REUSEPORT 监听同一地址时，内核优先将新连接分配给该值与
+  // 处理其数据包的 CPU 相同的监听套接字，使连接由网卡队列所在 CPU 上的线程处理
+  int incoming_cpu = -1;
+};
+
+// 设置监听套接字的选项，即 defer_accept、fastopen 和 incoming_cpu
+[[nodiscard]] err::Status ApplyListenOpts(int fd, InetType type,
+                                          const SockOpts& opts);
+// 设置连接套接字的选项，即除 defer_accept、fastopen 和 incoming_cpu 以外的选项
+[[nodiscard]] err::Status ApplyConnOpts(int fd, InetType type,
+                                        const SockOpts& opts);
+
+}  // namespace mydss::net
+
+#endif  // MYDSS_INCLUDE_NET_SOCK_OPTS_HPP_
@@ -0,0 +1,121 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_NET_TIMER_HPP_
+#define MYDSS_INCLUDE_NET_TIMER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace mydss::net {
+
+// 定时器的句柄，用于取消定时器
+// 定时器结束后句柄失效，对失效的句柄调用 Cancel 没有任何效果
+class TimerId {
+ public:
+  TimerId() = default;
+
+  [[nodiscard]] bool valid() const { return gen_ != 0; }
+
+ private:
+  friend class TimerWheel;
+
+  TimerId(uint32_t index, uint32_t gen) : index_(index), gen_(gen) {}
+
+  uint32_t index_ = 0;  // 定时器在节点池中的下标
+  uint32_t gen_ = 0;    // 节点被复用时递增，用于识别失效的句柄
+};
+
+// 分层时间轮，时间的单位为毫秒，每个刻度为 1 毫秒
+// 共 4 层，每层 256 个槽，第 i 层的每个槽覆盖 256^i 个刻度
+// 添加和取消定时器的时间复杂度为 O(1)，定时器在到期前最多被移动 3 次
+// 定时器节点存放在节点池中并被复用，添加定时器不需要额外分配节点
+class TimerWheel {
+ public:
+  using Callback = std::function<void()>;
+
+  // now 为当前时间
+  explicit TimerWheel(uint64_t now);
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // 添加在 delay 毫秒后执行一次的定时器
+  TimerId Add(uint64_t delay, Callback cb) {
+    return Add(delay, 0, std::move(cb));
+  }
+  // 添加在 delay 毫秒后执行的定时器，interval 不为 0 时此后每隔 interval
+  // 毫秒执行一次，直到被取消
+  TimerId Add(uint64_t delay, uint64_t interval, Callback cb);
+  // 取消定时器，可以在定时器的回调中调用
+  void Cancel(TimerId id);
+
+  // 将时间推进到 now，并执行所有到期的定时器，返回执行的定时器数目
+  size_t Advance(uint64_t now);
+
+  // 下一次需要调用 Advance 的时间，没有定时器时返回 UINT64_MAX
+  // 最近的定时器在较高的层中时，返回该层下一次移动定时器的时间
+  [[nodiscard]] uint64_t NextDeadline() const;
+
+  // 尚未结束的定时器数目
+  [[nodiscard]] size_t size() const { return size_; }
+
+ private:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 8;
+  static constexpr uint32_t kSlots = 1 << kSlotBits;
+  static constexpr uint32_t kNil = UINT32_MAX;
+
+  // 定时器的状态
+  enum class State : uint8_t { kFree, kPending, kRunning, kCancelled };
+
+  struct Node {
+    uint64_t expire = 0;    // 到期时间
+    uint64_t interval = 0;  // 周期，为 0 表示只执行一次
+    Callback cb;
+    uint32_t prev = kNil;  // 所在槽的双向链表
+    uint32_t next = kNil;
+    uint32_t gen = 1;
+    uint16_t slot = 0;  // 所在的层和槽，用于从链表中移除
+    State state = State::kFree;
+  };
+
+  // 将节点插入到与其到期时间对应的槽中，到期时间早于 min_tick 时视为 min_tick
+  void Insert(uint32_t index, uint64_t min_tick);
+  // 将节点从所在的槽中移除
+  void Unlink(uint32_t index);
+  // 将第 level 层当前槽中的定时器移动到较低的层
+  void Cascade(int level);
+  // 释放节点
+  void Free(uint32_t index);
+
+ private:
+  uint64_t now_;  // 最后一个已经处理的刻度
+  size_t size_ = 0;
+  // 节点池，deque 在尾部添加元素时不会移动已有的元素，
+  // 因此回调执行时可以安全地添加定时器
+  std::deque<Node> nodes_;
+  std::vector<uint32_t> free_;  // 空闲的节点
+  // 每个槽中链表的头节点
+  uint32_t slots_[kLevels][kSlots];
+  // 每层中定时器的数目
+  size_t counts_[kLevels] = {};
+};
+
+}  // namespace mydss::net
+
+#endif  // MYDSS_INCLUDE_NET_TIMER_HPP_
@@ -0,0 +1,150 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_NET_URING_HPP_
+#define MYDSS_INCLUDE_NET_URING_HPP_
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <err/status.hpp>
+#include <memory>
+
+namespace mydss::net {
+
+// io_uring 实例，直接使用系统调用而不依赖 liburing
+// 准备好的请求不会立即提交，而是在下一次调用 Submit 或 SubmitAndWait 时
+// 批量提交给内核，完成事件也在 Reap 中批量处理
+class Uring {
+ public:
+  // 完成事件的处理者，其地址作为 SQE 的 user_data
+  class Op {
+   public:
+    virtual void OnComplete(int res, uint32_t flags) = 0;
+
+   protected:
+    ~Op() = default;
+  };
+
+  // 将完成事件转发给 T 的成员函数
+  template <typename T>
+  class MemberOp : public Op {
+   public:
+    using Fn = void (T::*)(int res, uint32_t flags);
+
+    MemberOp(T* obj, Fn fn) : obj_(obj), fn_(fn) {}
+
+    void OnComplete(int res, uint32_t flags) override {
+      (obj_->*fn_)(res, flags);
+    }
+
+   private:
+    T* obj_;
+    Fn fn_;
+  };
+
+  static constexpr unsigned kEntries = 1024;  // SQ 的大小，CQ 为其 4 倍
+  static constexpr unsigned kBufCount = 256;  // 提供给内核的接收缓冲区数目
+  static constexpr unsigned kBufSize = 4096;  // 每个接收缓冲区的大小
+  static constexpr uint16_t kBufGroup = 0;    // 接收缓冲区的组 ID
+
+  // 创建 io_uring 实例，内核不支持多次接受连接、多次接收和提供缓冲区环时
+  // 返回错误
+  [[nodiscard]] static err::Status New(std::unique_ptr<Uring>& result);
+
+  Uring(const Uring&) = delete;
+  Uring& operator=(const Uring&) = delete;
+  ~Uring();
+
+  // 以下函数准备请求并返回对应的 SQE，调用者可以继续修改 SQE 的 flags
+  // 在 SQ 已满时会先提交已经准备好的请求
+  // 持续接受连接，每个新连接产生一个完成事件
+  io_uring_sqe* PrepAcceptMultishot(int fd, Op* op);
+  // 持续接收数据，数据存放在内核从缓冲区环中选择的缓冲区中
+  io_uring_sqe* PrepRecvMultishot(int fd, Op* op);
+  // 发送 msg 中的全部数据，msg 在请求完成前必须保持有效
+  io_uring_sqe* PrepSendMsg(int fd, const msghdr* msg, Op* op);
+  // 持续监听 fd 的可读事件
+  io_uring_sqe* PrepPollMultishot(int fd, Op* op);
+  // 取消 fd 上所有尚未完成的请求
+  io_uring_sqe* PrepCancelFd(int fd);
+  // 取消处理者为 op 的请求，被取消的请求以 -ECANCELED 完成
+  io_uring_sqe* PrepCancel(Op* op);
+  // 关闭 fd
+  io_uring_sqe* PrepClose(int fd);
+
+  // SQ 中剩余的空闲 SQE 数目
+  [[nodiscard]] unsigned SqSpace() const;
+
+  // 提交所有已准备的请求
+  [[nodiscard]] err::Status Submit();
+  // 提交所有已准备的请求，并等待至少一个完成事件
+  // timeout 为超时时间，单位为毫秒，-1 表示一直等待
+  [[nodiscard]] err::Status SubmitAndWait(int timeout);
+  // 处理所有已完成的事件，返回处理的事件数目
+  size_t Reap();
+  // CQ 中是否有尚未处理的完成事件
+  [[nodiscard]] bool HasCompletions() const {
+    return *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  }
+
+  // 获取内核选择的接收缓冲区
+  [[nodiscard]] const char* Buf(uint16_t bid) const {
+    return bufs_ + static_cast<size_t>(bid) * kBufSize;
+  }
+  // 将接收缓冲区归还给内核
+  void RecycleBuf(uint16_t bid);
+
+ private:
+  Uring() = default;
+
+  // 初始化 io_uring 实例
+  err::Status Init();
+  // 获取一个空闲的 SQE 并清零
+  io_uring_sqe* GetSqe();
+  // 将准备好的 SQE 发布给内核并调用 io_uring_enter
+  err::Status Enter(unsigned min_complete, int timeout);
+
+ private:
+  int fd_ = -1;  // io_uring 文件描述符
+
+  // SQ 和 CQ 映射的内存
+  void* sq_ring_ = nullptr;
+  size_t sq_ring_size_ = 0;
+  void* cq_ring_ = nullptr;
+  size_t cq_ring_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned sq_entries_ = 0;
+  unsigned sqe_tail_ = 0;  // 已准备但可能尚未发布的 SQE 的尾部
+
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+
+  // 提供给内核的接收缓冲区环
+  io_uring_buf_ring* buf_ring_ = nullptr;
+  char* bufs_ = nullptr;
+  uint16_t buf_tail_ = 0;
+};
+
+}  // namespace mydss::net
+
+#endif  // MYDSS_INCLUDE_NET_URING_HPP_
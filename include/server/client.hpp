@@ -16,6 +16,7 @@
 #define MYDSS_INCLUDE_SERVER_CLIENT_HPP_
 
 #include <cstdint>
+#include <module/piece.hpp>
 #include <string>
 
 namespace mydss::server {
@@ -25,9 +26,12 @@ class Client {
  public:
   [[nodiscard]] const auto& name() const { return name_; }
   void set_name(std::string name) { name_ = std::move(name); }
+  [[nodiscard]] auto proto() const { return proto_; }
+  void set_proto(module::Proto proto) { proto_ = proto; }
 
  private:
-  std::string name_;  // 客户端的名称
+  std::string name_;                             // 客户端的名称
+  module::Proto proto_ = module::Proto::kResp2;  // 回复使用的协议版本
 };
 
 }  // namespace mydss::server
@@ -17,75 +17,65 @@
 
 #include <err/status.hpp>
 #include <module/req.hpp>
+#include <string>
+#include <string_view>
+#include <util/slice.hpp>
 #include <vector>
 
 namespace mydss::server {
 
-// 解析 bulk string
-// BulkStringParser 从不在内部调用 Reset，因此使用者必须在需要重置
-// BulkStringParser 的状态时调用 Reset
-class BulkStringParser {
- public:
-  // 重置解析器的内部状态
-  void Reset();
-
-  // 进行一次状态转移，如果解析出一个完整的字符串，completed 设置为 true，否则为
-  // false
-  [[nodiscard]] err::Status Step(char ch, bool* completed);
-
-  // 将解析得到的字符串移出
-  // 再次使用该解析器时应该调用 Reset
-  [[nodiscard]] std::string MoveOut() { return std::move(value_); }
-
- private:
-  enum class State {
-    kTypeChar,     // 期待接收表示 bluk string 类型的字符，即 '$'
-    kLenFirstNum,  // 期待接收到字符串长度的第一个数字字符
-    kLen,          // 正在接收字符串长度
-    kLenN,         // 期待接收字符串长度后的 '\n'
-    kData,         // 接收字符串的数据部分
-    kR,            // 期待接收到字符串结尾的 '\r'
-    kN             // 期待接收到字符串结尾的 '\n'
-  };
-
- private:
-  State state_;          // 解析器的内部状态
-  std::string value_;    // bulk string  的值
-  uint64_t target_len_;  // 期待的 bulk string 长度
-  uint64_t cur_len_;     // 当前已经读取到的 bulk string 的长度
-};
-
-// 解析请求
-// 与 BulkStringParser 不同，ReqParser 在解析完一个请求后会自动重置状态
+// 解析请求，请求为元素都是 bulk string 的数组，或者以空白分隔参数的一行内联请求
+// 内联请求以 "\n" 或 "\r\n" 结尾，参数可以使用单引号或双引号包含空白，
+// 双引号中支持 "\n"、"\xHH" 等转义，与 redis-cli 的规则相同
+// 不包含引号的内联请求（例如健康检查发送的 "PING\r\n"）的参数直接指向接收的数据
+// 解析器按段扫描数据：头部（"*<数组长度>\r\n" 和 "$<字符串长度>\r\n"）的行尾
+// 和长度由 util/scan.hpp 中的向量化函数查找和解析
+// 完整地位于一段数据中的字符串不复制，请求的参数直接指向这段数据，
+// 跨越多段数据的字符串复制到解析器分配的缓冲区中
+// 请求可以跨越多段数据，不完整的头部和请求保存在解析器中，在下一段数据到来时
+// 继续，此时请求中指向本段数据的参数会被复制，因此解析器不会持有接收缓冲区
+// ReqParser 在解析完一个请求后会自动重置状态
 class ReqParser {
  public:
-  ReqParser() { Reset(); }
+  // 头部的最大长度，包括类型字符和结尾的 "\r\n"
+  static constexpr size_t kMaxHeaderLen = 32;
 
-  // 解析一段数据
-  [[nodiscard]] err::Status Parse(const char* buf, size_t len,
+  // 解析一段数据，将解析出的完整请求依次追加到 reqs 中，请求持有 buf 的引用
+  // 返回错误后解析器的状态不确定，不能再继续使用
+  [[nodiscard]] err::Status Parse(const util::Slice& buf,
                                   std::vector<module::Req>& reqs);
 
  private:
   enum class State {
-    kArrayChar,  // 期待下一个接收的字符为表示数组的字符，即 '*'
-    kArrayLenFirstNum,  // 期待接收到数组长度的第一个数字字符
-    kArrayLen,          // 正在接收数组长度
-    kArrayN,            // 期待接收数组长度后的 \n
-    kStr                // 接收字符串
+    kArrayHeader,  // 接收数组的头部，或者内联请求的第一个字节
+    kInline,       // 接收内联请求
+    kBulkHeader,   // 接收字符串的头部
+    kBulkData,     // 接收字符串的数据部分
+    kBulkEnd       // 接收字符串结尾的 "\r\n"
   };
 
-  // 重置解析器的内部状态
-  void Reset();
-
-  // 进行一次状态转移，如果解析出一个完整的请求，completed 设置为 true，否则为
-  // false
-  [[nodiscard]] err::Status Step(char ch, bool* completed);
+  // 从 [p, end) 中读取一行类型字符为 type 的头部，并解析其中不超过 max 的长度
+  // 读取到完整的头部时将 completed 设置为 true，p 移动到头部之后
+  // 头部不完整时保存已读取的部分，p 移动到 end
+  // name 为头部所属的类型在错误信息中的名称
+  [[nodiscard]] err::Status ReadHeader(const char*& p, const char* end,
+                                       char type, const char* name,
+                                       uint64_t max, bool& completed,
+                                       uint64_t& len);
+  // 将内联请求的一行 line 分割为参数添加到 req_ 中，line 位于 buf 中
+  [[nodiscard]] err::Status SplitInline(std::string_view line,
+                                        const util::Slice& buf);
 
  private:
-  State state_;                  // 解析器的内部状态
-  module::Req req_;              // 正在解析的请求
-  uint64_t array_len_;           // 数组的长度
-  BulkStringParser str_parser_;  // 字符串部分的解析器
+  State state_ = State::kArrayHeader;  // 解析器的内部状态
+  std::string header_;                 // 跨越多段数据的不完整的头部
+  std::string inline_;                 // 跨越多段数据的不完整的内联请求
+  module::Req req_;                    // 正在解析的请求
+  uint64_t array_len_ = 0;             // 数组的长度
+  uint64_t bulk_len_ = 0;              // 正在接收的字符串的长度
+  util::Slice bulk_;                   // 跨越多段数据的字符串的缓冲区
+  size_t bulk_recvd_ = 0;              // bulk_ 中已经接收的字节数
+  size_t end_len_ = 0;                 // 已经接收的字符串结尾的字节数
 };
 
 }  // namespace mydss::server
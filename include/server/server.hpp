@@ -24,21 +24,38 @@ namespace mydss::server {
 
 class Server : public std::enable_shared_from_this<Server> {
  public:
-  static auto New(std::shared_ptr<net::Loop> loop, ServerConfig config) {
-    return std::shared_ptr<Server>(new Server(loop, std::move(config)));
+  // 启动时为每个事件循环预先分配的连接对象数目
+  static constexpr size_t kPreallocConns = 128;
+
+  // client 为对所有地址生效的客户端配置
+  static auto New(std::shared_ptr<net::Loop> loop, ServerConfig config,
+                  ClientConfig client = {}) {
+    return std::shared_ptr<Server>(
+        new Server(loop, std::move(config), std::move(client)));
   }
 
+  // 开始接受连接，有从旧进程继承的监听套接字时直接使用
   [[nodiscard]] err::Status Start();
+  // 停止接受连接，已有的会话不受影响，只能在事件循环的线程中调用
+  void Stop() { acceptor_->Stop(); }
+
+  [[nodiscard]] const auto& config() const { return config_; }
+  // 监听套接字，停止后为 -1
+  [[nodiscard]] int listen_fd() const { return acceptor_->listen_fd(); }
 
  private:
-  Server(std::shared_ptr<net::Loop> loop, ServerConfig config)
-      : loop_(loop), config_(std::move(config)) {}
+  Server(std::shared_ptr<net::Loop> loop, ServerConfig config,
+         ClientConfig client)
+      : loop_(loop), config_(std::move(config)), client_(std::move(client)) {}
 
   static void OnAccept(std::shared_ptr<Server> server,
                        std::shared_ptr<net::Conn> conn);
+  // 客户端数目达到上限时，向新的连接发送错误回复后关闭连接
+  static void Reject(std::shared_ptr<net::Conn> conn);
 
  private:
   ServerConfig config_;
+  ClientConfig client_;
   std::shared_ptr<net::Loop> loop_;
   std::shared_ptr<net::Acceptor> acceptor_;
 };
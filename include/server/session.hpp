@@ -15,9 +15,15 @@
 #ifndef MYDSS_INCLUDE_SERVER_SESSION_HPP_
 #define MYDSS_INCLUDE_SERVER_SESSION_HPP_
 
+#include <atomic>
+#include <config.hpp>
 #include <memory>
+#include <module/ctx.hpp>
 #include <module/piece.hpp>
 #include <net/conn.hpp>
+#include <net/timer.hpp>
+#include <util/pool.hpp>
+#include <vector>
 
 #include "client.hpp"
 #include "parser.hpp"
@@ -26,39 +32,119 @@ namespace mydss::server {
 
 class Session : public std::enable_shared_from_this<Session> {
  public:
-  [[nodiscard]] static auto New(std::shared_ptr<net::Conn> conn) {
-    auto session = std::shared_ptr<Session>(new Session(conn));
-    session->Start();
-    return session;
-  }
-
-  ~Session() {
-    int ret = map_.erase(id_);
-    assert(ret == 1);
-  }
+  // Session 对象的内存来自当前线程的对象池，因此必须在创建它的线程中销毁
+  // limit 为客户端输出缓冲区的限制
+  [[nodiscard]] static std::shared_ptr<Session> New(
+      std::shared_ptr<net::Conn> conn, const OutputLimit& limit = {});
+  // 在当前线程的对象池中预先分配 n 个 Session 对象的内存
+  static void Reserve(size_t n);
 
-  [[nodiscard]] auto client() const { return client_; }
+  [[nodiscard]] auto id() const { return id_; }
+  [[nodiscard]] const auto& client() const { return client_; }
+  [[nodiscard]] auto& client() { return client_; }
+  // 连接是否已经关闭
+  [[nodiscard]] bool closed() const { return conn_->closed(); }
+  // 输出缓冲区中尚未发送给客户端的字节数
+  [[nodiscard]] size_t output_bytes() const { return conn_->unsent_bytes(); }
+  // 序列化 piece 并发送，不指定 proto 时使用客户端当前协商的协议版本
   void Send(std::shared_ptr<module::Piece> piece, bool close = false);
+  void Send(std::shared_ptr<module::Piece> piece, module::Proto proto,
+            bool close);
 
   static auto GetSession(uint64_t id) { return map_.at(id); }
+  // 所有线程中尚未关闭的会话数目
+  static size_t live() { return live_.load(std::memory_order_relaxed); }
+
+  // 在 loop 中每秒检查一次当前线程的会话，关闭超过 timeout 秒没有收发数据的会话
+  // timeout 为 0 时不检查；同一个事件循环只需调用一次，重复调用没有效果
+  // 只能在运行 loop 的线程中调用
+  static void StartIdleSweep(std::shared_ptr<net::Loop> loop, uint64_t timeout);
+
+  // 设置执行命令的事件循环，为 nullptr 时在会话所在的线程中执行命令
+  // 设置后会话将解析得到的请求批量提交到 executor 中执行，回复再提交回会话所在的
+  // 线程发送，使多个线程读写和解析请求的同时命令仍然在一个线程中执行
+  // 必须在创建会话之前调用
+  static void SetExecutor(std::shared_ptr<net::Loop> executor) {
+    executor_ = std::move(executor);
+  }
 
  private:
-  Session(std::shared_ptr<net::Conn> conn);
+  friend class util::Pool<Session>;
+
+  Session(std::shared_ptr<net::Conn> conn, const OutputLimit& limit);
   void Start();
+  // 关闭连接并将会话从 map_ 中移除，会话在所有回调结束后被销毁
+  void Close();
+
+  // 接收下一段数据
+  void Recv();
+  // 依次处理已解析的请求，全部处理完后接收下一段数据
+  // 输出缓冲区积压时暂停，剩余的请求在输出缓冲区减少后继续处理
+  void Process();
+  // 将尚未处理的请求提交到 executor_ 中执行
+  void Execute();
+  // 在会话所在的线程中发送 executor_ 执行请求得到的回复，然后接收下一段数据
+  void OnExecuted(module::Ctx::Replies replies);
+  // 检查输出缓冲区是否超出限制，超出时断开连接并返回 false
+  bool CheckOutputLimit();
+  // 分别发送 bulk string 的头部、值和结尾，值不会被复制
+  void SendBulk(std::shared_ptr<module::BulkStringPiece> piece, bool close);
+  // 根据本次接收的字节数调整下次接收的缓冲区大小
+  // 接收的数据填满缓冲区时扩大缓冲区，一段时间内接收的数据都远小于缓冲区时缩小
+  void ResizeRecvBuf(size_t nbytes);
+
+  // 会话按照可能空闲超时的秒数放入时间轮对应的槽中，每秒只检查到期的一个槽
+  // 收发数据时只更新 active_tick_，检查时尚未超时的会话被移动到新的槽中，
+  // 因此每个会话在每个超时周期中最多被检查一次
+  struct IdleWheel {
+    net::Loop* loop = nullptr;  // 运行检查的事件循环
+    uint64_t timeout = 0;       // 空闲超时的秒数，为 0 表示不检查
+    uint64_t tick = 0;          // 开始检查后经过的秒数
+    std::vector<std::vector<std::weak_ptr<Session>>> slots;
+    std::vector<std::weak_ptr<Session>> due;  // 正在检查的槽
+  };
+
+  // 将会话放入时间轮中超时的时间对应的槽
+  void WatchIdle();
+  // 推进时间轮并检查到期的槽
+  static void SweepIdle();
 
-  static void OnRecv(std::shared_ptr<Session> session, util::Slice slice,
-                     err::Status status, int nbytes);
+  static void OnRecv(std::shared_ptr<Session> session, err::Status status,
+                     util::Slice data);
   static void OnSend(std::shared_ptr<Session> session, util::Slice slice,
                      bool close, err::Status status);
 
-  static uint64_t next_id_;
-  static std::unordered_map<uint64_t, std::shared_ptr<Session>> map_;
+  // 会话 ID 在所有事件循环线程中唯一
+  static std::atomic<uint64_t> next_id_;
+  static std::atomic<size_t> live_;
+  // 会话只在创建它的事件循环线程中被访问，因此每个线程拥有独立的 map_
+  static thread_local std::unordered_map<uint64_t, std::shared_ptr<Session>>
+      map_;
+  static thread_local IdleWheel idle_;
+  static std::shared_ptr<net::Loop> executor_;
 
  private:
   uint64_t id_;                      // 会话 ID
   std::shared_ptr<net::Conn> conn_;  // 与客户端的连接
   Client client_;     // 表示客户端，存储与客户端的相关信息
   ReqParser parser_;  // 请求解析器
+  // 接收缓冲区的大小，缓冲区只在接收时从缓冲区池中取出，解析后立即放回，
+  // 不完整的请求由解析器保存，因此空闲的会话不持有接收缓冲区
+  size_t recv_size_;
+  size_t recv_peak_ = 0;   // 最近若干次接收的最大字节数
+  int recv_count_ = 0;     // 上次检查是否需要缩小缓冲区后接收的次数
+  OutputLimit limit_;      // 输出缓冲区的限制
+  // 输出缓冲区开始持续超过软限制的时间，为 0 表示没有超过
+  uint64_t soft_since_ = 0;
+  // 软限制到期时再次检查输出缓冲区的定时器
+  net::TimerId soft_timer_;
+  // 已解析但尚未处理的请求从 reqs_[next_req_] 开始
+  std::vector<module::Req> reqs_;
+  size_t next_req_ = 0;
+  // 是否因为输出缓冲区积压而暂停处理请求
+  bool paused_ = false;
+  // 最近一次收发数据时 idle_.tick 的值
+  uint64_t active_tick_ = 0;
 };
 
 }  // namespace mydss::server
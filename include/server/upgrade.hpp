@@ -0,0 +1,69 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_SERVER_UPGRADE_HPP_
+#define MYDSS_INCLUDE_SERVER_UPGRADE_HPP_
+
+#include <config.hpp>
+#include <cstdint>
+#include <err/status.hpp>
+#include <memory>
+#include <net/loop.hpp>
+#include <string>
+
+namespace mydss::server {
+
+class Server;
+
+// 热升级，在不关闭监听套接字的情况下用新的进程替换正在运行的进程
+// 1. 旧进程在 upgrade.path 上等待交接请求
+// 2. 新进程以 --upgrade 启动并连接该地址，旧进程通过 SCM_RIGHTS 将所有监听
+//    套接字交给新进程，随后发送数据集的快照
+// 3. 新进程加载数据集，使用继承的监听套接字开始接受连接后通知旧进程
+// 4. 旧进程停止接受连接，在已有的会话全部关闭或超时后退出
+// 监听套接字始终处于打开状态，积压队列中的连接和正在握手的连接都不会丢失
+// 快照之后在旧进程上执行的写命令不会传递给新进程
+// 新进程在通知旧进程之前退出时，旧进程继续正常运行
+class Upgrade {
+ public:
+  // 监听套接字的标识，由地址类型和地址组成，用于将继承的监听套接字与配置对应
+  [[nodiscard]] static std::string Key(const ServerConfig& config);
+
+  // 以下函数在新进程中调用
+  // 连接 path 上的旧进程，接收监听套接字并加载数据集
+  [[nodiscard]] static err::Status Receive(const std::string& path);
+  // 取出与 key 对应的继承的监听套接字，没有时返回 -1
+  // 旧进程的线程数目少于新进程时，多出的线程共享同一个监听套接字
+  [[nodiscard]] static int TakeListener(const std::string& key);
+  // 与 key 对应的尚未被取出的继承的监听套接字的数目
+  [[nodiscard]] static size_t Pending(const std::string& key);
+  // 关闭所有尚未被取出的继承的监听套接字，返回关闭的数目
+  static size_t CloseRemaining();
+  // 通知旧进程新进程已经开始接受连接
+  [[nodiscard]] static err::Status Ack();
+
+  // 以下函数在旧进程中调用
+  // 记录正在监听的服务器，交接后在 loop 中停止其接受连接
+  // 可以在多个线程中并发调用
+  static void Register(std::shared_ptr<net::Loop> loop,
+                       std::shared_ptr<Server> server);
+  // 在 path 上监听交接请求，交接在后台线程中完成，之后进程在已有的会话
+  // 全部关闭或等待 drain_timeout 毫秒后退出
+  [[nodiscard]] static err::Status Serve(const std::string& path,
+                                         uint64_t drain_timeout);
+};
+
+}  // namespace mydss::server
+
+#endif  // MYDSS_INCLUDE_SERVER_UPGRADE_HPP_
@@ -0,0 +1,113 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_UTIL_BUF_POOL_HPP_
+#define MYDSS_INCLUDE_UTIL_BUF_POOL_HPP_
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "slice.hpp"
+
+namespace mydss::util {
+
+// 缓冲区池，缓冲区的大小为从 kMinSize 到 kMaxSize 的 2 的幂
+// 缓冲区以 Slice 的形式返回，其最后一个引用被释放后放回池中，
+// 用于只在读写期间短暂使用的缓冲区，例如接收缓冲区
+// 缓冲区池不是线程安全的，其返回的 Slice 必须在创建它的线程中释放
+// 缓冲区持有缓冲区池的引用，因此缓冲区池在所有缓冲区释放后才会被销毁
+class BufPool : public std::enable_shared_from_this<BufPool> {
+ public:
+  static constexpr size_t kMinSize = 4 * 1024;
+  static constexpr size_t kMaxSize = 512 * 1024;
+
+  // max_free 为每种大小最多保留的空闲缓冲区的数目
+  [[nodiscard]] static auto New(size_t max_free) {
+    return std::shared_ptr<BufPool>(new BufPool(max_free));
+  }
+
+  BufPool(const BufPool&) = delete;
+  BufPool& operator=(const BufPool&) = delete;
+
+  ~BufPool() {
+    for (auto& free : free_) {
+      for (auto buf : free) {
+        delete[] buf;
+      }
+    }
+  }
+
+  // 返回大小为不小于 size 的最小的 2 的幂的缓冲区，最小为 kMinSize
+  // size 大于 kMaxSize 时直接分配，不经过缓冲区池
+  [[nodiscard]] Slice Get(size_t size) {
+    if (size > kMaxSize) {
+      return Slice(size);
+    }
+    size_t cls = 0;
+    while ((kMinSize << cls) < size) {
+      cls++;
+    }
+
+    char* buf;
+    if (free_[cls].empty()) {
+      buf = new char[kMinSize << cls];
+    } else {
+      buf = free_[cls].back();
+      free_[cls].pop_back();
+    }
+    return Slice(std::shared_ptr<char[]>(
+                     buf, Deleter{this->shared_from_this(), cls}),
+                 kMinSize << cls);
+  }
+
+  // 池中空闲缓冲区的总数目
+  [[nodiscard]] size_t free_size() const {
+    size_t n = 0;
+    for (const auto& free : free_) {
+      n += free.size();
+    }
+    return n;
+  }
+
+ private:
+  static constexpr size_t kClasses = 8;
+  static_assert((kMinSize << (kClasses - 1)) == kMaxSize);
+
+  // 将缓冲区放回池中
+  struct Deleter {
+    std::shared_ptr<BufPool> pool;
+    size_t cls;
+
+    void operator()(char* buf) const { pool->Free(cls, buf); }
+  };
+
+  explicit BufPool(size_t max_free) : max_free_(max_free) {}
+
+  void Free(size_t cls, char* buf) {
+    if (free_[cls].size() < max_free_) {
+      free_[cls].push_back(buf);
+    } else {
+      delete[] buf;
+    }
+  }
+
+ private:
+  size_t max_free_;  // 每种大小最多保留的空闲缓冲区的数目
+  std::array<std::vector<char*>, kClasses> free_;  // 每种大小的空闲缓冲区
+};
+
+}  // namespace mydss::util
+
+#endif  // MYDSS_INCLUDE_UTIL_BUF_POOL_HPP_
@@ -0,0 +1,77 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_UTIL_MPSC_QUEUE_HPP_
+#define MYDSS_INCLUDE_UTIL_MPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <utility>
+
+namespace mydss::util {
+
+// 无锁的多生产者单消费者队列
+// Push 可以在任意线程中并发调用，每次只需要一次原子交换操作；
+// Pop 只能由一个线程调用
+// 生产者在交换尾指针和链接节点之间被挂起时，Pop 会暂时看不到该节点及其后的节点，
+// 使用者需要在生产者完成 Push 之后重新调用 Pop
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_(new Node), tail_(head_) {}
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  ~MpscQueue() {
+    T value;
+    while (Pop(value)) {
+    }
+    delete head_;
+  }
+
+  // 将 value 添加到队尾
+  void Push(T value) {
+    auto node = new Node;
+    node->value = std::move(value);
+    auto prev = tail_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // 取出队首的元素，队列为空时返回 false
+  bool Pop(T& value) {
+    auto next = head_->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return false;
+    }
+    // head_ 始终指向一个值已经被取走的节点
+    value = std::move(next->value);
+    delete head_;
+    head_ = next;
+    return true;
+  }
+
+ private:
+  struct Node {
+    std::atomic<Node*> next = nullptr;
+    T value;
+  };
+
+  // 消费者和生产者访问的成员位于不同的缓存行，避免伪共享
+  alignas(64) Node* head_;
+  alignas(64) std::atomic<Node*> tail_;
+};
+
+}  // namespace mydss::util
+
+#endif  // MYDSS_INCLUDE_UTIL_MPSC_QUEUE_HPP_
@@ -0,0 +1,99 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_UTIL_POOL_HPP_
+#define MYDSS_INCLUDE_UTIL_POOL_HPP_
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace mydss::util {
+
+// 对象池，对象销毁后其内存被放回池中，供之后创建的对象复用
+// 用于频繁创建和销毁的对象，例如连接和会话
+// 对象池不是线程安全的，其创建的对象必须在创建它的线程中销毁
+// 对象持有对象池的引用，因此对象池在所有对象销毁后才会被销毁
+template <typename T>
+class Pool : public std::enable_shared_from_this<Pool<T>> {
+ public:
+  // max_free 为池中最多保留的空闲内存块的数目
+  [[nodiscard]] static auto New(size_t max_free) {
+    return std::shared_ptr<Pool>(new Pool(max_free));
+  }
+
+  Pool(const Pool&) = delete;
+  Pool& operator=(const Pool&) = delete;
+
+  ~Pool() {
+    for (auto mem : free_) {
+      ::operator delete(mem);
+    }
+  }
+
+  // 预先分配内存，使池中至少有 n 个空闲内存块
+  void Reserve(size_t n) {
+    while (free_.size() < n && free_.size() < max_free_) {
+      free_.push_back(::operator new(sizeof(T)));
+    }
+  }
+
+  // 在池中的内存上构造对象
+  // T 的构造函数为私有时，T 需要将 Pool<T> 声明为友元
+  template <typename... Args>
+  [[nodiscard]] std::shared_ptr<T> Make(Args&&... args) {
+    void* mem;
+    if (free_.empty()) {
+      mem = ::operator new(sizeof(T));
+    } else {
+      mem = free_.back();
+      free_.pop_back();
+    }
+    auto obj = new (mem) T(std::forward<Args>(args)...);
+    return std::shared_ptr<T>(obj, Deleter{this->shared_from_this()});
+  }
+
+  // 池中空闲内存块的数目
+  [[nodiscard]] size_t free_size() const { return free_.size(); }
+
+ private:
+  // 析构对象并将其内存放回池中
+  struct Deleter {
+    std::shared_ptr<Pool> pool;
+
+    void operator()(T* obj) const {
+      obj->~T();
+      pool->Free(obj);
+    }
+  };
+
+  explicit Pool(size_t max_free) : max_free_(max_free) {}
+
+  void Free(void* mem) {
+    if (free_.size() < max_free_) {
+      free_.push_back(mem);
+    } else {
+      ::operator delete(mem);
+    }
+  }
+
+ private:
+  size_t max_free_;          // 最多保留的空闲内存块的数目
+  std::vector<void*> free_;  // 空闲的内存块
+};
+
+}  // namespace mydss::util
+
+#endif  // MYDSS_INCLUDE_UTIL_POOL_HPP_
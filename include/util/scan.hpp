@@ -0,0 +1,48 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_UTIL_SCAN_HPP_
+#define MYDSS_INCLUDE_UTIL_SCAN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mydss::util {
+
+// 扫描函数使用的指令集
+enum class Isa {
+  kScalar,  // 逐字节扫描
+  kSse,     // 每次处理 16 字节，查找使用 SSE2，解析数字使用 SSE4.1
+  kAvx2     // 查找每次处理 32 字节，解析数字与 kSse 相同
+};
+
+// 当前 CPU 支持的最高指令集，进程启动时默认使用该指令集
+[[nodiscard]] Isa DetectIsa();
+// 当前使用的指令集
+[[nodiscard]] Isa ScanIsa();
+// 指定扫描函数使用的指令集，超过 DetectIsa 的结果时返回 false
+// 只用于测试和基准测试，不能与扫描函数并发调用
+bool SetScanIsa(Isa isa);
+[[nodiscard]] const char* IsaName(Isa isa);
+
+// 返回 [p, end) 中第一个 "\r\n" 的 '\r' 的地址，不存在时返回 nullptr
+[[nodiscard]] const char* FindCrlf(const char* p, const char* end);
+
+// 将 [p, p + len) 中的十进制数字解析为整数存储到 result，len 的范围为 1-19
+// 存在非数字字符时返回 false
+[[nodiscard]] bool ParseDec(const char* p, size_t len, uint64_t& result);
+
+}  // namespace mydss::util
+
+#endif  // MYDSS_INCLUDE_UTIL_SCAN_HPP_
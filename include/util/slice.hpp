@@ -25,6 +25,10 @@ class Slice {
   Slice() = default;
   explicit Slice(size_t size)
       : data_(new char[size]), cap_(size), start_(0), end_(size) {}
+  // 引用 data 指向的 size 字节，不复制数据
+  // data 可以通过 std::shared_ptr 的别名构造函数共享其他对象的所有权
+  Slice(std::shared_ptr<char[]> data, size_t size)
+      : data_(std::move(data)), cap_(size), start_(0), end_(size) {}
   Slice(const Slice& other, size_t start, size_t end)
       : data_(other.data_),
         cap_(other.cap_),
@@ -16,6 +16,7 @@
 #define MYDSS_INCLUDE_UTIL_STR_HPP_
 
 #include <string>
+#include <string_view>
 
 namespace mydss::util {
 
@@ -38,7 +39,8 @@ inline static void StrLower(std::string& str) {
   return 1 + U64StrLen(-i64);
 }
 
-[[nodiscard]] bool StrToI64(const std::string& str, int64_t* result);
+// 将十进制整数 str 解析为 int64_t，存在非数字字符或者超出范围时返回 false
+[[nodiscard]] bool StrToI64(std::string_view str, int64_t* result);
 
 }  // namespace mydss::util
 
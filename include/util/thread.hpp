@@ -0,0 +1,52 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYDSS_INCLUDE_UTIL_THREAD_HPP_
+#define MYDSS_INCLUDE_UTIL_THREAD_HPP_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <err/status.hpp>
+#include <string>
+#include <vector>
+
+namespace mydss::util {
+
+// 线程的 CPU 使用情况
+struct ThreadUsage {
+  std::string name;       // 注册时的名称
+  pid_t tid = 0;          // 线程 ID
+  int cpu = -1;           // 最近一次运行所在的 CPU
+  std::string affinity;   // 允许运行的 CPU 列表，例如 "0-3,6"
+  double user = 0;        // 用户态 CPU 时间，单位为秒
+  double sys = 0;         // 内核态 CPU 时间，单位为秒
+  uint64_t voluntary = 0;    // 主动的上下文切换次数，例如等待事件
+  uint64_t involuntary = 0;  // 被抢占的上下文切换次数
+};
+
+// 将调用线程绑定到 cpu 上
+[[nodiscard]] err::Status PinThread(int cpu);
+
+// 以 name 注册调用线程并设置线程的名称（主线程除外），注册的线程可以通过
+// GetThreadUsage 查看
+void RegisterThread(const std::string& name);
+
+// 返回所有已注册且仍在运行的线程的 CPU 使用情况，按注册的顺序排列
+// 数据来自 /proc/self/task，可以在任意线程中调用
+[[nodiscard]] std::vector<ThreadUsage> GetThreadUsage();
+
+}  // namespace mydss::util
+
+#endif  // MYDSS_INCLUDE_UTIL_THREAD_HPP_
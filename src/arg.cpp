@@ -28,10 +28,11 @@ namespace mydss {
 static constexpr int kHelpVal = 256;
 static constexpr int kVersionVal = 257;
 static constexpr int kConfigVal = 258;
+static constexpr int kUpgradeVal = 259;
 
 Status Arg::Parse(int argc, char** argv) {
   opterr = 0;
-  struct option opts[4];
+  struct option opts[5];
 
   opts[0].name = "help";
   opts[0].has_arg = no_argument;
@@ -48,10 +49,15 @@ Status Arg::Parse(int argc, char** argv) {
   opts[2].flag = nullptr;
   opts[2].val = kConfigVal;
 
-  opts[3].name = nullptr;
+  opts[3].name = "upgrade";
   opts[3].has_arg = no_argument;
   opts[3].flag = nullptr;
-  opts[3].val = 0;
+  opts[3].val = kUpgradeVal;
+
+  opts[4].name = nullptr;
+  opts[4].has_arg = no_argument;
+  opts[4].flag = nullptr;
+  opts[4].val = 0;
 
   for (;;) {
     int val = getopt_long(argc, argv, "c:", opts, nullptr);
@@ -64,6 +70,9 @@ Status Arg::Parse(int argc, char** argv) {
       case kConfigVal:
         conf_file_ = optarg;
         break;
+      case kUpgradeVal:
+        upgrade_ = true;
+        break;
       case kHelpVal:
         // 解析到 --help 选项则立即返回
         help_ = true;
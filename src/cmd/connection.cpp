@@ -13,14 +13,21 @@
 // limitations under the License.
 
 #include <cmd/connection.hpp>
+#include <util/str.hpp>
+#include <version.hpp>
 
 using fmt::format;
 using mydss::module::BulkStringPiece;
 using mydss::module::Ctx;
 using mydss::module::ErrorPiece;
+using mydss::module::ArrayPiece;
 using mydss::module::IntegerPiece;
+using mydss::module::MapPiece;
 using mydss::module::NullPiece;
+using mydss::module::Proto;
+using mydss::module::Req;
 using mydss::module::SimpleStringPiece;
+using mydss::util::StrToI64;
 using std::make_shared;
 using std::string;
 using std::vector;
@@ -35,7 +42,7 @@ static void StrLower(string& str) {
   }
 }
 
-void Connection::Client(Ctx& ctx, vector<string> req) {
+void Connection::Client(Ctx& ctx, const Req& req) {
   if (req.size() == 1) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'client' command");
@@ -43,18 +50,18 @@ void Connection::Client(Ctx& ctx, vector<string> req) {
     return;
   }
 
-  auto sub_cmd_name = req[1];
+  string sub_cmd_name(req[1]);
   StrLower(sub_cmd_name);
   if (sub_cmd_name == "getname") {
-    ClientGetName(ctx, std::move(req));
+    ClientGetName(ctx, req);
     return;
   }
   if (sub_cmd_name == "id") {
-    ClientId(ctx, std::move(req));
+    ClientId(ctx, req);
     return;
   }
   if (sub_cmd_name == "setname") {
-    ClientSetName(ctx, std::move(req));
+    ClientSetName(ctx, req);
     return;
   }
   auto piece = make_shared<ErrorPiece>(
@@ -62,7 +69,7 @@ void Connection::Client(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Connection::ClientGetName(Ctx& ctx, vector<string> req) {
+void Connection::ClientGetName(Ctx& ctx, const Req& req) {
   if (req.size() != 2) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'client|getname' command");
@@ -80,7 +87,7 @@ void Connection::ClientGetName(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Connection::ClientId(Ctx& ctx, vector<string> req) {
+void Connection::ClientId(Ctx& ctx, const Req& req) {
   if (req.size() != 2) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'client|getname' command");
@@ -91,29 +98,100 @@ void Connection::ClientId(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Connection::ClientSetName(Ctx& ctx, vector<string> req) {
+void Connection::ClientSetName(Ctx& ctx, const Req& req) {
   if (req.size() != 3) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'client|getname' command");
     return;
   }
-  ctx.SetClientName(req[2]);
+  ctx.SetClientName(string(req[2]));
   auto piece = make_shared<SimpleStringPiece>("OK");
   ctx.Reply(piece);
 }
 
-void Connection::Echo(Ctx& ctx, vector<string> req) {
+void Connection::Echo(Ctx& ctx, const Req& req) {
   if (req.size() != 2) {
     auto piece =
         make_shared<ErrorPiece>("wrong number of arguments for 'echo' command");
     ctx.Reply(piece);
     return;
   }
-  auto piece = make_shared<BulkStringPiece>(req[1]);
+  auto piece = make_shared<BulkStringPiece>(string(req[1]));
   ctx.Reply(piece);
 }
 
-void Connection::Ping(Ctx& ctx, vector<string> req) {
+void Connection::Hello(Ctx& ctx, const Req& req) {
+  auto proto = ctx.GetProto();
+  if (req.size() >= 2) {
+    int64_t version;
+    if (!StrToI64(req[1], &version)) {
+      auto piece = make_shared<ErrorPiece>(
+          "Protocol version is not an integer or out of range");
+      ctx.Reply(piece);
+      return;
+    }
+    if (version != 2 && version != 3) {
+      auto piece =
+          make_shared<ErrorPiece>("NOPROTO unsupported protocol version");
+      ctx.Reply(piece);
+      return;
+    }
+    proto = static_cast<Proto>(version);
+  }
+
+  // 先检查所有选项，出错时不改变连接的任何状态
+  string client_name;
+  bool set_name = false;
+  for (size_t i = 2; i < req.size(); i++) {
+    string opt(req[i]);
+    StrLower(opt);
+    size_t remain = req.size() - i - 1;
+    if (opt == "auth" && remain >= 2) {
+      // 没有配置密码，与 Redis 中没有密码的 default 用户相同，接受任意密码
+      if (req[i + 1] != "default") {
+        auto piece = make_shared<ErrorPiece>(
+            "WRONGPASS invalid username-password pair or user is disabled.");
+        ctx.Reply(piece);
+        return;
+      }
+      i += 2;
+      continue;
+    }
+    if (opt == "setname" && remain >= 1) {
+      client_name = req[i + 1];
+      set_name = true;
+      i++;
+      continue;
+    }
+    auto piece = make_shared<ErrorPiece>(
+        format("Syntax error in HELLO option '{}'", req[i]));
+    ctx.Reply(piece);
+    return;
+  }
+
+  if (set_name) {
+    ctx.SetClientName(std::move(client_name));
+  }
+  ctx.SetProto(proto);
+
+  ctx.Reply(make_shared<MapPiece>(7));
+  ctx.Reply(make_shared<BulkStringPiece>("server"));
+  ctx.Reply(make_shared<BulkStringPiece>("mydss"));
+  ctx.Reply(make_shared<BulkStringPiece>("version"));
+  ctx.Reply(make_shared<BulkStringPiece>(MYDSS_VERSION));
+  ctx.Reply(make_shared<BulkStringPiece>("proto"));
+  ctx.Reply(make_shared<IntegerPiece>(static_cast<int64_t>(proto)));
+  ctx.Reply(make_shared<BulkStringPiece>("id"));
+  ctx.Reply(make_shared<IntegerPiece>(ctx.GetClientId()));
+  ctx.Reply(make_shared<BulkStringPiece>("mode"));
+  ctx.Reply(make_shared<BulkStringPiece>("standalone"));
+  ctx.Reply(make_shared<BulkStringPiece>("role"));
+  ctx.Reply(make_shared<BulkStringPiece>("master"));
+  ctx.Reply(make_shared<BulkStringPiece>("modules"));
+  ctx.Reply(make_shared<ArrayPiece>(0));
+}
+
+void Connection::Ping(Ctx& ctx, const Req& req) {
   if (req.size() > 2) {
     auto piece =
         make_shared<ErrorPiece>("wrong number of arguments for 'ping' command");
@@ -127,17 +205,17 @@ void Connection::Ping(Ctx& ctx, vector<string> req) {
     return;
   }
 
-  auto piece = make_shared<BulkStringPiece>(req[1]);
+  auto piece = make_shared<BulkStringPiece>(string(req[1]));
   ctx.Reply(piece);
 }
 
-void Connection::Quit(Ctx& ctx, vector<string> req) {
+void Connection::Quit(Ctx& ctx, const Req& req) {
   auto piece = make_shared<SimpleStringPiece>("OK");
   ctx.Reply(piece);
   ctx.Close();
 }
 
-void Connection::Select(Ctx& ctx, vector<string> req) {
+void Connection::Select(Ctx& ctx, const Req& req) {
   if (req.size() != 2) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'select' command");
@@ -145,15 +223,12 @@ void Connection::Select(Ctx& ctx, vector<string> req) {
     return;
   }
 
-  int64_t index = 0;
-  if (req[1] != "0") {
-    index = atoll(req[1].c_str());
-    if (index == 0) {
-      auto piece =
-          make_shared<ErrorPiece>("value is not an integer or out of range");
-      ctx.Reply(piece);
-      return;
-    }
+  int64_t index;
+  if (!StrToI64(req[1], &index)) {
+    auto piece =
+        make_shared<ErrorPiece>("value is not an integer or out of range");
+    ctx.Reply(piece);
+    return;
   }
 
   int ret = ctx.SelectDb(index);
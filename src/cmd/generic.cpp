@@ -15,6 +15,7 @@
 #include <fmt/format.h>
 
 #include <cmd/generic.hpp>
+#include <util/str.hpp>
 
 using fmt::format;
 using mydss::module::BulkStringPiece;
@@ -22,8 +23,10 @@ using mydss::module::Ctx;
 using mydss::module::ErrorPiece;
 using mydss::module::IntegerPiece;
 using mydss::module::NullPiece;
+using mydss::module::Req;
 using mydss::module::SimpleStringPiece;
 using mydss::module::TimeInMsec;
+using mydss::util::StrToI64;
 using std::make_shared;
 using std::string;
 using std::vector;
@@ -38,7 +41,7 @@ static void StrLower(string& str) {
   }
 }
 
-static void SetExpire(const string& cmd, Ctx& ctx, vector<string> req) {
+static void SetExpire(const string& cmd, Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() < 3) {
     auto piece = make_shared<ErrorPiece>(
@@ -53,7 +56,7 @@ static void SetExpire(const string& cmd, Ctx& ctx, vector<string> req) {
   bool lt = false;
 
   for (size_t i = 3; i < req.size(); i++) {
-    auto opt = req[i];
+    string opt(req[i]);
     StrLower(opt);
     if (opt == "nx") {
       nx = true;
@@ -93,15 +96,12 @@ static void SetExpire(const string& cmd, Ctx& ctx, vector<string> req) {
 
   const auto& key = req[1];
   const auto& time_str = req[2];
-  int64_t time = 0;
-  if (time_str != "0") {
-    time = atoll(time_str.c_str());
-    if (time == 0) {
-      auto piece =
-          make_shared<ErrorPiece>("value is not an integer or out of range");
-      ctx.Reply(piece);
-      return;
-    }
+  int64_t time;
+  if (!StrToI64(time_str, &time)) {
+    auto piece =
+        make_shared<ErrorPiece>("value is not an integer or out of range");
+    ctx.Reply(piece);
+    return;
   }
 
   int64_t new_pttl = 0;
@@ -210,7 +210,7 @@ static void SetExpire(const string& cmd, Ctx& ctx, vector<string> req) {
   }
 }
 
-void Generic::Del(Ctx& ctx, vector<string> req) {
+void Generic::Del(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() == 1) {
     auto piece =
@@ -229,7 +229,7 @@ void Generic::Del(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::Exists(Ctx& ctx, vector<string> req) {
+void Generic::Exists(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() == 1) {
     auto piece = make_shared<ErrorPiece>(
@@ -251,15 +251,15 @@ void Generic::Exists(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::Expire(Ctx& ctx, vector<string> req) {
-  SetExpire("expire", ctx, std::move(req));
+void Generic::Expire(Ctx& ctx, const Req& req) {
+  SetExpire("expire", ctx, req);
 }
 
-void Generic::ExpireAt(Ctx& ctx, vector<string> req) {
-  SetExpire("expireat", ctx, std::move(req));
+void Generic::ExpireAt(Ctx& ctx, const Req& req) {
+  SetExpire("expireat", ctx, req);
 }
 
-void Generic::Object(Ctx& ctx, vector<string> req) {
+void Generic::Object(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() == 1) {
     auto piece = make_shared<ErrorPiece>(
@@ -268,16 +268,16 @@ void Generic::Object(Ctx& ctx, vector<string> req) {
     return;
   }
 
-  auto sub_cmd_name = req[1];
+  string sub_cmd_name(req[1]);
   StrLower(sub_cmd_name);
   if (sub_cmd_name == "encoding") {
-    ObjectEncoding(ctx, std::move(req));
+    ObjectEncoding(ctx, req);
     return;
   } else if (sub_cmd_name == "idletime") {
-    ObjectIdleTime(ctx, std::move(req));
+    ObjectIdleTime(ctx, req);
     return;
   } else if (sub_cmd_name == "refcount") {
-    ObjectRefCount(ctx, std::move(req));
+    ObjectRefCount(ctx, req);
     return;
   }
   auto piece = make_shared<ErrorPiece>(
@@ -285,7 +285,7 @@ void Generic::Object(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::ObjectEncoding(Ctx& ctx, vector<string> req) {
+void Generic::ObjectEncoding(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() != 3) {
     auto piece = make_shared<ErrorPiece>(
@@ -305,7 +305,7 @@ void Generic::ObjectEncoding(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::ObjectIdleTime(Ctx& ctx, vector<string> req) {
+void Generic::ObjectIdleTime(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() != 3) {
     auto piece = make_shared<ErrorPiece>(
@@ -325,7 +325,7 @@ void Generic::ObjectIdleTime(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::ObjectRefCount(Ctx& ctx, vector<string> req) {
+void Generic::ObjectRefCount(Ctx& ctx, const Req& req) {
   if (req.size() != 3) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'object|refcount' command");
@@ -344,7 +344,7 @@ void Generic::ObjectRefCount(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::Persist(Ctx& ctx, vector<string> req) {
+void Generic::Persist(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() != 2) {
     auto piece = make_shared<ErrorPiece>(
@@ -373,15 +373,15 @@ void Generic::Persist(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::PExpire(Ctx& ctx, vector<string> req) {
-  SetExpire("pexpire", ctx, std::move(req));
+void Generic::PExpire(Ctx& ctx, const Req& req) {
+  SetExpire("pexpire", ctx, req);
 }
 
-void Generic::PExpireAt(Ctx& ctx, vector<string> req) {
-  SetExpire("pexpireat", ctx, std::move(req));
+void Generic::PExpireAt(Ctx& ctx, const Req& req) {
+  SetExpire("pexpireat", ctx, req);
 }
 
-void Generic::PTtl(Ctx& ctx, vector<string> req) {
+void Generic::PTtl(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() != 2) {
     auto piece =
@@ -408,7 +408,7 @@ void Generic::PTtl(Ctx& ctx, vector<string> req) {
   }
 }
 
-void Generic::Rename(Ctx& ctx, vector<string> req) {
+void Generic::Rename(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() != 3) {
     auto piece = make_shared<ErrorPiece>(
@@ -434,7 +434,7 @@ void Generic::Rename(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::RenameNx(Ctx& ctx, vector<string> req) {
+void Generic::RenameNx(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() != 3) {
     auto piece = make_shared<ErrorPiece>(
@@ -467,7 +467,7 @@ void Generic::RenameNx(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::Touch(Ctx& ctx, vector<string> req) {
+void Generic::Touch(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() == 1) {
     auto piece = make_shared<ErrorPiece>(
@@ -490,7 +490,7 @@ void Generic::Touch(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void Generic::Ttl(Ctx& ctx, vector<string> req) {
+void Generic::Ttl(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() != 2) {
     auto piece =
@@ -517,7 +517,7 @@ void Generic::Ttl(Ctx& ctx, vector<string> req) {
   }
 }
 
-void Generic::Type(Ctx& ctx, vector<string> req) {
+void Generic::Type(Ctx& ctx, const Req& req) {
   // 检查参数
   if (req.size() != 2) {
     auto piece =
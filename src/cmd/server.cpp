@@ -0,0 +1,117 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/resource.h>
+
+#include <cmd/server.hpp>
+#include <net/loop.hpp>
+#include <util/str.hpp>
+#include <util/thread.hpp>
+
+using fmt::format;
+using mydss::module::BulkStringPiece;
+using mydss::module::Ctx;
+using mydss::module::ErrorPiece;
+using mydss::module::Req;
+using mydss::module::VerbatimStringPiece;
+using mydss::net::Loop;
+using mydss::util::GetThreadUsage;
+using mydss::util::StrLower;
+using std::make_shared;
+using std::string;
+using std::vector;
+
+namespace mydss::cmd {
+
+static double Seconds(const timeval& tv) {
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// 进程的 CPU 时间
+static string CpuSection() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return format(
+      "# CPU\r\n"
+      "used_cpu_sys:{:.6f}\r\n"
+      "used_cpu_user:{:.6f}\r\n",
+      Seconds(usage.ru_stime), Seconds(usage.ru_utime));
+}
+
+// 每个事件循环线程的 CPU 时间、上下文切换次数和所在的 CPU，用于检查线程绑定
+static string ThreadsSection() {
+  string result = "# Threads\r\n";
+  auto threads = GetThreadUsage();
+  for (size_t i = 0; i < threads.size(); i++) {
+    const auto& t = threads[i];
+    result += format(
+        "thread_{}:name={},tid={},cpu={},affinity={},used_cpu_sys={:.6f},"
+        "used_cpu_user={:.6f},voluntary_ctxt_switches={},"
+        "involuntary_ctxt_switches={}\r\n",
+        i, t.name, t.tid, t.cpu, t.affinity, t.sys, t.user, t.voluntary,
+        t.involuntary);
+  }
+  return result;
+}
+
+// 每个开启了忙等待的事件循环忙等待和处理事件的时间，单位为秒
+static string BusyPollSection() {
+  string result = "# Busypoll\r\n";
+  auto loops = Loop::AllBusyStats();
+  for (size_t i = 0; i < loops.size(); i++) {
+    const auto& l = *loops[i];
+    result += format(
+        "loop_{}:tid={},budget_us={},spins={},spin_time={:.6f},"
+        "work_time={:.6f},sleeps={}\r\n",
+        i, l.tid, l.budget.load(std::memory_order_relaxed),
+        l.spins.load(std::memory_order_relaxed),
+        l.spin_time.load(std::memory_order_relaxed) / 1e6,
+        l.work_time.load(std::memory_order_relaxed) / 1e6,
+        l.sleeps.load(std::memory_order_relaxed));
+  }
+  return result;
+}
+
+void Server::Info(Ctx& ctx, const Req& req) {
+  if (req.size() > 2) {
+    auto piece =
+        make_shared<ErrorPiece>("wrong number of arguments for 'info' command");
+    ctx.Reply(piece);
+    return;
+  }
+
+  string section(req.size() == 2 ? req[1] : "all");
+  StrLower(section);
+  bool all = section == "all" || section == "default" ||
+             section == "everything";
+  string result;
+  if (all || section == "cpu") {
+    result += CpuSection();
+  }
+  if (all || section == "threads") {
+    if (!result.empty()) {
+      result += "\r\n";
+    }
+    result += ThreadsSection();
+  }
+  if (all || section == "busypoll") {
+    if (!result.empty()) {
+      result += "\r\n";
+    }
+    result += BusyPollSection();
+  }
+  ctx.Reply(make_shared<VerbatimStringPiece>("txt", std::move(result)));
+}
+
+}  // namespace mydss::cmd
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <cmd/string.hpp>
+#include <util/str.hpp>
 
 using mydss::module::ArrayPiece;
 using mydss::module::BulkStringPiece;
@@ -20,13 +21,16 @@ using mydss::module::Ctx;
 using mydss::module::ErrorPiece;
 using mydss::module::IntegerPiece;
 using mydss::module::NullPiece;
+using mydss::module::Req;
 using mydss::module::SimpleStringPiece;
 using mydss::module::encoding::kInt;
 using mydss::module::encoding::kRaw;
 using mydss::module::type::kString;
+using mydss::util::StrToI64;
 using std::dynamic_pointer_cast;
 using std::make_shared;
 using std::string;
+using std::string_view;
 using std::to_string;
 using std::vector;
 
@@ -46,7 +50,7 @@ static bool I64AddOverflow(int64_t a, int64_t b) {
   return false;
 }
 
-static void StringIncrBy(Ctx& ctx, const string& key, int64_t i64) {
+static void StringIncrBy(Ctx& ctx, string_view key, int64_t i64) {
   auto obj = ctx.GetObject(key);
   if (obj == nullptr) {
     auto new_obj = make_shared<String>();
@@ -112,7 +116,7 @@ void String::SetI64(int64_t i64) {
   value_ = i64;
 }
 
-void String::Append(Ctx& ctx, vector<string> req) {
+void String::Append(Ctx& ctx, const Req& req) {
   if (req.size() != 3) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'append' command");
@@ -125,7 +129,7 @@ void String::Append(Ctx& ctx, vector<string> req) {
 
   auto obj = ctx.GetObject(key);
   if (obj == nullptr) {
-    auto new_obj = make_shared<String>(value);
+    auto new_obj = make_shared<String>(string(value));
     ctx.SetObject(key, new_obj);
     auto piece = make_shared<IntegerPiece>(value.size());
     ctx.Reply(piece);
@@ -141,14 +145,16 @@ void String::Append(Ctx& ctx, vector<string> req) {
 
   auto str = dynamic_pointer_cast<String>(obj);
   if (str->encoding_ == kInt) {
-    auto new_value = to_string(str->I64()) + value;
+    auto new_value = to_string(str->I64());
+    new_value += value;
     str->SetValue(std::move(new_value));
     auto piece = make_shared<IntegerPiece>(new_value.size());
     ctx.Reply(piece);
     return;
   }
   if (str->encoding_ == kRaw) {
-    auto new_value = str->Str() + value;
+    auto new_value = str->Str();
+    new_value += value;
     str->SetValue(std::move(new_value));
     auto piece = make_shared<IntegerPiece>(new_value.size());
     ctx.Reply(piece);
@@ -157,7 +163,7 @@ void String::Append(Ctx& ctx, vector<string> req) {
   assert(false);
 }
 
-void String::Decr(Ctx& ctx, vector<string> req) {
+void String::Decr(Ctx& ctx, const Req& req) {
   if (req.size() != 2) {
     auto piece =
         make_shared<ErrorPiece>("wrong number of arguments for 'decr' command");
@@ -169,7 +175,7 @@ void String::Decr(Ctx& ctx, vector<string> req) {
   StringIncrBy(ctx, key, -1);
 }
 
-void String::DecrBy(Ctx& ctx, vector<string> req) {
+void String::DecrBy(Ctx& ctx, const Req& req) {
   if (req.size() != 3) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'decrby' command");
@@ -179,16 +185,12 @@ void String::DecrBy(Ctx& ctx, vector<string> req) {
   const auto& key = req[1];
   const auto& value = req[2];
 
-  int64_t i64 = 0;
-  if (value != "0") {
-    i64 = atoll(value.c_str());
-
-    if (i64 == 0) {
-      auto piece =
-          make_shared<ErrorPiece>("value is not an integer or out of range");
-      ctx.Reply(piece);
-      return;
-    }
+  int64_t i64;
+  if (!StrToI64(value, &i64)) {
+    auto piece =
+        make_shared<ErrorPiece>("value is not an integer or out of range");
+    ctx.Reply(piece);
+    return;
   }
 
   if (i64 == INT64_MIN) {
@@ -201,7 +203,7 @@ void String::DecrBy(Ctx& ctx, vector<string> req) {
   StringIncrBy(ctx, key, -i64);
 }
 
-void String::Get(Ctx& ctx, vector<string> req) {
+void String::Get(Ctx& ctx, const Req& req) {
   if (req.size() != 2) {
     auto piece =
         make_shared<ErrorPiece>("wrong number of arguments for 'get' command");
@@ -209,7 +211,7 @@ void String::Get(Ctx& ctx, vector<string> req) {
     return;
   }
 
-  const string& key = req[1];
+  auto key = req[1];
   auto obj = ctx.GetObject(key);
   if (obj == nullptr) {
     auto piece = make_shared<NullPiece>();
@@ -239,13 +241,13 @@ void String::Get(Ctx& ctx, vector<string> req) {
   assert(false);
 }
 
-void String::GetDel(Ctx& ctx, vector<string> req) {
+void String::GetDel(Ctx& ctx, const Req& req) {
   if (req.size() != 2) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'getdel' command");
   }
 
-  const string& key = req[1];
+  auto key = req[1];
   auto obj = ctx.GetObject(key);
   if (obj == nullptr) {
     auto piece = make_shared<NullPiece>();
@@ -276,7 +278,7 @@ void String::GetDel(Ctx& ctx, vector<string> req) {
   assert(false);
 }
 
-void String::GetRange(Ctx& ctx, vector<string> req) {
+void String::GetRange(Ctx& ctx, const Req& req) {
   if (req.size() != 4) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'getrange' command");
@@ -284,29 +286,23 @@ void String::GetRange(Ctx& ctx, vector<string> req) {
     return;
   }
 
-  int64_t start = 0;
-  if (req[2] != "0") {
-    start = atoll(req[2].c_str());
-    if (start == 0) {
-      auto piece =
-          make_shared<ErrorPiece>("value is not an integer or out of range");
-      ctx.Reply(piece);
-      return;
-    }
+  int64_t start;
+  if (!StrToI64(req[2], &start)) {
+    auto piece =
+        make_shared<ErrorPiece>("value is not an integer or out of range");
+    ctx.Reply(piece);
+    return;
   }
 
-  int64_t end = 0;
-  if (req[3] != "0") {
-    end = atoll(req[3].c_str());
-    if (end == 0) {
-      auto piece =
-          make_shared<ErrorPiece>("value is not an integer or out of range");
-      ctx.Reply(piece);
-      return;
-    }
+  int64_t end;
+  if (!StrToI64(req[3], &end)) {
+    auto piece =
+        make_shared<ErrorPiece>("value is not an integer or out of range");
+    ctx.Reply(piece);
+    return;
   }
 
-  const string& key = req[1];
+  auto key = req[1];
   auto obj = ctx.GetObject(key);
   if (obj == nullptr) {
     auto piece = make_shared<BulkStringPiece>();
@@ -362,7 +358,7 @@ void String::GetRange(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void String::Incr(Ctx& ctx, vector<string> req) {
+void String::Incr(Ctx& ctx, const Req& req) {
   if (req.size() != 2) {
     auto piece =
         make_shared<ErrorPiece>("wrong number of arguments for 'incr' command");
@@ -374,7 +370,7 @@ void String::Incr(Ctx& ctx, vector<string> req) {
   StringIncrBy(ctx, key, 1);
 }
 
-void String::IncrBy(Ctx& ctx, vector<string> req) {
+void String::IncrBy(Ctx& ctx, const Req& req) {
   if (req.size() != 3) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'incrby' command");
@@ -385,20 +381,17 @@ void String::IncrBy(Ctx& ctx, vector<string> req) {
   const auto& key = req[1];
   const auto& value = req[2];
 
-  int64_t i64 = 0;
-  if (value != "0") {
-    i64 = atoll(value.c_str());
-    if (i64 == 0) {
-      auto piece =
-          make_shared<ErrorPiece>("value is not an integer or out of range");
-      return;
-    }
+  int64_t i64;
+  if (!StrToI64(value, &i64)) {
+    auto piece =
+        make_shared<ErrorPiece>("value is not an integer or out of range");
+    return;
   }
 
   StringIncrBy(ctx, key, i64);
 }
 
-void String::MGet(Ctx& ctx, vector<string> req) {
+void String::MGet(Ctx& ctx, const Req& req) {
   if (req.size() == 1) {
     auto piece =
         make_shared<ErrorPiece>("wrong number of arguments for 'mget' command");
@@ -408,7 +401,7 @@ void String::MGet(Ctx& ctx, vector<string> req) {
   ctx.Reply(array);
 
   for (size_t i = 1; i < req.size(); i++) {
-    const string& key = req[i];
+    auto key = req[i];
     auto obj = ctx.GetObject(key);
     if (obj == nullptr) {
       auto piece = make_shared<NullPiece>();
@@ -438,7 +431,7 @@ void String::MGet(Ctx& ctx, vector<string> req) {
   }
 }
 
-void String::MSet(Ctx& ctx, vector<string> req) {
+void String::MSet(Ctx& ctx, const Req& req) {
   if (req.size() == 1 || req.size() % 2 == 0) {
     auto piece =
         make_shared<ErrorPiece>("wrong number of arguments for 'mset' command");
@@ -450,7 +443,7 @@ void String::MSet(Ctx& ctx, vector<string> req) {
     const auto& key = req[i];
     const auto& value = req[i + 1];
 
-    auto obj = make_shared<String>(value);
+    auto obj = make_shared<String>(string(value));
     ctx.SetObject(key, obj);
   }
 
@@ -458,7 +451,7 @@ void String::MSet(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void String::MSetNx(Ctx& ctx, vector<string> req) {
+void String::MSetNx(Ctx& ctx, const Req& req) {
   if (req.size() == 1 || req.size() % 2 == 0) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'msetnx' command");
@@ -472,7 +465,7 @@ void String::MSetNx(Ctx& ctx, vector<string> req) {
     const auto& value = req[i + 1];
 
     if (ctx.GetObject(key) == nullptr) {
-      auto obj = make_shared<String>(value);
+      auto obj = make_shared<String>(string(value));
       ctx.SetObject(key, obj);
       continue;
     }
@@ -483,7 +476,7 @@ void String::MSetNx(Ctx& ctx, vector<string> req) {
   ctx.Reply(piece);
 }
 
-void String::Set(Ctx& ctx, vector<string> req) {
+void String::Set(Ctx& ctx, const Req& req) {
   if (req.size() != 3) {
     auto piece =
         make_shared<ErrorPiece>("wrong number of arguments for 'set' command");
@@ -494,13 +487,13 @@ void String::Set(Ctx& ctx, vector<string> req) {
   const auto& key = req[1];
   const auto& value = req[2];
 
-  auto obj = make_shared<String>(value);
+  auto obj = make_shared<String>(string(value));
   ctx.SetObject(key, obj);
   auto piece = make_shared<SimpleStringPiece>("OK");
   ctx.Reply(piece);
 }
 
-void String::StrLen(Ctx& ctx, vector<string> req) {
+void String::StrLen(Ctx& ctx, const Req& req) {
   if (req.size() != 2) {
     auto piece = make_shared<ErrorPiece>(
         "wrong number of arguments for 'strlen' command");
@@ -508,7 +501,7 @@ void String::StrLen(Ctx& ctx, vector<string> req) {
     return;
   }
 
-  const string& key = req[1];
+  auto key = req[1];
   auto obj = ctx.GetObject(key);
   if (obj == nullptr) {
     auto piece = make_shared<IntegerPiece>(0);
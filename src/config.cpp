@@ -17,6 +17,7 @@
 #include <unistd.h>
 
 #include <config.hpp>
+#include <cstdlib>
 #include <err/errno.hpp>
 #include <nlohmann/json.hpp>
 #include <util/str.hpp>
@@ -27,6 +28,7 @@ using mydss::err::kEof;
 using mydss::err::kInvalidConfig;
 using mydss::err::kJsonParseErr;
 using mydss::err::Status;
+using mydss::net::Engine;
 using mydss::net::InetType;
 using mydss::util::StrLower;
 using nlohmann::json;
@@ -36,13 +38,25 @@ using std::vector;
 
 namespace mydss {
 
+// 每轮忙等待的最长时间，单位为微秒
+static constexpr uint64_t kMaxBusyPoll = 1000000;
+
+// 获取 json 对象中名为 key 的字段，字段不存在时返回 null
+static json Field(const json& obj, const char* key) {
+  auto it = obj.find(key);
+  if (it == obj.end()) {
+    return nullptr;
+  }
+  return *it;
+}
+
 // 读取路径为 path 的文件，将读取到的内容存储在 data 中
 static Status ReadFile(const string& path, string& data);
 static Status LoadServerItem(const json& item, size_t index,
                              ServerConfig& result);
 
 Status ServerConfig::Load(const json& json, vector<ServerConfig>& result) {
-  auto server = json["server"];
+  auto server = Field(json, "server");
   if (server.is_null()) {
     result = {};
     return Status::Ok();
@@ -54,7 +68,10 @@ Status ServerConfig::Load(const json& json, vector<ServerConfig>& result) {
   vector<ServerConfig> scs;
   for (size_t i = 0; i < server.size(); i++) {
     ServerConfig sc;
-    LoadServerItem(server[i], i, sc);
+    auto status = LoadServerItem(server[i], i, sc);
+    if (status.error()) {
+      return status;
+    }
     scs.push_back(std::move(sc));
   }
 
@@ -63,7 +80,7 @@ Status ServerConfig::Load(const json& json, vector<ServerConfig>& result) {
 }
 
 Status DbConfig::Load(const json& json, DbConfig& result) {
-  auto db = json["db"];
+  auto db = Field(json, "db");
   if (db.is_null()) {
     result = {};
     return Status::Ok();
@@ -72,7 +89,7 @@ Status DbConfig::Load(const json& json, DbConfig& result) {
     return {kInvalidConfig, "the 'db' field must be a object"};
   }
 
-  auto db_num = db["db_num"];
+  auto db_num = Field(db, "db_num");
   DbConfig dc;
   if (!db_num.is_null()) {
     if (!db_num.is_number_integer()) {
@@ -89,6 +106,202 @@ Status DbConfig::Load(const json& json, DbConfig& result) {
   return Status::Ok();
 }
 
+Status LoopConfig::Load(const json& json, LoopConfig& result) {
+  auto loop = Field(json, "loop");
+  if (loop.is_null()) {
+    result = {};
+    return Status::Ok();
+  }
+  if (!loop.is_object()) {
+    return {kInvalidConfig, "the 'loop' field must be a object"};
+  }
+
+  auto max_events = Field(loop, "max_events");
+  LoopConfig lc;
+  if (!max_events.is_null()) {
+    if (!max_events.is_number_integer()) {
+      return {kInvalidConfig, "the 'loop.max_events' field must be a integer"};
+    }
+    if (max_events <= 0 || max_events > 65536) {
+      return {kInvalidConfig,
+              "the 'loop.max_events' field must be in the range of 1-65536"};
+    }
+    lc.set_max_events(max_events);
+  }
+
+  auto threads = Field(loop, "threads");
+  if (!threads.is_null()) {
+    if (!threads.is_number_integer()) {
+      return {kInvalidConfig, "the 'loop.threads' field must be a integer"};
+    }
+    if (threads <= 0 || threads > 1024) {
+      return {kInvalidConfig,
+              "the 'loop.threads' field must be in the range of 1-1024"};
+    }
+    lc.set_threads(threads);
+  }
+
+  auto engine = Field(loop, "engine");
+  if (!engine.is_null()) {
+    if (!engine.is_string()) {
+      return {kInvalidConfig, "the 'loop.engine' field must be a string"};
+    }
+
+    string engine_str = engine;
+    StrLower(engine_str);
+    if (engine_str == "epoll") {
+      lc.set_engine(Engine::kEpoll);
+    } else if (engine_str == "io_uring") {
+      lc.set_engine(Engine::kUring);
+    } else {
+      return {kInvalidConfig,
+              "the 'loop.engine' field must be 'epoll' or 'io_uring'"};
+    }
+  }
+
+  auto threaded_io = Field(loop, "threaded_io");
+  if (!threaded_io.is_null()) {
+    if (!threaded_io.is_boolean()) {
+      return {kInvalidConfig, "the 'loop.threaded_io' field must be a boolean"};
+    }
+    lc.set_threaded_io(threaded_io);
+  }
+
+  long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+  auto cpu_affinity = Field(loop, "cpu_affinity");
+  if (!cpu_affinity.is_null()) {
+    vector<int> cpus;
+    bool valid = cpu_affinity.is_array();
+    for (size_t i = 0; valid && i < cpu_affinity.size(); i++) {
+      const auto& cpu = cpu_affinity[i];
+      valid = cpu.is_number_unsigned() && cpu < ncpus;
+      if (valid) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!valid) {
+      return {kInvalidConfig,
+              format("the 'loop.cpu_affinity' field must be a array of CPU "
+                     "numbers in the range of 0-{}",
+                     ncpus - 1)};
+    }
+    lc.set_cpu_affinity(std::move(cpus));
+  }
+
+  auto executor_cpu = Field(loop, "executor_cpu");
+  if (!executor_cpu.is_null()) {
+    if (!executor_cpu.is_number_integer() || executor_cpu < -1 ||
+        executor_cpu >= ncpus) {
+      return {kInvalidConfig,
+              format("the 'loop.executor_cpu' field must be -1 or a CPU number "
+                     "in the range of 0-{}",
+                     ncpus - 1)};
+    }
+    lc.set_executor_cpu(executor_cpu);
+  }
+
+  auto incoming_cpu = Field(loop, "incoming_cpu");
+  if (!incoming_cpu.is_null()) {
+    if (!incoming_cpu.is_boolean()) {
+      return {kInvalidConfig,
+              "the 'loop.incoming_cpu' field must be a boolean"};
+    }
+    lc.set_incoming_cpu(incoming_cpu);
+  }
+
+  // 可以是对所有事件循环生效的整数，或者按事件循环的下标依次生效的数组
+  auto busy_poll = Field(loop, "busy_poll");
+  if (!busy_poll.is_null()) {
+    auto budgets = busy_poll.is_array() ? busy_poll
+                                       : nlohmann::json::array({busy_poll});
+    vector<uint64_t> result;
+    bool valid = true;
+    for (size_t i = 0; valid && i < budgets.size(); i++) {
+      const auto& budget = budgets[i];
+      valid = budget.is_number_unsigned() && budget <= kMaxBusyPoll;
+      if (valid) {
+        result.push_back(budget);
+      }
+    }
+    if (!valid) {
+      return {kInvalidConfig,
+              format("the 'loop.busy_poll' field must be a integer or a array "
+                     "of integers in the range of 0-{}",
+                     kMaxBusyPoll)};
+    }
+    lc.set_busy_poll(std::move(result));
+  }
+
+  result = std::move(lc);
+  return Status::Ok();
+}
+
+Status UpgradeConfig::Load(const json& json, UpgradeConfig& result) {
+  auto upgrade = Field(json, "upgrade");
+  if (upgrade.is_null()) {
+    result = {};
+    return Status::Ok();
+  }
+  if (!upgrade.is_object()) {
+    return {kInvalidConfig, "the 'upgrade' field must be a object"};
+  }
+
+  auto path = Field(upgrade, "path");
+  UpgradeConfig uc;
+  if (!path.is_null()) {
+    if (!path.is_string()) {
+      return {kInvalidConfig, "the 'upgrade.path' field must be a string"};
+    }
+    uc.set_path(path);
+  }
+
+  auto drain_timeout = Field(upgrade, "drain_timeout");
+  if (!drain_timeout.is_null()) {
+    if (!drain_timeout.is_number_unsigned()) {
+      return {kInvalidConfig,
+              "the 'upgrade.drain_timeout' field must be a non-negative "
+              "integer"};
+    }
+    uc.set_drain_timeout(drain_timeout);
+  }
+
+  result = std::move(uc);
+  return Status::Ok();
+}
+
+Status ClientConfig::Load(const json& json, ClientConfig& result) {
+  auto client = Field(json, "client");
+  if (client.is_null()) {
+    result = {};
+    return Status::Ok();
+  }
+  if (!client.is_object()) {
+    return {kInvalidConfig, "the 'client' field must be a object"};
+  }
+
+  auto max_clients = Field(client, "max_clients");
+  ClientConfig cc;
+  if (!max_clients.is_null()) {
+    if (!max_clients.is_number_unsigned()) {
+      return {kInvalidConfig,
+              "the 'client.max_clients' field must be a non-negative integer"};
+    }
+    cc.set_max_clients(max_clients);
+  }
+
+  auto timeout = Field(client, "timeout");
+  if (!timeout.is_null()) {
+    if (!timeout.is_number_unsigned()) {
+      return {kInvalidConfig,
+              "the 'client.timeout' field must be a non-negative integer"};
+    }
+    cc.set_timeout(timeout);
+  }
+
+  result = std::move(cc);
+  return Status::Ok();
+}
+
 Status Config::Load(const string& conf_file, Config& config) {
   string conf_str;
   auto status = ReadFile(conf_file, conf_str);
@@ -115,6 +328,18 @@ Status Config::Load(const string& conf_file, Config& config) {
   if (status.error()) {
     return status;
   }
+  status = LoopConfig::Load(conf_json, config.loop());
+  if (status.error()) {
+    return status;
+  }
+  status = UpgradeConfig::Load(conf_json, config.upgrade());
+  if (status.error()) {
+    return status;
+  }
+  status = ClientConfig::Load(conf_json, config.client());
+  if (status.error()) {
+    return status;
+  }
 
   return Status::Ok();
 }
@@ -151,7 +376,7 @@ Status LoadServerItem(const json& item, size_t index, ServerConfig& result) {
             format("the 'server[{}]' field must be a object", index)};
   }
 
-  auto type = item["type"];
+  auto type = Field(item, "type");
   if (!type.is_null()) {
     if (!type.is_string()) {
       return {kInvalidConfig,
@@ -164,14 +389,17 @@ Status LoadServerItem(const json& item, size_t index, ServerConfig& result) {
       result.set_type(InetType::kIPv4);
     } else if (type_str == "ipv6") {
       result.set_type(InetType::kIPv6);
+    } else if (type_str == "unix") {
+      result.set_type(InetType::kUnix);
     } else {
       return {kInvalidConfig,
-              format("the 'server[{}].type' field must be 'IPv4' or 'IPv6'",
+              format("the 'server[{}].type' field must be 'IPv4', 'IPv6' or "
+                     "'unix'",
                      index)};
     }
   }
 
-  auto ip = item["ip"];
+  auto ip = Field(item, "ip");
   if (!ip.is_null()) {
     if (!type.is_string()) {
       return {kInvalidConfig,
@@ -180,7 +408,7 @@ Status LoadServerItem(const json& item, size_t index, ServerConfig& result) {
     result.set_ip(ip);
   }
 
-  auto port = item["port"];
+  auto port = Field(item, "port");
   if (!port.is_null()) {
     if (!port.is_number_integer()) {
       return {kInvalidConfig,
@@ -195,6 +423,112 @@ Status LoadServerItem(const json& item, size_t index, ServerConfig& result) {
     result.set_port(port);
   }
 
+  auto path = Field(item, "path");
+  if (!path.is_null()) {
+    if (!path.is_string()) {
+      return {kInvalidConfig,
+              format("the 'server[{}].path' field must be a string", index)};
+    }
+    result.set_path(path);
+  }
+  if (result.type() == InetType::kUnix && result.path().empty()) {
+    return {kInvalidConfig,
+            format("the 'server[{}].path' field is required for unix socket",
+                   index)};
+  }
+
+  // 权限为八进制数字组成的字符串，例如 "770"
+  auto perm = Field(item, "perm");
+  if (!perm.is_null()) {
+    string perm_str = perm.is_string() ? perm.get<string>() : "";
+    char* end = nullptr;
+    auto value = strtoul(perm_str.c_str(), &end, 8);
+    if (perm_str.empty() || *end != '\0' || value > 0777) {
+      return {kInvalidConfig,
+              format("the 'server[{}].perm' field must be a octal string in "
+                     "the range of 0-777",
+                     index)};
+    }
+    result.set_perm(value);
+  }
+
+  // 套接字选项，均为非负整数，tcp_nodelay 为布尔值
+  auto tcp_nodelay = Field(item, "tcp_nodelay");
+  if (!tcp_nodelay.is_null()) {
+    if (!tcp_nodelay.is_boolean()) {
+      return {kInvalidConfig,
+              format("the 'server[{}].tcp_nodelay' field must be a boolean",
+                     index)};
+    }
+    result.sock_opts().nodelay = tcp_nodelay;
+  }
+
+  const struct {
+    const char* key;
+    int* value;
+  } int_opts[] = {
+      {"sndbuf", &result.sock_opts().sndbuf},
+      {"rcvbuf", &result.sock_opts().rcvbuf},
+      {"tcp_keepalive", &result.sock_opts().keepalive},
+      {"tcp_defer_accept", &result.sock_opts().defer_accept},
+      {"busy_poll", &result.sock_opts().busy_poll},
+      {"tcp_fastopen", &result.sock_opts().fastopen},
+  };
+  for (const auto& opt : int_opts) {
+    auto value = Field(item, opt.key);
+    if (value.is_null()) {
+      continue;
+    }
+    if (!value.is_number_unsigned() || value > INT32_MAX) {
+      return {kInvalidConfig,
+              format("the 'server[{}].{}' field must be a non-negative integer",
+                     index, opt.key)};
+    }
+    *opt.value = value;
+  }
+
+  auto limit = Field(item, "output_buffer_limit");
+  if (!limit.is_null()) {
+    if (!limit.is_object()) {
+      return {kInvalidConfig,
+              format("the 'server[{}].output_buffer_limit' field must be a "
+                     "object",
+                     index)};
+    }
+    const struct {
+      const char* key;
+      uint64_t* value;
+    } limit_opts[] = {
+        {"hard", &result.output_limit().hard},
+        {"soft", &result.output_limit().soft},
+        {"soft_seconds", &result.output_limit().soft_seconds},
+    };
+    for (const auto& opt : limit_opts) {
+      auto value = Field(limit, opt.key);
+      if (value.is_null()) {
+        continue;
+      }
+      if (!value.is_number_unsigned()) {
+        return {kInvalidConfig,
+                format("the 'server[{}].output_buffer_limit.{}' field must be "
+                       "a non-negative integer",
+                       index, opt.key)};
+      }
+      *opt.value = value;
+    }
+  }
+
+  auto zerocopy_threshold = Field(item, "zerocopy_threshold");
+  if (!zerocopy_threshold.is_null()) {
+    if (!zerocopy_threshold.is_number_unsigned()) {
+      return {kInvalidConfig,
+              format("the 'server[{}].zerocopy_threshold' field must be a "
+                     "non-negative integer",
+                     index)};
+    }
+    result.set_zerocopy_threshold(zerocopy_threshold);
+  }
+
   return Status::Ok();
 }
 
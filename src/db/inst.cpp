@@ -16,17 +16,27 @@
 
 #include <cmd/connection.hpp>
 #include <cmd/generic.hpp>
+#include <cmd/server.hpp>
+#include <charconv>
 #include <cmd/string.hpp>
+#include <cstring>
 #include <db/inst.hpp>
+#include <err/code.hpp>
+#include <module/time.hpp>
 #include <util/str.hpp>
 
 using fmt::format;
 using mydss::cmd::Connection;
 using mydss::cmd::Generic;
 using mydss::cmd::String;
+using mydss::err::kInvalidData;
+using mydss::err::Status;
 using mydss::module::Ctx;
 using mydss::module::ErrorPiece;
+using mydss::module::TimeInMsec;
 using mydss::module::Req;
+using mydss::module::encoding::kInt;
+using mydss::module::type::kString;
 using mydss::util::StrLower;
 using std::make_shared;
 using std::shared_ptr;
@@ -34,6 +44,40 @@ using std::string;
 
 namespace mydss::db {
 
+// Dump 序列化数据集的格式版本，格式改变时递增
+static constexpr char kDumpMagic[] = "MYDSSDUMP1";
+
+// 序列化的数据集只在同一台机器上的进程之间传递，因此整数直接使用本机字节序
+template <typename T>
+static void Put(string& out, T value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void PutStr(string& out, const string& str) {
+  Put<uint32_t>(out, str.size());
+  out += str;
+}
+
+template <typename T>
+static bool Get(const string& data, size_t& pos, T& value) {
+  if (data.size() - pos < sizeof(value)) {
+    return false;
+  }
+  memcpy(&value, data.data() + pos, sizeof(value));
+  pos += sizeof(value);
+  return true;
+}
+
+static bool GetStr(const string& data, size_t& pos, string& str) {
+  uint32_t len;
+  if (!Get(data, pos, len) || data.size() - pos < len) {
+    return false;
+  }
+  str.assign(data, pos, len);
+  pos += len;
+  return true;
+}
+
 shared_ptr<Inst> Inst::inst_;
 
 void Inst::Init(int db_num) {
@@ -74,9 +118,82 @@ void Inst::Init(int db_num) {
   // Connnection Management
   inst_->RegisterCmd("CLIENT", Connection::Client);
   inst_->RegisterCmd("ECHO", Connection::Echo);
+  inst_->RegisterCmd("HELLO", Connection::Hello);
   inst_->RegisterCmd("PING", Connection::Ping);
   inst_->RegisterCmd("QUIT", Connection::Quit);
   inst_->RegisterCmd("SELECT", Connection::Select);
+
+  // Server Management
+  inst_->RegisterCmd("INFO", cmd::Server::Info);
+}
+
+void Inst::Dump(string& out) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  out = kDumpMagic;
+  for (size_t i = 0; i < dbs_.size(); i++) {
+    for (const auto& [key, obj] : dbs_[i].objs()) {
+      // 目前只有字符串一种类型；已经过期但尚未被删除的键不需要传递
+      auto pttl = obj->PTtl();
+      if (obj->type() != kString || pttl == 0) {
+        continue;
+      }
+      auto str = std::static_pointer_cast<String>(obj);
+      bool is_int = str->EncodingStr() == "int";
+      Put<uint8_t>(out, i);
+      PutStr(out, key);
+      Put<uint8_t>(out, is_int);
+      PutStr(out, is_int ? std::to_string(str->I64()) : str->Str());
+      Put<int64_t>(out, pttl);
+    }
+  }
+}
+
+Status Inst::Restore(const string& data) {
+  if (data.compare(0, strlen(kDumpMagic), kDumpMagic) != 0) {
+    return {kInvalidData, "unknown dataset format"};
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t pos = strlen(kDumpMagic);
+  while (pos < data.size()) {
+    uint8_t index;
+    string key;
+    uint8_t is_int;
+    string value;
+    int64_t pttl;
+    if (!Get(data, pos, index) || !GetStr(data, pos, key) ||
+        !Get(data, pos, is_int) || !GetStr(data, pos, value) ||
+        !Get(data, pos, pttl)) {
+      return {kInvalidData, "truncated dataset"};
+    }
+    // 数据来自另一个进程，需要检查后才能使用
+    // 过期时间为 -1 表示没有过期时间，否则加上当前时间后不能溢出
+    if (pttl < -1 || pttl > INT64_MAX - TimeInMsec()) {
+      return {kInvalidData, format("invalid ttl of key '{}'", key)};
+    }
+    int64_t i64 = 0;
+    if (is_int) {
+      auto [end, ec] =
+          std::from_chars(value.data(), value.data() + value.size(), i64);
+      if (ec != std::errc() || end != value.data() + value.size()) {
+        return {kInvalidData, format("invalid integer of key '{}'", key)};
+      }
+    }
+    // 新进程配置的数据库数目可能更少
+    if (index >= dbs_.size()) {
+      continue;
+    }
+
+    auto str = make_shared<String>();
+    if (is_int) {
+      str->SetI64(i64);
+    } else {
+      str->SetValue(std::move(value));
+    }
+    str->SetPTtl(pttl);
+    dbs_[index].objs()[std::move(key)] = std::move(str);
+  }
+  return Status::Ok();
 }
 
 void Inst::RegisterCmd(string name, Cmd cmd) {
@@ -88,14 +205,14 @@ void Inst::RegisterCmd(string name, Cmd cmd) {
   cmds_[std::move(name)] = std::move(cmd);
 }
 
-void Inst::Handle(Ctx& ctx, Req req) {
+void Inst::Handle(Ctx& ctx, const Req& req) {
   if (req.empty()) {
     auto piece = make_shared<ErrorPiece>("empty commmand");
     ctx.Reply(piece);
     return;
   }
 
-  string cmd_name = req.front();
+  string cmd_name(req.front());
   StrLower(cmd_name);
 
   auto it = cmds_.find(cmd_name);
@@ -111,7 +228,8 @@ void Inst::Handle(Ctx& ctx, Req req) {
   }
 
   const auto& cmd = it->second;
-  cmd(ctx, std::move(req));
+  std::lock_guard<std::mutex> lock(mutex_);
+  cmd(ctx, req);
 }
 
 }  // namespace mydss::db
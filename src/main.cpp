@@ -17,11 +17,16 @@
 #include <arg.hpp>
 #include <config.hpp>
 #include <db/inst.hpp>
+#include <future>
 #include <help.hpp>
 #include <iostream>
 #include <net/loop.hpp>
 #include <nlohmann/json.hpp>
 #include <server/server.hpp>
+#include <server/session.hpp>
+#include <server/upgrade.hpp>
+#include <thread>
+#include <util/thread.hpp>
 #include <vector>
 #include <version.hpp>
 
@@ -30,12 +35,21 @@ using mydss::Arg;
 using mydss::Config;
 using mydss::kHelpText;
 using mydss::db::Inst;
+using mydss::err::Status;
+using mydss::net::InetType;
 using mydss::net::Loop;
 using mydss::server::Server;
+using mydss::server::Session;
+using mydss::util::PinThread;
+using mydss::util::RegisterThread;
+using mydss::server::Upgrade;
 using nlohmann::json;
+using std::future;
 using std::ifstream;
+using std::promise;
 using std::shared_ptr;
 using std::string;
+using std::thread;
 using std::vector;
 
 static void InitLogger() {
@@ -43,6 +57,42 @@ static void InitLogger() {
   spdlog::flush_on(spdlog::level::debug);
 }
 
+// 创建第 index 个事件循环并启动监听所有地址的服务器
+// 会话只能在创建它的线程中访问，因此必须在运行该事件循环的线程中调用
+// Unix 域套接字不支持 SO_REUSEPORT，只由第 0 个事件循环监听
+static Status StartReactor(const Config& config, int index,
+                           shared_ptr<Loop>& loop,
+                           vector<shared_ptr<Server>>& servers) {
+  RegisterThread(fmt::format("loop-{}", index));
+  int cpu = config.loop().LoopCpu(index);
+  if (cpu >= 0) {
+    auto status = PinThread(cpu);
+    if (status.error()) {
+      return status;
+    }
+  }
+
+  loop = Loop::New(config.loop().max_events(), config.loop().engine());
+  loop->set_busy_poll(config.loop().LoopBusyPoll(index));
+  for (auto sc : config.server()) {
+    if (sc.type() == InetType::kUnix && index != 0) {
+      continue;
+    }
+    sc.set_reuse_port(config.loop().threads() > 1 &&
+                      sc.type() != InetType::kUnix);
+    if (sc.reuse_port() && config.loop().incoming_cpu() && cpu >= 0) {
+      sc.sock_opts().incoming_cpu = cpu;
+    }
+    auto server = Server::New(loop, std::move(sc), config.client());
+    auto status = server->Start();
+    if (status.error()) {
+      return status;
+    }
+    servers.push_back(server);
+  }
+  return Status::Ok();
+}
+
 int main(int argc, char** argv) {
   InitLogger();
 
@@ -71,18 +121,105 @@ int main(int argc, char** argv) {
   }
 
   Inst::Init(config.db().db_num());
-  auto loop = Loop::New();
 
+  // 在启动服务器之前接管旧进程的监听套接字和数据集
+  const auto& upgrade = config.upgrade();
+  if (arg.upgrade()) {
+    if (upgrade.path().empty()) {
+      SPDLOG_CRITICAL("--upgrade requires the 'upgrade.path' field");
+      return EXIT_FAILURE;
+    }
+    status = Upgrade::Receive(upgrade.path());
+    if (status.error()) {
+      SPDLOG_CRITICAL("take over from the running server failed: {}",
+                      status.ToString());
+      return EXIT_FAILURE;
+    }
+  }
+
+  // 命令由单独的线程执行，事件循环线程只负责读写和解析请求
+  if (config.loop().threaded_io()) {
+    auto executor = Loop::New();
+    Session::SetExecutor(executor);
+    thread([executor, cpu = config.loop().executor_cpu()] {
+      RegisterThread("executor");
+      if (cpu >= 0) {
+        auto status = PinThread(cpu);
+        if (status.error()) {
+          SPDLOG_WARN("pin the executor to CPU {} failed: {}", cpu,
+                      status.ToString());
+        }
+      }
+      executor->Run();
+    }).detach();
+  }
+
+  // 每个事件循环线程拥有独立的 Loop，并为每个地址创建独立的 Server
+  // 有多个线程时通过 SO_REUSEPORT 监听同一地址，由内核将新连接分配给各个线程
+  int nthreads = config.loop().threads();
+  vector<future<Status>> started;
+  started.reserve(nthreads - 1);
+  for (int i = 1; i < nthreads; i++) {
+    promise<Status> p;
+    started.push_back(p.get_future());
+    thread([&config, i, p = std::move(p)]() mutable {
+      shared_ptr<Loop> loop;
+      vector<shared_ptr<Server>> servers;
+      auto status = StartReactor(config, i, loop, servers);
+      bool ok = status.ok();
+      p.set_value(std::move(status));
+      if (ok) {
+        loop->Run();
+      }
+    }).detach();
+  }
+
+  shared_ptr<Loop> loop;
   vector<shared_ptr<Server>> servers;
-  servers.reserve(config.server().size());
-  for (const auto& sc : config.server()) {
-    auto server = Server::New(loop, sc);
-    auto status = server->Start();
+  status = StartReactor(config, 0, loop, servers);
+  if (status.error()) {
+    SPDLOG_CRITICAL("{}", status.ToString());
+    return EXIT_FAILURE;
+  }
+  for (auto& f : started) {
+    status = f.get();
+    if (status.error()) {
+      SPDLOG_CRITICAL("{}", status.ToString());
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (arg.upgrade()) {
+    // 旧进程的线程数目多于新进程时，剩余的监听套接字由主线程接受连接，
+    // 关闭这些套接字会重置其积压队列中的连接
+    for (const auto& sc : config.server()) {
+      while (Upgrade::Pending(Upgrade::Key(sc)) > 0) {
+        auto server = Server::New(loop, sc, config.client());
+        status = server->Start();
+        if (status.error()) {
+          SPDLOG_CRITICAL("{}", status.ToString());
+          return EXIT_FAILURE;
+        }
+        servers.push_back(server);
+      }
+    }
+    // 新的配置中已经删除的地址
+    auto n = Upgrade::CloseRemaining();
+    if (n > 0) {
+      SPDLOG_WARN("closed {} inherited listening sockets not in config", n);
+    }
+
+    status = Upgrade::Ack();
+    if (status.error()) {
+      SPDLOG_WARN("notify the previous server failed: {}", status.ToString());
+    }
+  }
+  if (!upgrade.path().empty()) {
+    status = Upgrade::Serve(upgrade.path(), upgrade.drain_timeout());
     if (status.error()) {
       SPDLOG_CRITICAL("{}", status.ToString());
       return EXIT_FAILURE;
     }
-    servers.push_back(server);
   }
 
   loop->Run();
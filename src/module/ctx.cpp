@@ -21,13 +21,27 @@ using mydss::db::Inst;
 using mydss::server::Session;
 using std::shared_ptr;
 using std::string;
+using std::string_view;
 
 namespace mydss::module {
 
-shared_ptr<Object> Ctx::GetObject(const string& key) {
+// std::unordered_map 在 C++17 中只能以 std::string 查找，
+// 查找时将键复制到线程的缓冲区中，避免每次查找都分配内存
+static const string& LookupKey(string_view key) {
+  static thread_local string buf;
+  buf.assign(key);
+  return buf;
+}
+
+Ctx::Ctx(Session* session) : session_id_(session->id()), session_(session) {}
+
+Ctx::Ctx(Session* session, Replies* replies)
+    : session_id_(session->id()), session_(session), replies_(replies) {}
+
+shared_ptr<Object> Ctx::GetObject(string_view key) {
   auto inst = Inst::GetInst();
   auto& objs = inst->db().objs();
-  auto it = objs.find(key);
+  auto it = objs.find(LookupKey(key));
   if (it == objs.end()) {
     return nullptr;
   }
@@ -40,16 +54,22 @@ shared_ptr<Object> Ctx::GetObject(const string& key) {
   return obj;
 }
 
-void Ctx::SetObject(const string& key, shared_ptr<Object> obj) {
+void Ctx::SetObject(string_view key, shared_ptr<Object> obj) {
   auto inst = Inst::GetInst();
   auto& objs = inst->db().objs();
-  objs[key] = obj;
+  // 只有插入新的键时才需要复制键
+  auto it = objs.find(LookupKey(key));
+  if (it != objs.end()) {
+    it->second = std::move(obj);
+    return;
+  }
+  objs.emplace(key, std::move(obj));
 }
 
-bool Ctx::DeleteObject(const std::string& key) {
+bool Ctx::DeleteObject(string_view key) {
   auto inst = Inst::GetInst();
   auto& objs = inst->db().objs();
-  auto it = objs.find(key);
+  auto it = objs.find(LookupKey(key));
   if (it == objs.end()) {
     return false;
   }
@@ -64,8 +84,27 @@ bool Ctx::DeleteObject(const std::string& key) {
 }
 
 void Ctx::Reply(shared_ptr<Piece> piece) {
-  auto session = Session::GetSession(session_id_);
-  session->Send(piece);
+  // 省略的 Piece 的元素同样被省略，其中的聚合类型的元素也包括在内
+  // 没有元素的 Piece 省略时大小为 0，发送时会被跳过，因此不需要查询协议版本
+  auto elements = piece->Elements();
+  if (omitted_ > 0) {
+    omitted_ += elements - 1;
+    return;
+  }
+  if (elements > 0 && piece->Omitted(GetProto())) {
+    omitted_ = elements;
+    return;
+  }
+
+  if (replies_ != nullptr) {
+    replies_->push_back({std::move(piece), GetProto()});
+    return;
+  }
+  // 会话可能因为之前的回复超出输出缓冲区的限制而被关闭，此后的回复被丢弃
+  if (session_->closed()) {
+    return;
+  }
+  session_->Send(std::move(piece));
 }
 
 int Ctx::SelectDb(int db) {
@@ -77,20 +116,29 @@ int Ctx::SelectDb(int db) {
 }
 
 void Ctx::Close() {
-  auto session = Session::GetSession(session_id_);
-  session->Send(nullptr, true);
+  closing_ = true;
+  if (replies_ != nullptr) {
+    replies_->push_back({nullptr, GetProto()});
+    return;
+  }
+  if (session_->closed()) {
+    return;
+  }
+  session_->Send(nullptr, true);
 }
 
 const string& Ctx::GetClientName() {
-  auto session = Session::GetSession(session_id_);
-  return session->client().name();
+  return session_->client().name();
 }
 
 const void Ctx::SetClientName(string name) {
-  auto session = Session::GetSession(session_id_);
-  return session->client().set_name(std::move(name));
+  return session_->client().set_name(std::move(name));
 }
 
 const int64_t Ctx::GetClientId() { return session_id_; }
 
+Proto Ctx::GetProto() { return session_->client().proto(); }
+
+void Ctx::SetProto(Proto proto) { session_->client().set_proto(proto); }
+
 }  // namespace mydss::module
@@ -12,26 +12,32 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <fmt/format.h>
+
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <module/piece.hpp>
+#include <string_view>
 #include <util/str.hpp>
 
 using mydss::util::I64StrLen;
 using mydss::util::U64StrLen;
+using std::string;
+using std::string_view;
 using std::to_string;
 
 namespace mydss::module {
 
-size_t SimpleStringPiece::Size() const {
+size_t SimpleStringPiece::Size(Proto /*proto*/) const {
   size_t result = 1;
   result += value_.size();
   result += 2;
   return result;
 }
 
-size_t SimpleStringPiece::Serialize(char* buf, size_t len) const {
-  assert(len >= Size());
+size_t SimpleStringPiece::Serialize(char* buf, size_t len, Proto proto) const {
+  assert(len >= Size(proto));
 
   buf[0] = '+';
   size_t offset = 1;
@@ -41,19 +47,19 @@ size_t SimpleStringPiece::Serialize(char* buf, size_t len) const {
   buf[offset + 1] = '\n';
   offset += 2;
 
-  assert(offset == Size());
+  assert(offset == Size(proto));
   return offset;
 }
 
-size_t ErrorPiece::Size() const {
+size_t ErrorPiece::Size(Proto /*proto*/) const {
   size_t result = 1;
   result += value_.size();
   result += 2;
   return result;
 }
 
-size_t ErrorPiece::Serialize(char* buf, size_t len) const {
-  assert(len >= Size());
+size_t ErrorPiece::Serialize(char* buf, size_t len, Proto proto) const {
+  assert(len >= Size(proto));
 
   buf[0] = '-';
   size_t offset = 1;
@@ -63,19 +69,19 @@ size_t ErrorPiece::Serialize(char* buf, size_t len) const {
   buf[offset + 1] = '\n';
   offset += 2;
 
-  assert(offset == Size());
+  assert(offset == Size(proto));
   return offset;
 }
 
-size_t IntegerPiece::Size() const {
+size_t IntegerPiece::Size(Proto /*proto*/) const {
   size_t result = 1;
   result += I64StrLen(value_);
   result += 2;
   return result;
 }
 
-size_t IntegerPiece::Serialize(char* buf, size_t len) const {
-  assert(len >= Size());
+size_t IntegerPiece::Serialize(char* buf, size_t len, Proto proto) const {
+  assert(len >= Size(proto));
 
   auto i64_str = to_string(value_);
   buf[0] = ':';
@@ -86,11 +92,11 @@ size_t IntegerPiece::Serialize(char* buf, size_t len) const {
   buf[offset + 1] = '\n';
   offset += 2;
 
-  assert(offset == Size());
+  assert(offset == Size(proto));
   return offset;
 }
 
-size_t BulkStringPiece::Size() const {
+size_t BulkStringPiece::Size(Proto /*proto*/) const {
   size_t result = 1;
   result += U64StrLen(value_.size());
   result += 2;
@@ -99,8 +105,8 @@ size_t BulkStringPiece::Size() const {
   return result;
 }
 
-size_t BulkStringPiece::Serialize(char* buf, size_t len) const {
-  assert(len >= Size());
+size_t BulkStringPiece::Serialize(char* buf, size_t len, Proto proto) const {
+  assert(len >= Size(proto));
 
   buf[0] = '$';
   size_t offset = 1;
@@ -117,30 +123,154 @@ size_t BulkStringPiece::Serialize(char* buf, size_t len) const {
   buf[offset + 1] = '\n';
   offset += 2;
 
-  assert(offset == Size());
+  assert(offset == Size(proto));
   return offset;
 }
 
-size_t ArrayPiece::Size() const {
-  size_t result = 1;
-  result += I64StrLen(len_);
-  result += 2;
-  return result;
+// "<type><len>\r\n" 形式的头部的大小
+static size_t HeaderSize(int64_t len) { return 1 + I64StrLen(len) + 2; }
+
+static size_t SerializeHeader(char* buf, char type, int64_t len) {
+  buf[0] = type;
+  auto len_str = to_string(len);
+  memcpy(buf + 1, len_str.data(), len_str.size());
+  size_t offset = 1 + len_str.size();
+  buf[offset] = '\r';
+  buf[offset + 1] = '\n';
+  return offset + 2;
 }
 
-size_t ArrayPiece::Serialize(char* buf, size_t len) const {
-  assert(len >= Size());
+// "<type><value>\r\n" 形式的数据
+static size_t SerializeLine(char* buf, char type, const string& value) {
+  buf[0] = type;
+  memcpy(buf + 1, value.data(), value.size());
+  size_t offset = 1 + value.size();
+  buf[offset] = '\r';
+  buf[offset + 1] = '\n';
+  return offset + 2;
+}
 
-  buf[0] = '*';
-  size_t offset = 1;
-  auto len_str = to_string(len_);
-  memcpy(buf + 1, len_str.c_str(), len_str.size());
-  offset += len_str.size();
+// "<type><len>\r\n<prefix><value>\r\n" 形式的数据，
+// len 为 prefix 和 value 的总长度
+static size_t BlobSize(size_t len) { return HeaderSize(len) + len + 2; }
+
+static size_t SerializeBlob(char* buf, char type, string_view prefix,
+                            const string& value) {
+  size_t offset = SerializeHeader(buf, type, prefix.size() + value.size());
+  memcpy(buf + offset, prefix.data(), prefix.size());
+  offset += prefix.size();
+  memcpy(buf + offset, value.data(), value.size());
+  offset += value.size();
   buf[offset] = '\r';
   buf[offset + 1] = '\n';
-  offset += 2;
+  return offset + 2;
+}
+
+size_t AggregatePiece::Size(Proto proto) const {
+  if (proto == Proto::kResp3) {
+    return HeaderSize(len_);
+  }
+  return resp2_type_ == 0 ? 0 : HeaderSize(elements_);
+}
+
+size_t AggregatePiece::Serialize(char* buf, size_t len, Proto proto) const {
+  assert(len >= Size(proto));
+
+  size_t offset = 0;
+  if (proto == Proto::kResp3) {
+    offset = SerializeHeader(buf, type_, len_);
+  } else if (resp2_type_ != 0) {
+    offset = SerializeHeader(buf, resp2_type_, elements_);
+  }
+
+  assert(offset == Size(proto));
+  return offset;
+}
+
+DoublePiece::DoublePiece(double value) : value_(value) {
+  if (std::isnan(value)) {
+    str_ = "nan";
+  } else if (std::isinf(value)) {
+    str_ = value > 0 ? "inf" : "-inf";
+  } else {
+    // 最短的能够精确还原数值的表示
+    str_ = fmt::format("{}", value);
+  }
+}
+
+size_t DoublePiece::Size(Proto proto) const {
+  if (proto == Proto::kResp3) {
+    return 1 + str_.size() + 2;
+  }
+  return BlobSize(str_.size());
+}
+
+size_t DoublePiece::Serialize(char* buf, size_t len, Proto proto) const {
+  assert(len >= Size(proto));
+
+  size_t offset = proto == Proto::kResp3 ? SerializeLine(buf, ',', str_)
+                                         : SerializeBlob(buf, '$', {}, str_);
+
+  assert(offset == Size(proto));
+  return offset;
+}
+
+size_t BooleanPiece::Size(Proto /*proto*/) const {
+  // "#t\r\n" 或者 ":1\r\n"
+  return 4;
+}
+
+size_t BooleanPiece::Serialize(char* buf, size_t len, Proto proto) const {
+  assert(len >= Size(proto));
+
+  if (proto == Proto::kResp3) {
+    memcpy(buf, value_ ? "#t\r\n" : "#f\r\n", 4);
+  } else {
+    memcpy(buf, value_ ? ":1\r\n" : ":0\r\n", 4);
+  }
+  return 4;
+}
+
+size_t BigNumberPiece::Size(Proto proto) const {
+  if (proto == Proto::kResp3) {
+    return 1 + value_.size() + 2;
+  }
+  return BlobSize(value_.size());
+}
+
+size_t BigNumberPiece::Serialize(char* buf, size_t len, Proto proto) const {
+  assert(len >= Size(proto));
+
+  size_t offset = proto == Proto::kResp3 ? SerializeLine(buf, '(', value_)
+                                         : SerializeBlob(buf, '$', {}, value_);
+
+  assert(offset == Size(proto));
+  return offset;
+}
+
+size_t VerbatimStringPiece::Size(Proto proto) const {
+  if (proto == Proto::kResp3) {
+    // 格式和值之间以 ':' 分隔
+    return BlobSize(format_.size() + 1 + value_.size());
+  }
+  return BlobSize(value_.size());
+}
+
+size_t VerbatimStringPiece::Serialize(char* buf, size_t len,
+                                      Proto proto) const {
+  assert(len >= Size(proto));
+
+  size_t offset = 0;
+  if (proto == Proto::kResp3) {
+    char prefix[4];
+    memcpy(prefix, format_.data(), 3);
+    prefix[3] = ':';
+    offset = SerializeBlob(buf, '=', string_view(prefix, 4), value_);
+  } else {
+    offset = SerializeBlob(buf, '$', {}, value_);
+  }
 
-  assert(offset == Size());
+  assert(offset == Size(proto));
   return offset;
 }
 
@@ -0,0 +1,79 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <module/req.hpp>
+
+using mydss::util::Slice;
+using std::string_view;
+
+namespace mydss::module {
+
+Req::Req(std::initializer_list<string_view> args) {
+  size_t total = 0;
+  for (auto arg : args) {
+    total += arg.size();
+  }
+  Slice buf(total);
+  char* p = buf.data();
+  args_.reserve(args.size());
+  for (auto arg : args) {
+    memcpy(p, arg.data(), arg.size());
+    args_.emplace_back(p, arg.size());
+    p += arg.size();
+  }
+  buf_ = std::move(buf);
+}
+
+void Req::Detach(const Slice& buf) {
+  Slice* held = nullptr;
+  if (buf_.data() == buf.data()) {
+    held = &buf_;
+  } else {
+    for (auto& more : more_bufs_) {
+      if (more.data() == buf.data()) {
+        held = &more;
+        break;
+      }
+    }
+  }
+  if (held == nullptr) {
+    return;
+  }
+
+  const char* begin = buf.data();
+  const char* end = begin + buf.size();
+  auto inside = [&](string_view arg) {
+    return arg.data() >= begin && arg.data() < end;
+  };
+  size_t total = 0;
+  for (auto arg : args_) {
+    if (inside(arg)) {
+      total += arg.size();
+    }
+  }
+
+  Slice owned(total);
+  char* p = owned.data();
+  for (auto& arg : args_) {
+    if (inside(arg)) {
+      memcpy(p, arg.data(), arg.size());
+      arg = string_view(p, arg.size());
+      p += arg.size();
+    }
+  }
+  *held = std::move(owned);
+}
+
+}  // namespace mydss::module
@@ -15,8 +15,12 @@
 #include <arpa/inet.h>
 #include <spdlog/spdlog.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include <cassert>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <err/errno.hpp>
@@ -31,7 +35,12 @@ using std::shared_ptr;
 namespace mydss::net {
 
 static Status CreateSocket(InetType type, int& fd) {
-  auto domain = type == InetType::kIPv4 ? AF_INET : AF_INET6;
+  int domain = AF_INET;
+  if (type == InetType::kIPv6) {
+    domain = AF_INET6;
+  } else if (type == InetType::kUnix) {
+    domain = AF_UNIX;
+  }
   fd = socket(domain, SOCK_STREAM, 0);
   if (fd == -1) {
     return {errno, ErrnoStr()};
@@ -63,6 +72,16 @@ static Status SetReuseAddr(int fd) {
   return Status::Ok();
 }
 
+// 设置 SO_REUSEPORT 标志
+static Status SetReusePort(int fd) {
+  int opt = 1;
+  int ret = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+  if (ret == -1) {
+    return {errno, ErrnoStr()};
+  }
+  return Status::Ok();
+}
+
 static Status BindIPv4(int fd, const EndPoint& ep) {
   struct sockaddr_in addr;
   memset(&addr, 0, sizeof(addr));
@@ -97,14 +116,96 @@ static Status BindIPv6(int fd, const EndPoint& ep) {
   return Status::Ok();
 }
 
+// 绑定到 Unix 域套接字的路径，perm 不为 0 时修改套接字文件的权限
+static Status BindUnix(int fd, const EndPoint& ep, uint32_t perm) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  const auto& path = ep.ip();
+  if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+    return {kInvalidAddr, format("invalid unix socket path '{}'", path)};
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size());
+
+  // 删除上次运行时遗留的套接字文件，否则 bind 会失败
+  // 路径上是其他类型的文件时报错，避免配置错误时误删文件
+  struct stat st;
+  if (lstat(path.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      return {kInvalidAddr,
+              format("unix socket path '{}' exists and is not a socket", path)};
+    }
+    unlink(path.c_str());
+  } else if (errno != ENOENT) {
+    return {errno, ErrnoStr()};
+  }
+  int ret = bind(fd, reinterpret_cast<const struct sockaddr*>(&addr),
+                 sizeof(addr));
+  if (ret == -1) {
+    return {errno, ErrnoStr()};
+  }
+
+  if (perm != 0) {
+    ret = chmod(path.c_str(), perm);
+    if (ret == -1) {
+      return {errno, ErrnoStr()};
+    }
+  }
+  return Status::Ok();
+}
+
 // 将套接字绑定到 EndPoint
-static Status Bind(int fd, const EndPoint& ep) {
+static Status Bind(int fd, const EndPoint& ep, uint32_t perm) {
   if (ep.type() == InetType::kIPv4) {
     return BindIPv4(fd, ep);
+  } else if (ep.type() == InetType::kUnix) {
+    return BindUnix(fd, ep, perm);
   }
   return BindIPv6(fd, ep);
 }
 
+// 获取连接套接字的远程端点
+static Status GetRemote(int sock, EndPoint& remote) {
+  sockaddr_storage addr;
+  socklen_t len = sizeof(addr);
+  int ret = getpeername(sock, reinterpret_cast<sockaddr*>(&addr), &len);
+  if (ret == -1) {
+    return {errno, ErrnoStr()};
+  }
+
+  if (addr.ss_family == AF_UNIX) {
+    // 客户端的套接字通常没有绑定路径
+    auto addr_un = reinterpret_cast<sockaddr_un*>(&addr);
+    size_t path_len = len > offsetof(sockaddr_un, sun_path)
+                          ? strnlen(addr_un->sun_path,
+                                    len - offsetof(sockaddr_un, sun_path))
+                          : 0;
+    remote.set_type(InetType::kUnix);
+    remote.set_ip(std::string(addr_un->sun_path, path_len));
+    remote.set_port(0);
+    return Status::Ok();
+  }
+
+  char buf[INET6_ADDRSTRLEN] = {};
+  if (addr.ss_family == AF_INET) {
+    auto addr4 = reinterpret_cast<sockaddr_in*>(&addr);
+    if (inet_ntop(AF_INET, &addr4->sin_addr, buf, sizeof(buf)) == nullptr) {
+      return {errno, ErrnoStr()};
+    }
+    remote.set_type(InetType::kIPv4);
+    remote.set_port(ntohs(addr4->sin_port));
+  } else {
+    auto addr6 = reinterpret_cast<sockaddr_in6*>(&addr);
+    if (inet_ntop(AF_INET6, &addr6->sin6_addr, buf, sizeof(buf)) == nullptr) {
+      return {errno, ErrnoStr()};
+    }
+    remote.set_type(InetType::kIPv6);
+    remote.set_port(ntohs(addr6->sin6_port));
+  }
+  remote.set_ip(buf);
+  return Status::Ok();
+}
+
 static Status Listen(int fd, int backlog) {
   int ret = listen(fd, backlog);
   if (ret == -1) {
@@ -113,7 +214,7 @@ static Status Listen(int fd, int backlog) {
   return Status::Ok();
 }
 
-Status Acceptor::Start(int backlog) {
+Status Acceptor::Start(int backlog, bool reuse_port, uint32_t perm) {
   auto status = CreateSocket(ep_.type(), listen_fd_);
   if (status.error()) {
     return status;
@@ -129,7 +230,24 @@ Status Acceptor::Start(int backlog) {
     return status;
   }
 
-  status = Bind(listen_fd_, ep_);
+  if (reuse_port) {
+    status = SetReusePort(listen_fd_);
+    if (status.error()) {
+      return status;
+    }
+  }
+
+  status = Bind(listen_fd_, ep_, perm);
+  if (status.error()) {
+    return status;
+  }
+
+  status = ApplyListenOpts(listen_fd_, ep_.type(), opts_);
+  if (status.error()) {
+    return status;
+  }
+  // 连接套接字的选项也设置在监听套接字上，使错误的配置在启动时即被发现
+  status = ApplyConnOpts(listen_fd_, ep_.type(), opts_);
   if (status.error()) {
     return status;
   }
@@ -139,91 +257,181 @@ Status Acceptor::Start(int backlog) {
     return status;
   }
 
-  return Status::Ok();
+  // 使用 io_uring 引擎时通过多次接受连接请求接受连接
+  if (loop_->uring() != nullptr) {
+    return Status::Ok();
+  }
+  // 一直监听可读事件，调用 Serve 之后才开始接受连接
+  return loop_->Add(listen_fd_, EPOLLIN, this);
 }
 
-void Acceptor::AsyncAccept(shared_ptr<Conn> conn, AcceptHandler handler) {
-  assert(handler);
+Status Acceptor::Inherit(int fd) {
+  assert(listen_fd_ == -1);
+  listen_fd_ = fd;
 
-  if (reqs_.size() > 0) {
-    reqs_.emplace_back(conn, std::move(handler));
-    return;
+  auto status = SetNonBlock(listen_fd_);
+  if (status.error()) {
+    return status;
   }
+  // 新的配置可能修改了套接字选项
+  status = ApplyListenOpts(listen_fd_, ep_.type(), opts_);
+  if (status.error()) {
+    return status;
+  }
+  status = ApplyConnOpts(listen_fd_, ep_.type(), opts_);
+  if (status.error()) {
+    return status;
+  }
+
+  if (loop_->uring() != nullptr) {
+    return Status::Ok();
+  }
+  return loop_->Add(listen_fd_, EPOLLIN, this);
+}
 
-  auto status = Accept(conn);
-  if (status.ok() || status.code() != EAGAIN) {
-    handler(std::move(status));
+void Acceptor::Stop() {
+  if (listen_fd_ == -1) {
     return;
   }
 
-  reqs_.emplace_back(conn, std::move(handler));
-  status = loop_->SetInEvent(listen_fd_, bind(OnAccept, shared_from_this()));
-  if (status.error()) {
-    handler(std::move(status));
+  auto uring = loop_->uring();
+  if (uring == nullptr) {
+    auto status = loop_->Remove(listen_fd_);
+    assert(status.ok());
+    close(listen_fd_);
+  } else {
+    // 先取消多次接受连接请求再关闭套接字
+    auto sqe = uring->PrepCancelFd(listen_fd_);
+    sqe->flags |= IOSQE_IO_HARDLINK;
+    uring->PrepClose(listen_fd_);
   }
+  listen_fd_ = -1;
 }
 
-Status Acceptor::Accept(shared_ptr<Conn> conn) {
-  EndPoint remote;
-  int sock = -1;
-
-  if (ep_.type() == InetType::kIPv4) {
-    sockaddr_in addr;
-    socklen_t len = 0;
-    sock = accept4(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), &len,
-                   SOCK_NONBLOCK);
-    if (sock == -1) {
-      return {errno, ErrnoStr()};
+void Acceptor::Serve(AcceptHandler handler) {
+  assert(handler);
+  assert(!handler_);
+  handler_ = std::move(handler);
+
+  auto uring = loop_->uring();
+  if (uring != nullptr) {
+    uring->PrepAcceptMultishot(listen_fd_, &accept_op_);
+    accept_armed_ = true;
+    return;
+  }
+  // 在 Serve 之前到达的连接不会再触发可读事件
+  AcceptAll();
+}
+
+void Acceptor::AcceptAll() {
+  // 让出或等待重试期间可能已经停止
+  if (listen_fd_ == -1) {
+    return;
+  }
+  for (int i = 0; i < kMaxAcceptsPerIteration; i++) {
+    int sock = accept4(listen_fd_, nullptr, nullptr,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (sock != -1) {
+      Deliver(sock);
+      continue;
     }
 
-    char buf[20] = {};
-    auto ret = inet_ntop(AF_INET, &addr, buf, 20);
-    if (ret == nullptr) {
-      return {errno, ErrnoStr()};
+    if (errno == EAGAIN) {
+      return;
     }
-    remote.set_type(InetType::kIPv4);
-    remote.set_ip(buf);
-    remote.set_port(ntohs(addr.sin_port));
-  } else {
-    sockaddr_in6 addr;
-    socklen_t len = 0;
-    sock = accept4(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), &len,
-                   SOCK_NONBLOCK);
-    if (sock == -1) {
-      return {errno, ErrnoStr()};
+    // 连接在被接受前已被对端重置，继续接受下一个连接
+    if (errno == ECONNABORTED || errno == EINTR) {
+      continue;
     }
+    // 文件描述符或内存耗尽时，未被接受的连接不会再触发可读事件，
+    // 因此稍后重试
+    SPDLOG_WARN("accept failed, retry in {}ms: {}", kAcceptRetryDelay,
+                ErrnoStr());
+    paused_ = true;
+    loop_->RunAfter(kAcceptRetryDelay, Resume());
+    return;
+  }
 
-    char buf[40] = {};
-    auto ret = inet_ntop(AF_INET6, &addr, buf, 40);
-    if (ret == nullptr) {
-      return {errno, ErrnoStr()};
-    }
-    remote.set_type(InetType::kIPv6);
-    remote.set_ip(buf);
-    remote.set_port(ntohs(addr.sin6_port));
+  // 达到本轮的上限时让出，使已经建立的连接上的请求先被处理
+  paused_ = true;
+  loop_->Yield(Resume());
+}
+
+Loop::Handler Acceptor::Resume() {
+  return [self = shared_from_this()] {
+    self->paused_ = false;
+    self->AcceptAll();
+  };
+}
+
+void Acceptor::Deliver(int sock) {
+  auto conn = Conn::New();
+  auto status = Adopt(conn, sock);
+  if (status.error()) {
+    SPDLOG_WARN("adopt connection failed: {}", status.ToString());
+    return;
+  }
+  handler_(std::move(conn));
+}
+
+Status Acceptor::Adopt(shared_ptr<Conn> conn, int sock) {
+  EndPoint remote;
+  auto status = GetRemote(sock, remote);
+  if (status.error()) {
+    close(sock);
+    return status;
+  }
+  status = ApplyConnOpts(sock, ep_.type(), opts_);
+  if (status.error()) {
+    close(sock);
+    return status;
   }
 
   conn->Connect(sock, std::move(remote));
-  conn->Attach(loop_);
+  status = conn->Attach(loop_);
+  if (status.error()) {
+    conn->Close();
+    return status;
+  }
   return Status::Ok();
 }
 
-void Acceptor::OnAccept(shared_ptr<Acceptor> acceptor) {
-  assert(acceptor->reqs_.size() > 0);
+void Acceptor::OnReadable() {
+  // 暂停时由之后的重试继续接受连接
+  if (handler_ && !paused_) {
+    AcceptAll();
+  }
+}
+
+void Acceptor::OnUringAccept(int res, uint32_t flags) {
+  if (!(flags & IORING_CQE_F_MORE)) {
+    accept_armed_ = false;
+  }
 
-  while (acceptor->reqs_.size() > 0) {
-    auto& req = acceptor->reqs_.front();
-    auto status = acceptor->Accept(req.conn());
-    if (status.code() == EAGAIN) {
-      return;
-    }
-    req.handler()(status);
-    acceptor->reqs_.pop_front();
+  if (res >= 0) {
+    Deliver(res);
+  } else if (res != -ECONNABORTED && res != -EINTR && res != -ECANCELED) {
+    errno = -res;
+    SPDLOG_WARN("accept failed: {}", ErrnoStr());
   }
 
-  // 没有待处理的建立连接请求，停止等待可读事件
-  auto status = acceptor->loop_->SetInEvent(acceptor->listen_fd_, nullptr);
-  assert(status.ok());
+  // 多次接受连接请求被内核终止时重新提交，文件描述符耗尽时稍后重试
+  if (!accept_armed_ && listen_fd_ != -1) {
+    auto resubmit = [self = shared_from_this()] {
+      if (self->listen_fd_ == -1) {
+        return;
+      }
+      self->loop_->uring()->PrepAcceptMultishot(self->listen_fd_,
+                                                &self->accept_op_);
+      self->accept_armed_ = true;
+    };
+    if (res == -EMFILE || res == -ENFILE || res == -ENOBUFS ||
+        res == -ENOMEM) {
+      loop_->RunAfter(kAcceptRetryDelay, resubmit);
+    } else {
+      resubmit();
+    }
+  }
 }
 
 }  // namespace mydss::net
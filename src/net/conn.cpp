@@ -12,26 +12,125 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+// linux/errqueue.h 依赖 sys/socket.h 中的 timespec
+#include <linux/errqueue.h>
+
+#include <algorithm>
+#include <cstring>
 #include <err/code.hpp>
 #include <err/errno.hpp>
 #include <net/conn.hpp>
+#include <util/buf_pool.hpp>
 
 using mydss::err::ErrnoStr;
 using mydss::err::kEof;
 using mydss::err::Status;
 using mydss::util::Slice;
 using std::shared_ptr;
+using std::vector;
 
 namespace mydss::net {
 
+// 每个线程的对象池中最多保留的空闲 Conn 对象的数目
+static constexpr size_t kMaxFreeConns = 1024;
+
+static util::Pool<Conn>& ConnPool() {
+  static thread_local auto pool = util::Pool<Conn>::New(kMaxFreeConns);
+  return *pool;
+}
+
+shared_ptr<Conn> Conn::New() { return ConnPool().Make(); }
+
+void Conn::Reserve(size_t n) { ConnPool().Reserve(n); }
+
+// 每个线程的缓冲区池中每种大小最多保留的空闲缓冲区的数目
+// 同一时刻只有正在接收数据的连接持有接收缓冲区，因此不需要很多
+static constexpr size_t kMaxFreeBufs = 16;
+
+static util::BufPool& RecvBufPool() {
+  static thread_local auto pool = util::BufPool::New(kMaxFreeBufs);
+  return *pool;
+}
+
+const Slice& Conn::RecvReq::Buf(size_t hint) {
+  if (size_ > 0 && slice_.empty()) {
+    auto buf = RecvBufPool().Get(std::min(size_, hint));
+    slice_ = Slice(buf, 0, std::min(size_, buf.size()));
+  }
+  return slice_;
+}
+
+void Conn::RecvReq::Release() {
+  if (size_ > 0) {
+    slice_ = Slice();
+  }
+}
+
+void Conn::RecvReq::Complete(Status status, size_t nbytes) {
+  if (size_ == 0) {
+    handler_(std::move(status), nbytes);
+    return;
+  }
+  auto data = nbytes > 0 ? Slice(slice_, 0, nbytes) : Slice();
+  slice_ = Slice();
+  buf_handler_(std::move(status), std::move(data));
+}
+
+Status Conn::Attach(shared_ptr<Loop> loop) {
+  assert(loop_ == nullptr);
+  assert(!loop->Contains(sock_));
+  loop_ = loop;
+  uring_ = loop->uring();
+  if (uring_ != nullptr) {
+    return Status::Ok();
+  }
+
+  // 在连接的整个生命周期内监听读写事件，读写时不再需要调用 epoll_ctl
+  // Close 会在 Conn 对象销毁前将套接字从 loop 中移除
+  return loop->Add(sock_, EPOLLIN | EPOLLOUT, this);
+}
+
+void Conn::set_zerocopy_threshold(size_t threshold) {
+  zerocopy_threshold_ = threshold;
+  zerocopy_ = false;
+  if (threshold == 0 || uring_ != nullptr) {
+    return;
+  }
+
+  int one = 1;
+  int ret = setsockopt(sock_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+  // 例如 Unix 域套接字不支持零拷贝发送
+  zerocopy_ = ret == 0;
+}
+
 void Conn::Close() {
   assert(sock_ != -1);
 
+  if (uring_ != nullptr) {
+    UringClose();
+    return;
+  }
+
   // 清空所有尚未完成的读写请求
   recv_reqs_.clear();
   send_reqs_.clear();
+  unsent_bytes_ = 0;
+  sent_ = 0;
+
+  if (!zerocopy_pending_.empty()) {
+    ReapZerocopy();
+  }
+  // 关闭套接字后无法再获取完成通知，而内核可能仍在发送这些数据，
+  // 因此在一段时间后再释放
+  if (!zerocopy_pending_.empty() && loop_ != nullptr) {
+    loop_->RunAfter(kZerocopyLinger,
+                    [pending = std::move(zerocopy_pending_)] {});
+    zerocopy_pending_.clear();
+  }
 
   if (loop_ != nullptr) {
     auto status = loop_->Remove(sock_);
@@ -44,139 +143,474 @@ void Conn::Close() {
 }
 
 void Conn::AsyncRecv(Slice slice, RecvHandler handler) {
-  if (recv_reqs_.size() > 0) {
-    recv_reqs_.emplace_back(slice, std::move(handler));
+  Recv(RecvReq(slice, std::move(handler)));
+}
+
+void Conn::AsyncRecv(size_t size, RecvBufHandler handler) {
+  assert(size > 0);
+  Recv(RecvReq(size, std::move(handler)));
+}
+
+void Conn::Recv(RecvReq req) {
+  if (uring_ != nullptr) {
+    UringRecv(std::move(req));
+    return;
+  }
+
+  recv_reqs_.push_back(std::move(req));
+  // 套接字不可读时等待可读事件，正在读取或已经让出时由之后的读取完成该请求
+  if (readable_ && !draining_ && !recv_yielded_) {
+    DrainRecv();
+  }
+}
+
+void Conn::AsyncSend(Slice slice, SendHandler handler) {
+  // 允许 slice 为空，一般用于检测发送队列是否发送完成
+  if (slice.empty() && send_reqs_.empty()) {
+    handler(Status::Ok());
     return;
   }
 
-  auto nbytes = read(sock_, slice.data(), slice.size());
-  if (nbytes == 0) {
-    handler({kEof, "end of file"}, 0);
+  unsent_bytes_ += slice.size();
+  send_reqs_.emplace_back(slice, std::move(handler));
+
+  // 正在等待可写事件或正在发送时，由之后的发送完成事件继续发送
+  if (!writable_ || send_inflight_) {
     return;
-  } else if (nbytes > 0) {
-    handler(Status::Ok(), nbytes);
+  }
+  // 待发送的数据较多时立即发送，否则在本轮事件分发结束后合并发送
+  if (unsent_bytes_ >= kFlushThreshold) {
+    Flush();
     return;
   }
+  if (!flush_deferred_) {
+    flush_deferred_ = true;
+    loop_->Defer([conn = shared_from_this()] {
+      conn->flush_deferred_ = false;
+      if (!conn->closed() && conn->writable_ && !conn->send_inflight_) {
+        conn->Flush();
+      }
+    });
+  }
+}
 
-  // nbytes == -1
-  if (errno != EAGAIN) {
-    handler({errno, ErrnoStr()}, 0);
+void Conn::Flush() {
+  if (uring_ != nullptr) {
+    UringFlush();
     return;
   }
 
-  // 监听可读事件
-  auto status = loop_->SetInEvent(sock_, bind(OnRecv, shared_from_this()));
-  if (status.error()) {
-    handler(std::move(status), 0);
+  // 回调可能释放 Conn 对象的最后一个引用
+  auto self = shared_from_this();
+
+  while (send_reqs_.size() > 0) {
+    // 将发送队列中的数据合并为一次系统调用
+    iovec iov[kMaxIovecs];
+    int iovcnt = FillIovecs(iov);
+    ssize_t nbytes = 0;
+    bool zerocopy = false;
+    if (iovcnt > 0) {
+      msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iovcnt;
+      // 对端关闭连接时不产生 SIGPIPE 信号，而是返回 EPIPE
+      int flags = MSG_NOSIGNAL;
+      // 只要有一段数据足够大就使用零拷贝发送，较小的数据随之一起发送
+      zerocopy = zerocopy_ && std::any_of(iov, iov + iovcnt, [this](auto& v) {
+                   return v.iov_len >= zerocopy_threshold_;
+                 });
+      nbytes = sendmsg(sock_, &msg, flags | (zerocopy ? MSG_ZEROCOPY : 0));
+      // 锁定的内存超出限制时回退为复制发送
+      if (nbytes == -1 && zerocopy && errno == ENOBUFS) {
+        zerocopy = false;
+        nbytes = sendmsg(sock_, &msg, flags);
+      }
+    }
+
+    if (nbytes == -1) {
+      if (errno == EAGAIN) {
+        // 等待可写事件
+        writable_ = false;
+        return;
+      }
+      FailSends({errno, ErrnoStr()});
+      return;
+    }
+
+    // 内核在完成通知到达前仍会读取这些数据，在此之前持有它们
+    if (zerocopy) {
+      vector<Slice> slices;
+      for (const auto& req : send_reqs_) {
+        if (slices.size() == static_cast<size_t>(iovcnt)) {
+          break;
+        }
+        if (!req.slice().empty()) {
+          slices.push_back(req.slice());
+        }
+      }
+      zerocopy_pending_.emplace_back(zerocopy_seq_++, std::move(slices));
+    }
+
+    CompleteSends(nbytes);
+    if (closed()) {
+      return;
+    }
   }
-  recv_reqs_.emplace_back(slice, std::move(handler));
 }
 
-void Conn::AsyncSend(Slice slice, SendHandler handler) {
-  if (send_reqs_.size() > 0) {
-    send_reqs_.emplace_back(slice, std::move(handler));
-    return;
+void Conn::ReapZerocopy() {
+  while (!zerocopy_pending_.empty()) {
+    char control[CMSG_SPACE(sizeof(sock_extended_err))];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock_, &msg, MSG_ERRQUEUE) == -1) {
+      return;
+    }
+
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr) {
+      continue;
+    }
+    auto serr = reinterpret_cast<sock_extended_err*>(CMSG_DATA(cmsg));
+    if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+      continue;
+    }
+    // 例如通过回环接口发送时内核仍会复制数据，此时零拷贝只会增加开销
+    if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+      zerocopy_ = false;
+    }
+
+    // 通知表示序号在 [ee_info, ee_data] 中的发送已经完成
+    uint32_t lo = serr->ee_info;
+    uint32_t hi = serr->ee_data;
+    auto it = zerocopy_pending_.begin();
+    while (it != zerocopy_pending_.end()) {
+      if (it->first - lo <= hi - lo) {
+        it = zerocopy_pending_.erase(it);
+      } else {
+        ++it;
+      }
+    }
   }
+}
 
-  // 允许 slice 为空，一般用于检测发送队列是否发送完成
-  if (slice.empty()) {
-    handler(Status::Ok());
-    return;
+int Conn::FillIovecs(iovec* iov) const {
+  int iovcnt = 0;
+  size_t offset = sent_;
+  for (const auto& req : send_reqs_) {
+    if (iovcnt == kMaxIovecs) {
+      break;
+    }
+    if (req.slice().size() > offset) {
+      iov[iovcnt].iov_base = req.slice().data() + offset;
+      iov[iovcnt].iov_len = req.slice().size() - offset;
+      iovcnt++;
+    }
+    offset = 0;
   }
+  return iovcnt;
+}
 
-  auto nbytes = write(sock_, slice.data(), slice.size());
-  assert(nbytes != 0);
-  if (nbytes == slice.size()) {
+void Conn::CompleteSends(size_t nbytes) {
+  unsent_bytes_ -= nbytes;
+  // 完成所有已经全部发送的请求，空的请求在之前的请求完成后即可完成
+  while (send_reqs_.size() > 0) {
+    auto& req = send_reqs_.front();
+    size_t remain = req.slice().size() - sent_;
+    if (nbytes < remain) {
+      sent_ += nbytes;
+      return;
+    }
+    nbytes -= remain;
+    sent_ = 0;
+    auto handler = req.handler();
+    send_reqs_.pop_front();
     handler(Status::Ok());
-    return;
-  } else if (nbytes > 0) {
-    Slice unsent(slice, nbytes, slice.size());
-    send_reqs_.emplace_back(slice, std::move(handler));
-    // 监听可写事件
-    auto status = loop_->SetOutEvent(sock_, bind(OnSend, shared_from_this()));
-    if (status.error()) {
-      handler(std::move(status));
+    // 连接在回调中被关闭
+    if (closed()) {
+      return;
     }
-    return;
   }
+}
 
-  // nbytes == -1
-  if (errno != EAGAIN) {
-    handler({errno, ErrnoStr()});
-    return;
+void Conn::FailSends(Status status) {
+  while (send_reqs_.size() > 0) {
+    auto handler = send_reqs_.front().handler();
+    send_reqs_.pop_front();
+    handler(status);
+    if (closed()) {
+      return;
+    }
   }
+  unsent_bytes_ = 0;
+  sent_ = 0;
+}
 
-  send_reqs_.emplace_back(slice, std::move(handler));
-  // 监听可写事件
-  auto status = loop_->SetOutEvent(sock_, bind(OnSend, shared_from_this()));
-  if (status.error()) {
-    handler(std::move(status));
+void Conn::OnRecv(shared_ptr<Conn> conn) {
+  conn->readable_ = true;
+  // 已经让出时由下一轮继续读取
+  if (conn->recv_yielded_) {
+    return;
   }
+  conn->recv_budget_ = kRecvBudget;
+  conn->DrainRecv();
 }
 
-void Conn::OnRecv(shared_ptr<Conn> conn) {
-  assert(conn->recv_reqs_.size() > 0);
+void Conn::DrainRecv() {
+  // 回调可能释放 Conn 对象的最后一个引用
+  auto self = shared_from_this();
+
+  draining_ = true;
+  while (recv_reqs_.size() > 0) {
+    if (recv_budget_ == 0) {
+      recv_yielded_ = true;
+      loop_->Yield([self] {
+        self->recv_yielded_ = false;
+        if (!self->closed()) {
+          self->recv_budget_ = kRecvBudget;
+          self->DrainRecv();
+        }
+      });
+      break;
+    }
 
-  while (conn->recv_reqs_.size() > 0) {
-    auto req = std::move(conn->recv_reqs_.front());
-    conn->recv_reqs_.pop_front();
+    auto req = std::move(recv_reqs_.front());
+    recv_reqs_.pop_front();
 
-    auto nbytes = read(conn->sock_, req.slice().data(), req.slice().size());
+    const auto& buf = req.Buf();
+    auto nbytes = read(sock_, buf.data(), buf.size());
     if (nbytes == 0) {
-      req.handler()({kEof, "end of file"}, 0);
-      return;
+      req.Complete({kEof, "end of file"}, 0);
+      break;
     } else if (nbytes == -1) {
       if (errno != EAGAIN) {
-        req.handler()({errno, ErrnoStr()}, 0);
+        req.Complete({errno, ErrnoStr()}, 0);
       } else {
-        conn->recv_reqs_.emplace_front(std::move(req));
+        // 等待可读事件期间不持有缓冲区
+        readable_ = false;
+        req.Release();
+        recv_reqs_.push_front(std::move(req));
       }
-      return;
+      break;
     }
 
-    req.handler()(Status::Ok(), nbytes);
+    recv_budget_ -= std::min<size_t>(nbytes, recv_budget_);
+    req.Complete(Status::Ok(), nbytes);
+    // 连接在回调中被关闭
+    if (closed()) {
+      break;
+    }
   }
+  draining_ = false;
+}
 
-  // 当连接在回调中关闭时，conn->loop_ 为 nullptr
-  if (conn->loop_ != nullptr) {
-    // 停止监听可读事件
-    auto status = conn->loop_->SetInEvent(conn->sock_, {});
-    assert(status.ok());
+void Conn::OnSend(shared_ptr<Conn> conn) {
+  // 零拷贝发送的完成通知以 EPOLLERR 事件的形式到达
+  if (!conn->zerocopy_pending_.empty()) {
+    conn->ReapZerocopy();
+  }
+  conn->writable_ = true;
+  if (conn->send_reqs_.size() > 0) {
+    conn->Flush();
   }
 }
 
-void Conn::OnSend(shared_ptr<Conn> conn) {
-  assert(conn->send_reqs_.size() > 0);
+void Conn::UringRecv(RecvReq req) {
+  if (recv_reqs_.size() > 0) {
+    recv_reqs_.push_back(std::move(req));
+    return;
+  }
 
-  while (conn->send_reqs_.size() > 0) {
-    auto req = std::move(conn->send_reqs_.front());
-    conn->send_reqs_.pop_front();
+  // 优先取走已经接收的数据
+  if (stash_off_ < stash_.size()) {
+    size_t avail = stash_.size() - stash_off_;
+    const auto& buf = req.Buf(avail);
+    size_t nbytes = std::min(buf.size(), avail);
+    memcpy(buf.data(), stash_.data() + stash_off_, nbytes);
+    stash_off_ += nbytes;
+    if (stash_off_ == stash_.size()) {
+      std::string().swap(stash_);
+      stash_off_ = 0;
+    }
+    req.Complete(Status::Ok(), nbytes);
+    return;
+  }
 
-    auto nbytes = write(conn->sock_, req.slice().data(), req.slice().size());
-    assert(nbytes != 0);
-    if (nbytes == req.slice().size()) {
-      req.handler()(Status::Ok());
-      continue;
-    } else if (nbytes > 0) {
-      Slice unsent(req.slice(), nbytes, req.slice().size());
-      req.set_slice(unsent);
-      conn->send_reqs_.emplace_front(std::move(req));
+  if (recv_status_.error()) {
+    req.Complete(recv_status_, 0);
+    return;
+  }
+
+  recv_reqs_.push_back(std::move(req));
+  if (!recv_armed_) {
+    Pin();
+    uring_->PrepRecvMultishot(sock_, &recv_op_);
+    recv_armed_ = true;
+  }
+}
+
+void Conn::UringFlush() {
+  if (send_inflight_ || send_reqs_.empty()) {
+    return;
+  }
+
+  if (send_msg_ == nullptr) {
+    send_msg_ = std::make_unique<SendMsg>();
+  }
+  int iovcnt = FillIovecs(send_msg_->iov);
+  if (iovcnt == 0) {
+    // 只剩下空的请求
+    CompleteSends(0);
+    return;
+  }
+
+  auto& msg = send_msg_->msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = send_msg_->iov;
+  msg.msg_iovlen = iovcnt;
+  Pin();
+  uring_->PrepSendMsg(sock_, &msg, &send_op_);
+  send_inflight_ = true;
+}
+
+void Conn::DeliverRecv() {
+  while (recv_reqs_.size() > 0) {
+    if (stash_off_ == stash_.size() && recv_status_.ok()) {
       return;
-    } else {
-      if (errno != EAGAIN) {
-        req.handler()({errno, ErrnoStr()});
-        return;
-      }
-      conn->send_reqs_.emplace_front(std::move(req));
+    }
+
+    auto req = std::move(recv_reqs_.front());
+    recv_reqs_.pop_front();
+    // 此时 recv_reqs_ 中已经没有更早的请求，UringRecv 会直接完成该请求
+    UringRecv(std::move(req));
+    if (closed()) {
       return;
     }
   }
+}
 
-  // 当连接在回调中关闭时，conn->loop_ 为 nullptr
-  if (conn->loop_ != nullptr) {
-    // 停止监听可写事件
-    auto status = conn->loop_->SetOutEvent(conn->sock_, {});
-    assert(status.ok());
+void Conn::OnUringRecv(int res, uint32_t flags) {
+  bool more = flags & IORING_CQE_F_MORE;
+  if (!more) {
+    recv_armed_ = false;
+  }
+
+  if (res > 0) {
+    uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+    const char* data = uring_->Buf(bid);
+    size_t off = 0;
+    // 没有积压的数据时直接复制到等待中的接收请求的缓冲区，剩余的数据放入 stash_
+    while (!closed() && off < static_cast<size_t>(res) &&
+           stash_off_ == stash_.size() && recv_reqs_.size() > 0) {
+      auto req = std::move(recv_reqs_.front());
+      recv_reqs_.pop_front();
+      const auto& buf = req.Buf(res - off);
+      size_t nbytes = std::min(buf.size(), res - off);
+      memcpy(buf.data(), data + off, nbytes);
+      off += nbytes;
+      req.Complete(Status::Ok(), nbytes);
+    }
+    if (!closed() && off < static_cast<size_t>(res)) {
+      stash_.append(data + off, res - off);
+    }
+    uring_->RecycleBuf(bid);
+  } else if (res == 0) {
+    recv_status_ = {kEof, "end of file"};
+  } else if (res != -ENOBUFS && res != -ECANCELED) {
+    errno = -res;
+    recv_status_ = {errno, ErrnoStr()};
+  }
+
+  if (!closed()) {
+    DeliverRecv();
+  }
+  // 上层暂停接收时不再继续接收，数据留在套接字的接收缓冲区中
+  if (!closed() && recv_armed_ && recv_reqs_.empty() &&
+      stash_.size() - stash_off_ >= kMaxStash) {
+    uring_->PrepCancel(&recv_op_);
+  }
+  // 多次接收请求被内核终止，且仍有等待中的接收请求时重新提交
+  if (!closed() && !recv_armed_ && recv_status_.ok() &&
+      recv_reqs_.size() > 0) {
+    Pin();
+    uring_->PrepRecvMultishot(sock_, &recv_op_);
+    recv_armed_ = true;
+  }
+
+  if (!more) {
+    Unpin();
+  }
+}
+
+void Conn::OnUringSend(int res, uint32_t /*flags*/) {
+  send_inflight_ = false;
+  if (closed()) {
+    // 连接关闭后才能释放正在发送的数据
+    send_reqs_.clear();
+    send_msg_ = nullptr;
+    Unpin();
+    return;
+  }
+
+  if (res < 0) {
+    errno = -res;
+    FailSends({errno, ErrnoStr()});
+  } else {
+    CompleteSends(res);
+  }
+
+  if (!closed()) {
+    UringFlush();
+  }
+  // 没有正在进行的 sendmsg 请求时释放其参数
+  if (!send_inflight_) {
+    send_msg_ = nullptr;
+  }
+  Unpin();
+}
+
+void Conn::UringClose() {
+  // 清空所有尚未完成的读写请求，正在发送时需要保留数据直到请求结束
+  recv_reqs_.clear();
+  if (!send_inflight_) {
+    send_reqs_.clear();
+  }
+  unsent_bytes_ = 0;
+  sent_ = 0;
+  if (send_inflight_) {
+    for (auto& req : send_reqs_) {
+      req = SendReq(req.slice(), nullptr);
+    }
+  }
+  std::string().swap(stash_);
+  stash_off_ = 0;
+  loop_ = nullptr;
+
+  if (inflight_ == 0) {
+    close(sock_);
+  } else {
+    // 先取消套接字上的所有请求再关闭套接字
+    auto sqe = uring_->PrepCancelFd(sock_);
+    sqe->flags |= IOSQE_IO_HARDLINK;
+    uring_->PrepClose(sock_);
+  }
+  sock_ = -1;
+}
+
+void Conn::Pin() {
+  if (inflight_++ == 0) {
+    pinned_ = shared_from_this();
+  }
+}
+
+void Conn::Unpin() {
+  assert(inflight_ > 0);
+  if (--inflight_ == 0) {
+    // 最后一个引用可能来自 pinned_，在函数返回时才释放
+    auto self = std::move(pinned_);
   }
 }
 
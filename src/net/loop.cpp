@@ -12,150 +12,365 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <spdlog/spdlog.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <err/errno.hpp>
+#include <mutex>
 #include <net/loop.hpp>
 
 using mydss::err::ErrnoStr;
 using mydss::err::Status;
+using std::shared_ptr;
+using std::vector;
 
 namespace mydss::net {
 
-Status Loop::SetInEvent(int fd, Handler handler) {
-  auto it = fds_.find(fd);
-  if (it == fds_.end()) {
-    struct epoll_event ev;
-    ev.data.fd = fd;
-    ev.events = EPOLLET | EPOLLIN;
-    int ret = epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
-    if (ret == -1) {
-      return {errno, ErrnoStr()};
-    }
-    fds_[fd] = {std::move(handler), nullptr};
-    return Status::Ok();
+// 开启了忙等待的事件循环的统计信息
+static std::mutex busy_mutex;
+static vector<shared_ptr<BusyPollStats>> busy_registry;
+
+// 单调时钟的当前时间，单位为微秒
+static uint64_t NowUs() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+Loop::Loop(int max_events, Engine engine)
+    : epfd_(epoll_create(1)),
+      nfds_(0),
+      events_(max_events),
+      cur_(0),
+      nevents_(0),
+      timers_(Now()),
+      notify_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      notified_(false),
+      notifier_(this),
+      epoll_op_(this, &Loop::OnEpollReady) {
+  assert(epfd_ != -1);
+  assert(max_events > 0);
+  assert(notify_fd_ != -1);
+  auto status = Add(notify_fd_, EPOLLIN, &notifier_);
+  assert(status.ok());
+
+  if (engine != Engine::kUring) {
+    return;
+  }
+  status = Uring::New(uring_);
+  if (status.error()) {
+    SPDLOG_WARN("io_uring engine is unavailable, fall back to epoll: {}",
+                status.ToString());
+    return;
   }
+  uring_->PrepPollMultishot(epfd_, &epoll_op_);
+}
 
-  auto& handlers = it->second;
-  uint64_t old_events = 0;
-  uint64_t new_events = 0;
-  if (handlers.first) {
-    old_events |= EPOLLIN;
+Loop::~Loop() {
+  set_busy_poll(0);
+  // 先销毁 io_uring 实例，使内核中尚未完成的请求不再引用 epoll 文件描述符
+  uring_ = nullptr;
+  close(notify_fd_);
+  close(epfd_);
+}
+
+void Loop::set_busy_poll(uint64_t budget) {
+  busy_poll_ = budget;
+  std::lock_guard<std::mutex> lock(busy_mutex);
+  if (busy_stats_ != nullptr && budget == 0) {
+    busy_registry.erase(
+        std::find(busy_registry.begin(), busy_registry.end(), busy_stats_));
+    busy_stats_ = nullptr;
+  } else if (busy_stats_ == nullptr && budget > 0) {
+    busy_stats_ = std::make_shared<BusyPollStats>();
+    busy_stats_->tid = gettid();
+    busy_registry.push_back(busy_stats_);
   }
-  if (handlers.second) {
-    old_events |= EPOLLOUT;
-    new_events |= EPOLLOUT;
+  if (busy_stats_ != nullptr) {
+    busy_stats_->budget.store(budget, std::memory_order_relaxed);
   }
-  if (handler) {
-    new_events |= EPOLLIN;
+}
+
+vector<shared_ptr<const BusyPollStats>> Loop::AllBusyStats() {
+  std::lock_guard<std::mutex> lock(busy_mutex);
+  return {busy_registry.begin(), busy_registry.end()};
+}
+
+void Loop::Post(Handler task) {
+  posted_.Push(std::move(task));
+  // 事件循环已经被唤醒但尚未开始执行任务时，任务会在本次唤醒中被执行
+  if (!notified_.exchange(true, std::memory_order_acq_rel)) {
+    uint64_t one = 1;
+    [[maybe_unused]] auto nbytes = write(notify_fd_, &one, sizeof(one));
+    assert(nbytes == sizeof(one));
   }
+}
 
-  // 停止监听 fd
-  if (new_events == 0) {
-    int ret = epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
-    if (ret == -1) {
-      return {errno, ErrnoStr()};
-    }
+void Loop::OnNotified() {
+  uint64_t count;
+  [[maybe_unused]] auto nbytes = read(notify_fd_, &count, sizeof(count));
+  assert(nbytes == sizeof(count) || errno == EAGAIN);
+  RunPosted();
+}
+
+void Loop::RunPosted() {
+  // 在取出任务之前清除标志，此后提交的任务会重新唤醒事件循环
+  notified_.exchange(false, std::memory_order_acq_rel);
+
+  Handler task;
+  size_t n = 0;
+  while (n < kMaxPostsPerIteration && posted_.Pop(task)) {
+    task();
+    n++;
   }
-  // 只修改 handler
-  else if (old_events == new_events) {
-    handlers.first = std::move(handler);
+  stats_.posts += n;
+
+  // 任务过多时让出，避免其他事件饥饿，剩余的任务在下一轮执行
+  if (n == kMaxPostsPerIteration) {
+    notified_.store(true, std::memory_order_release);
+    Yield([this] { RunPosted(); });
+  }
+}
+
+Status Loop::Add(int fd, uint32_t events, Watcher* watcher) {
+  assert(fd >= 0);
+  assert(watcher != nullptr);
+  assert(!Contains(fd));
+
+  struct epoll_event ev;
+  ev.data.ptr = watcher;
+  ev.events = EPOLLET | events;
+  int ret = epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+  if (ret == -1) {
+    return {errno, ErrnoStr()};
+  }
+
+  if (static_cast<size_t>(fd) >= entries_.size()) {
+    entries_.resize(std::max<size_t>(fd + 1, entries_.size() * 2));
+  }
+  entries_[fd] = {watcher, events};
+  nfds_++;
+  return Status::Ok();
+}
+
+Status Loop::Modify(int fd, uint32_t events) {
+  assert(Contains(fd));
+  auto& entry = entries_[fd];
+  if (entry.events == events) {
     return Status::Ok();
   }
 
   struct epoll_event ev;
-  ev.data.fd = fd;
-  ev.events = EPOLLET | new_events;
+  ev.data.ptr = entry.watcher;
+  ev.events = EPOLLET | events;
   int ret = epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev);
   if (ret == -1) {
     return {errno, ErrnoStr()};
   }
-  handlers.first = std::move(handler);
+  entry.events = events;
   return Status::Ok();
 }
 
-Status Loop::SetOutEvent(int fd, Handler handler) {
-  auto it = fds_.find(fd);
-  if (it == fds_.end()) {
-    struct epoll_event ev;
-    ev.data.fd = fd;
-    ev.events = EPOLLET | EPOLLOUT;
-    int ret = epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
-    if (ret == -1) {
-      return {errno, ErrnoStr()};
-    }
-    fds_[fd] = {nullptr, std::move(handler)};
+Status Loop::Remove(int fd) {
+  if (!Contains(fd)) {
     return Status::Ok();
   }
 
-  auto& handlers = it->second;
-  uint64_t old_events = 0;
-  uint64_t new_events = 0;
-  if (handlers.first) {
-    old_events |= EPOLLIN;
-    new_events |= EPOLLIN;
+  int ret = epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+  if (ret == -1) {
+    return {errno, ErrnoStr()};
   }
-  if (handlers.second) {
-    old_events |= EPOLLOUT;
+  auto watcher = entries_[fd].watcher;
+  entries_[fd] = {};
+  nfds_--;
+
+  // Watcher 可能关闭同一批次中的其他 fd，包括正在分发的 fd，这些 fd 的事件
+  // 不能再被分发，否则会调用到已被移除或销毁的 Watcher
+  for (int i = cur_; i < nevents_; i++) {
+    if (events_[i].data.ptr == watcher) {
+      events_[i].events = 0;
+    }
   }
-  if (handler) {
-    new_events |= EPOLLOUT;
+  return Status::Ok();
+}
+
+void Loop::Run() {
+  for (;;) {
+    assert(uring_ != nullptr || nfds_ > 0 || timers_.size() > 0);
+    RunOnce(-1);
   }
+}
+
+void Loop::RunOnce(int timeout) {
+  // 开启忙等待时统计处理事件的时间，即本轮的总时间减去等待事件的时间
+  uint64_t start = busy_poll_ > 0 ? NowUs() : 0;
+
+  // 在事件循环之外添加的任务不能等到下一批事件到来后才执行
+  RunDeferred();
 
-  // 停止监听 fd
-  if (new_events == 0) {
-    int ret = epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
-    if (ret == -1) {
-      return {errno, ErrnoStr()};
+  // 有让出的任务时不能阻塞
+  std::vector<Handler> yielded;
+  yielded.swap(yielded_);
+  if (!yielded.empty()) {
+    timeout = 0;
+  }
+
+  // 先推进定时器的时间再分发事件，使分发事件时添加的定时器以当前时间为起点
+  timeout = Timeout(timeout);
+  uint64_t wait_start = busy_poll_ > 0 ? NowUs() : 0;
+  if (busy_poll_ > 0 && timeout != 0 && Spin(timeout)) {
+    timeout = 0;
+  }
+  if (uring_ == nullptr) {
+    // 忙等待获取到的事件尚未分发
+    if (nevents_ == 0) {
+      Wait(timeout);
     }
+  } else {
+    // 批量提交本轮准备的所有请求，并等待完成事件
+    auto status = uring_->SubmitAndWait(timeout);
+    if (status.error()) {
+      SPDLOG_CRITICAL("io_uring_enter failed: {}", status.ToString());
+      abort();
+    }
+    stats_.polls++;
   }
-  // 只修改 handler
-  else if (old_events == new_events) {
-    handlers.first = std::move(handler);
-    return Status::Ok();
+  uint64_t wait_end = busy_poll_ > 0 ? NowUs() : 0;
+
+  stats_.timers += timers_.Advance(Now());
+  if (uring_ == nullptr) {
+    Dispatch();
+  } else {
+    // 批量处理所有完成事件
+    stats_.events += uring_->Reap();
   }
 
-  struct epoll_event ev;
-  ev.data.fd = fd;
-  ev.events = EPOLLET | new_events;
-  int ret = epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev);
-  if (ret == -1) {
-    return {errno, ErrnoStr()};
+  for (auto& task : yielded) {
+    task();
+  }
+  RunDeferred();
+
+  if (busy_stats_ != nullptr) {
+    busy_stats_->work_time.fetch_add(
+        (NowUs() - start) - (wait_end - wait_start),
+        std::memory_order_relaxed);
   }
-  handlers.second = std::move(handler);
-  return Status::Ok();
 }
 
-Status Loop::Remove(int fd) {
-  // 如果 fd 已被监听则移除
-  if (fds_.find(fd) != fds_.end()) {
-    int ret = epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
-    if (ret == -1) {
-      return {errno, ErrnoStr()};
+bool Loop::Spin(int timeout) {
+  uint64_t start = NowUs();
+  uint64_t deadline = start + busy_poll_;
+  if (timeout > 0) {
+    deadline = std::min(deadline, start + static_cast<uint64_t>(timeout) * 1000);
+  }
+
+  bool ready = false;
+  uint64_t spins = 0;
+  uint64_t now = start;
+  while (!ready && now < deadline) {
+    if (uring_ == nullptr) {
+      Wait(0);
+      ready = nevents_ > 0;
+    } else {
+      // 进入内核提交请求并执行待完成的任务，完成事件由调用者处理
+      auto status = uring_->SubmitAndWait(0);
+      if (status.error()) {
+        SPDLOG_CRITICAL("io_uring_enter failed: {}", status.ToString());
+        abort();
+      }
+      stats_.polls++;
+      ready = uring_->HasCompletions();
     }
-    fds_.erase(fd);
+    spins++;
+    now = NowUs();
   }
-  return Status::Ok();
+
+  busy_stats_->spins.fetch_add(spins, std::memory_order_relaxed);
+  busy_stats_->spin_time.fetch_add(now - start, std::memory_order_relaxed);
+  if (!ready) {
+    busy_stats_->sleeps.fetch_add(1, std::memory_order_relaxed);
+  }
+  return ready;
 }
 
-void Loop::Run() {
-  for (;;) {
-    assert(fds_.size() > 0);
+uint64_t Loop::Now() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+
+int Loop::Timeout(int timeout) const {
+  uint64_t deadline = timers_.NextDeadline();
+  if (deadline == UINT64_MAX) {
+    return timeout;
+  }
+
+  uint64_t now = Now();
+  uint64_t wait = deadline > now ? deadline - now : 0;
+  if (timeout >= 0 && static_cast<uint64_t>(timeout) < wait) {
+    return timeout;
+  }
+  return static_cast<int>(std::min<uint64_t>(wait, INT32_MAX));
+}
+
+void Loop::RunDeferred() {
+  while (!deferred_.empty()) {
+    // 任务在执行时可能继续添加任务
+    std::vector<Handler> tasks;
+    tasks.swap(deferred_);
+    for (auto& task : tasks) {
+      task();
+    }
+  }
+}
 
-    epoll_event ev;
-    int ret = epoll_wait(epfd_, &ev, 1, -1);
-    assert(ret == 1);
+void Loop::OnEpollReady(int res, uint32_t flags) {
+  if (res > 0) {
+    Wait(0);
+    Dispatch();
+  }
+  // 多次监听请求被内核终止，需要重新提交
+  if (!(flags & IORING_CQE_F_MORE)) {
+    uring_->PrepPollMultishot(epfd_, &epoll_op_);
+  }
+}
 
-    if (ev.events & EPOLLIN) {
-      const auto& handler = fds_.at(ev.data.fd).first;
-      assert(handler);
-      handler();
+void Loop::Wait(int timeout) {
+  nevents_ = 0;
+  int ret = epoll_wait(epfd_, events_.data(), events_.size(), timeout);
+  if (ret == -1) {
+    if (errno == EINTR) {
+      return;
     }
+    // 其他错误说明 epfd_ 或 events_ 无效，重试只会不断地失败并占满 CPU
+    SPDLOG_CRITICAL("epoll_wait failed: {}", ErrnoStr());
+    abort();
+  }
+  stats_.polls++;
+  nevents_ = ret;
+}
+
+void Loop::Dispatch() {
+  for (cur_ = 0; cur_ < nevents_; cur_++) {
+    auto watcher = static_cast<Watcher*>(events_[cur_].data.ptr);
 
-    if (ev.events & EPOLLOUT) {
-      const auto& handler = fds_.at(ev.data.fd).second;
-      assert(handler);
-      handler();
+    // 出错或挂断时同时调用读写事件的处理函数，由其通过读写的结果处理错误
+    if (events_[cur_].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+      watcher->OnReadable();
+      stats_.events++;
+    }
+
+    // 读事件的处理函数可能已经移除了 fd，此时 Remove 会将事件清零
+    if (events_[cur_].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+      watcher->OnWritable();
+      stats_.events++;
     }
   }
+
+  cur_ = 0;
+  nevents_ = 0;
 }
 
 }  // namespace mydss::net
@@ -0,0 +1,114 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <err/errno.hpp>
+#include <net/sock_opts.hpp>
+
+using mydss::err::ErrnoStr;
+using mydss::err::Status;
+
+namespace mydss::net {
+
+static Status SetOpt(int fd, int level, int name, int value) {
+  int ret = setsockopt(fd, level, name, &value, sizeof(value));
+  if (ret == -1) {
+    return {errno, ErrnoStr()};
+  }
+  return Status::Ok();
+}
+
+Status ApplyListenOpts(int fd, InetType type, const SockOpts& opts) {
+  if (type == InetType::kUnix) {
+    return Status::Ok();
+  }
+
+  if (opts.defer_accept > 0) {
+    auto status = SetOpt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, opts.defer_accept);
+    if (status.error()) {
+      return status;
+    }
+  }
+  if (opts.fastopen > 0) {
+    auto status = SetOpt(fd, IPPROTO_TCP, TCP_FASTOPEN, opts.fastopen);
+    if (status.error()) {
+      return status;
+    }
+  }
+  if (opts.incoming_cpu >= 0) {
+    auto status = SetOpt(fd, SOL_SOCKET, SO_INCOMING_CPU, opts.incoming_cpu);
+    if (status.error()) {
+      return status;
+    }
+  }
+  return Status::Ok();
+}
+
+Status ApplyConnOpts(int fd, InetType type, const SockOpts& opts) {
+  Status status = Status::Ok();
+  if (opts.sndbuf > 0) {
+    status = SetOpt(fd, SOL_SOCKET, SO_SNDBUF, opts.sndbuf);
+    if (status.error()) {
+      return status;
+    }
+  }
+  if (opts.rcvbuf > 0) {
+    status = SetOpt(fd, SOL_SOCKET, SO_RCVBUF, opts.rcvbuf);
+    if (status.error()) {
+      return status;
+    }
+  }
+  if (type == InetType::kUnix) {
+    return Status::Ok();
+  }
+
+  if (opts.nodelay) {
+    status = SetOpt(fd, IPPROTO_TCP, TCP_NODELAY, 1);
+    if (status.error()) {
+      return status;
+    }
+  }
+  if (opts.keepalive > 0) {
+    status = SetOpt(fd, SOL_SOCKET, SO_KEEPALIVE, 1);
+    if (status.error()) {
+      return status;
+    }
+    status = SetOpt(fd, IPPROTO_TCP, TCP_KEEPIDLE, opts.keepalive);
+    if (status.error()) {
+      return status;
+    }
+    status = SetOpt(fd, IPPROTO_TCP, TCP_KEEPINTVL,
+                    std::max(opts.keepalive / 3, 1));
+    if (status.error()) {
+      return status;
+    }
+    status = SetOpt(fd, IPPROTO_TCP, TCP_KEEPCNT, 3);
+    if (status.error()) {
+      return status;
+    }
+  }
+  if (opts.busy_poll > 0) {
+    status = SetOpt(fd, SOL_SOCKET, SO_BUSY_POLL, opts.busy_poll);
+    if (status.error()) {
+      return status;
+    }
+  }
+  return Status::Ok();
+}
+
+}  // namespace mydss::net
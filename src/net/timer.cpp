@@ -0,0 +1,213 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cassert>
+#include <net/timer.hpp>
+
+namespace mydss::net {
+
+TimerWheel::TimerWheel(uint64_t now) : now_(now) {
+  for (auto& level : slots_) {
+    std::fill(std::begin(level), std::end(level), kNil);
+  }
+}
+
+TimerId TimerWheel::Add(uint64_t delay, uint64_t interval, Callback cb) {
+  uint32_t index;
+  if (free_.size() > 0) {
+    index = free_.back();
+    free_.pop_back();
+  } else {
+    index = nodes_.size();
+    nodes_.emplace_back();
+  }
+
+  auto& node = nodes_[index];
+  node.expire = now_ + delay;
+  node.interval = interval;
+  node.cb = std::move(cb);
+  node.state = State::kPending;
+  size_++;
+  Insert(index, now_ + 1);
+  return {index, node.gen};
+}
+
+void TimerWheel::Cancel(TimerId id) {
+  if (!id.valid() || id.index_ >= nodes_.size()) {
+    return;
+  }
+  auto& node = nodes_[id.index_];
+  if (node.gen != id.gen_) {
+    return;
+  }
+
+  if (node.state == State::kPending) {
+    Unlink(id.index_);
+    Free(id.index_);
+  } else if (node.state == State::kRunning) {
+    // 回调执行结束后由 Advance 释放
+    node.state = State::kCancelled;
+  }
+}
+
+size_t TimerWheel::Advance(uint64_t now) {
+  size_t n = 0;
+  while (now_ < now) {
+    if (size_ == 0) {
+      now_ = now;
+      break;
+    }
+    // 第 0 层没有定时器时，直接跳到下一次移动定时器之前
+    if (counts_[0] == 0) {
+      now_ = std::min(now, NextDeadline() - 1);
+      if (now_ == now) {
+        break;
+      }
+    }
+
+    now_++;
+    // 从高层到低层依次移动定时器，高层移动到低层当前槽的定时器可以被继续移动
+    for (int level = kLevels - 1; level > 0; level--) {
+      uint64_t mask = (uint64_t{1} << (kSlotBits * level)) - 1;
+      if ((now_ & mask) == 0) {
+        Cascade(level);
+      }
+    }
+
+    auto& head = slots_[0][now_ & (kSlots - 1)];
+    while (head != kNil) {
+      uint32_t index = head;
+      Unlink(index);
+
+      auto& node = nodes_[index];
+      node.state = State::kRunning;
+      node.cb();
+      n++;
+
+      // 回调可能添加了新的定时器，但 deque 不会移动已有的节点
+      if (node.state == State::kRunning && node.interval > 0) {
+        node.expire += node.interval;
+        node.state = State::kPending;
+        Insert(index, now_ + 1);
+      } else {
+        Free(index);
+      }
+    }
+  }
+  return n;
+}
+
+uint64_t TimerWheel::NextDeadline() const {
+  if (size_ == 0) {
+    return UINT64_MAX;
+  }
+
+  uint64_t deadline = UINT64_MAX;
+  if (counts_[0] > 0) {
+    for (uint64_t tick = now_ + 1; tick <= now_ + kSlots; tick++) {
+      if (slots_[0][tick & (kSlots - 1)] != kNil) {
+        deadline = tick;
+        break;
+      }
+    }
+  }
+
+  // 较高层中的定时器在移动到第 0 层之前无法确定准确的到期时间
+  for (int level = 1; level < kLevels; level++) {
+    if (counts_[level] > 0) {
+      int shift = kSlotBits * level;
+      uint64_t boundary = ((now_ >> shift) + 1) << shift;
+      deadline = std::min(deadline, boundary);
+      break;
+    }
+  }
+  return deadline;
+}
+
+void TimerWheel::Insert(uint32_t index, uint64_t min_tick) {
+  auto& node = nodes_[index];
+  // 已经过期的定时器在 min_tick 执行
+  uint64_t expire = std::max(node.expire, min_tick);
+
+  // 根据到期时间与当前时间最高的不同位所在的层选择层，
+  // 这样定时器所在的槽一定在该层的当前槽之后，并在到期的刻度前被移动到第 0 层
+  int level = 0;
+  while (level < kLevels - 1 &&
+         (expire >> (kSlotBits * (level + 1))) !=
+             (now_ >> (kSlotBits * (level + 1)))) {
+    level++;
+  }
+  uint32_t slot = (expire >> (kSlotBits * level)) & (kSlots - 1);
+  // 超出时间轮范围的定时器放在最高层的第 0 个槽，在时间轮转完一圈时被移动并重新计算位置
+  if ((expire >> (kSlotBits * kLevels)) != (now_ >> (kSlotBits * kLevels))) {
+    slot = 0;
+  }
+
+  auto& head = slots_[level][slot];
+  node.slot = static_cast<uint16_t>(level * kSlots + slot);
+  node.prev = kNil;
+  node.next = head;
+  if (head != kNil) {
+    nodes_[head].prev = index;
+  }
+  head = index;
+  counts_[level]++;
+}
+
+void TimerWheel::Unlink(uint32_t index) {
+  auto& node = nodes_[index];
+  int level = node.slot / kSlots;
+  uint32_t slot = node.slot % kSlots;
+
+  if (node.prev != kNil) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    slots_[level][slot] = node.next;
+  }
+  if (node.next != kNil) {
+    nodes_[node.next].prev = node.prev;
+  }
+  node.prev = kNil;
+  node.next = kNil;
+  counts_[level]--;
+}
+
+void TimerWheel::Cascade(int level) {
+  uint32_t slot = (now_ >> (kSlotBits * level)) & (kSlots - 1);
+  uint32_t index = slots_[level][slot];
+  slots_[level][slot] = kNil;
+  while (index != kNil) {
+    uint32_t next = nodes_[index].next;
+    counts_[level]--;
+    // 在当前刻度到期的定时器放入第 0 层的当前槽，随后在本刻度执行
+    Insert(index, now_);
+    index = next;
+  }
+}
+
+void TimerWheel::Free(uint32_t index) {
+  auto& node = nodes_[index];
+  // 释放回调持有的资源
+  node.cb = nullptr;
+  node.state = State::kFree;
+  node.gen++;
+  if (node.gen == 0) {
+    node.gen = 1;
+  }
+  free_.push_back(index);
+  size_--;
+}
+
+}  // namespace mydss::net
@@ -0,0 +1,344 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <err/code.hpp>
+#include <err/errno.hpp>
+#include <net/uring.hpp>
+
+using mydss::err::ErrnoStr;
+using mydss::err::kUnknown;
+using mydss::err::Status;
+using std::unique_ptr;
+
+namespace mydss::net {
+
+static int IoUringSetup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int IoUringEnter(int fd, unsigned to_submit, unsigned min_complete,
+                        unsigned flags, void* arg, size_t argsz) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                  min_complete, flags, arg, argsz));
+}
+
+static int IoUringRegister(int fd, unsigned opcode, void* arg,
+                           unsigned nr_args) {
+  return static_cast<int>(
+      syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// 多次接收请求需要 Linux 6.0 及以上版本
+static bool KernelAtLeast(int major, int minor) {
+  utsname name;
+  if (uname(&name) == -1) {
+    return false;
+  }
+  int cur_major = 0;
+  int cur_minor = 0;
+  if (sscanf(name.release, "%d.%d", &cur_major, &cur_minor) != 2) {
+    return false;
+  }
+  return cur_major > major || (cur_major == major && cur_minor >= minor);
+}
+
+Status Uring::New(unique_ptr<Uring>& result) {
+  if (!KernelAtLeast(6, 0)) {
+    return {kUnknown, "io_uring engine requires Linux 6.0 or later"};
+  }
+
+  auto uring = unique_ptr<Uring>(new Uring());
+  auto status = uring->Init();
+  if (status.error()) {
+    return status;
+  }
+  result = std::move(uring);
+  return Status::Ok();
+}
+
+Status Uring::Init() {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL |
+                 IORING_SETUP_COOP_TASKRUN;
+  params.cq_entries = kEntries * 4;
+  fd_ = IoUringSetup(kEntries, &params);
+  if (fd_ == -1) {
+    return {errno, ErrnoStr()};
+  }
+
+  constexpr unsigned kRequiredFeatures =
+      IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+  if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+    return {kUnknown, "io_uring lacks required features"};
+  }
+
+  // SQ 和 CQ 共享同一块映射的内存
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    sq_ring_ = nullptr;
+    return {errno, ErrnoStr()};
+  }
+  cq_ring_ = sq_ring_;
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  auto sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return {errno, ErrnoStr()};
+  }
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  auto sq = static_cast<char*>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sqe_tail_ = *sq_tail_;
+  // SQ 数组与 SQE 一一对应
+  auto sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  for (unsigned i = 0; i < sq_entries_; i++) {
+    sq_array[i] = i;
+  }
+
+  auto cq = static_cast<char*>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+  // 注册接收缓冲区环
+  size_t ring_size = kBufCount * sizeof(io_uring_buf);
+  auto ring = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    return {errno, ErrnoStr()};
+  }
+  buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+
+  io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+  reg.ring_entries = kBufCount;
+  reg.bgid = kBufGroup;
+  int ret = IoUringRegister(fd_, IORING_REGISTER_PBUF_RING, &reg, 1);
+  if (ret == -1) {
+    return {errno, ErrnoStr()};
+  }
+
+  bufs_ = new char[static_cast<size_t>(kBufCount) * kBufSize];
+  for (unsigned i = 0; i < kBufCount; i++) {
+    RecycleBuf(i);
+  }
+  return Status::Ok();
+}
+
+Uring::~Uring() {
+  delete[] bufs_;
+  if (buf_ring_ != nullptr) {
+    munmap(buf_ring_, kBufCount * sizeof(io_uring_buf));
+  }
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (sq_ring_ != nullptr) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+unsigned Uring::SqSpace() const {
+  unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  return sq_entries_ - (sqe_tail_ - head);
+}
+
+io_uring_sqe* Uring::GetSqe() {
+  if (SqSpace() == 0) {
+    auto status = Submit();
+    assert(status.ok());
+  }
+  assert(SqSpace() > 0);
+
+  auto sqe = &sqes_[sqe_tail_ & sq_mask_];
+  sqe_tail_++;
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+io_uring_sqe* Uring::PrepAcceptMultishot(int fd, Op* op) {
+  auto sqe = GetSqe();
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->user_data = reinterpret_cast<uint64_t>(op);
+  return sqe;
+}
+
+io_uring_sqe* Uring::PrepRecvMultishot(int fd, Op* op) {
+  auto sqe = GetSqe();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufGroup;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->user_data = reinterpret_cast<uint64_t>(op);
+  return sqe;
+}
+
+io_uring_sqe* Uring::PrepSendMsg(int fd, const msghdr* msg, Op* op) {
+  auto sqe = GetSqe();
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(msg);
+  sqe->len = 1;
+  // 对于流式套接字，MSG_WAITALL 使内核在发送不完整时继续发送剩余部分
+  sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+  sqe->user_data = reinterpret_cast<uint64_t>(op);
+  return sqe;
+}
+
+io_uring_sqe* Uring::PrepPollMultishot(int fd, Op* op) {
+  auto sqe = GetSqe();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = reinterpret_cast<uint64_t>(op);
+  return sqe;
+}
+
+io_uring_sqe* Uring::PrepCancelFd(int fd) {
+  auto sqe = GetSqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = fd;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  return sqe;
+}
+
+io_uring_sqe* Uring::PrepCancel(Op* op) {
+  auto sqe = GetSqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = reinterpret_cast<uint64_t>(op);
+  return sqe;
+}
+
+io_uring_sqe* Uring::PrepClose(int fd) {
+  auto sqe = GetSqe();
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->fd = fd;
+  return sqe;
+}
+
+Status Uring::Submit() { return Enter(0, 0); }
+
+Status Uring::SubmitAndWait(int timeout) { return Enter(1, timeout); }
+
+Status Uring::Enter(unsigned min_complete, int timeout) {
+  // 发布准备好的 SQE
+  __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+  unsigned to_submit = sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (to_submit == 0 && min_complete == 0) {
+    return Status::Ok();
+  }
+
+  unsigned flags = 0;
+  void* arg = nullptr;
+  size_t argsz = 0;
+  io_uring_getevents_arg getevents_arg;
+  __kernel_timespec ts;
+  if (min_complete > 0) {
+    flags |= IORING_ENTER_GETEVENTS;
+    if (timeout >= 0) {
+      ts.tv_sec = timeout / 1000;
+      ts.tv_nsec = static_cast<long long>(timeout % 1000) * 1000000;
+      memset(&getevents_arg, 0, sizeof(getevents_arg));
+      getevents_arg.sigmask_sz = _NSIG / 8;
+      getevents_arg.ts = reinterpret_cast<uint64_t>(&ts);
+      flags |= IORING_ENTER_EXT_ARG;
+      arg = &getevents_arg;
+      argsz = sizeof(getevents_arg);
+    }
+  }
+
+  int ret = IoUringEnter(fd_, to_submit, min_complete, flags, arg, argsz);
+  if (ret == -1) {
+    // 被信号中断、超时或 CQ 溢出时由调用者处理完成事件后重试
+    if (errno == EINTR || errno == ETIME || errno == EBUSY ||
+        errno == EAGAIN) {
+      return Status::Ok();
+    }
+    return {errno, ErrnoStr()};
+  }
+  return Status::Ok();
+}
+
+size_t Uring::Reap() {
+  size_t n = 0;
+  unsigned head = *cq_head_;
+  for (;;) {
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      break;
+    }
+
+    const auto& cqe = cqes_[head & cq_mask_];
+    auto op = reinterpret_cast<Op*>(cqe.user_data);
+    int res = cqe.res;
+    uint32_t flags = cqe.flags;
+    head++;
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    n++;
+
+    // 取消和关闭请求没有处理者
+    if (op != nullptr) {
+      op->OnComplete(res, flags);
+    }
+  }
+  return n;
+}
+
+void Uring::RecycleBuf(uint16_t bid) {
+  // C++ 中 __DECLARE_FLEX_ARRAY 展开后的空结构体会占用空间，导致 bufs 的偏移
+  // 与内核不一致，因此直接将缓冲区环的起始地址作为 io_uring_buf 数组
+  auto bufs = reinterpret_cast<io_uring_buf*>(buf_ring_);
+  auto& buf = bufs[buf_tail_ & (kBufCount - 1)];
+  buf.addr = reinterpret_cast<uint64_t>(Buf(bid));
+  buf.len = kBufSize;
+  buf.bid = bid;
+  buf_tail_++;
+  __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+}
+
+}  // namespace mydss::net
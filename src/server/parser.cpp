@@ -12,200 +12,367 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cstring>
 #include <limit.hpp>
 #include <server/parser.hpp>
+#include <util/scan.hpp>
 
 using fmt::format;
 using mydss::err::kBadReq;
 using mydss::err::Status;
-using std::isdigit;
-using std::string;
+using mydss::util::FindCrlf;
+using mydss::util::ParseDec;
+using mydss::util::Slice;
+using std::string_view;
 using std::vector;
 
 namespace mydss::server {
 
-void BulkStringParser::Reset() {
-  state_ = State::kTypeChar;
-  value_.clear();
-  target_len_ = 0;
-  cur_len_ = 0;
-}
+// 十进制数字的最大位数，更长的数字可能超出 uint64_t 的范围
+constexpr size_t kMaxDigits = 19;
 
-Status BulkStringParser::Step(char ch, bool* completed) {
-  *completed = false;
+// 解析 [line, line + len) 中 "<type><长度>" 形式的头部，line 不包括结尾的 "\r\n"
+static Status ParseLen(const char* line, size_t len, char type,
+                       const char* name, uint64_t max, uint64_t& result) {
+  if (line[0] != type) {
+    return Status(kBadReq, format("expect {} type char '{}' instead of '{}'",
+                                  name, type, line[0]));
+  }
+  size_t ndigits = len - 1;
+  if (ndigits == 0) {
+    return Status(kBadReq, format("expect {} length before '\r\n'", name));
+  }
+  if (ndigits <= kMaxDigits && ParseDec(line + 1, ndigits, result)) {
+    if (result > max) {
+      return Status(kBadReq, format("{} is too long", name));
+    }
+    return Status::Ok();
+  }
 
-  switch (state_) {
-    case State::kTypeChar:
-      if (ch == '$') {
-        state_ = State::kLenFirstNum;
-        return Status::Ok();
-      }
+  // 存在非数字字符或者数字过长，逐个检查以给出准确的错误信息
+  for (size_t i = 1; i < len; i++) {
+    char ch = line[i];
+    if (ch < '0' || ch > '9') {
       return Status(
           kBadReq,
-          format("expect bulk string type char '$' instead of '{}'", ch));
+          format("expect '\r\n' after length of the {} instead of '{}'", name,
+                 ch));
+    }
+  }
+  return Status(kBadReq, format("{} is too long", name));
+}
 
-    case State::kLenFirstNum:
-      if (isdigit(ch)) {
-        state_ = State::kLen;
-        target_len_ = ch - '0';
-        return Status::Ok();
-      }
-      return Status(kBadReq,
-                    format("expect bulk string length instead of '{}'", ch));
+Status ReqParser::ReadHeader(const char*& p, const char* end, char type,
+                             const char* name, uint64_t max, bool& completed,
+                             uint64_t& len) {
+  completed = false;
+  // 尽早拒绝类型不正确的数据，而不是等到读取完一整行
+  if (header_.empty() && *p != type) {
+    return Status(kBadReq, format("expect {} type char '{}' instead of '{}'",
+                                  name, type, *p));
+  }
 
-    case State::kLen:
-      if (isdigit(ch)) {
-        target_len_ *= 10;
-        target_len_ += ch - '0';
-        if (target_len_ > kMaxStrLenInReq) {
-          return Status(kBadReq, "bulk string is too long");
-        }
-        return Status::Ok();
-      }
-      if (ch == '\r') {
-        state_ = State::kLenN;
-        return Status::Ok();
-      }
-      return Status(
-          kBadReq,
-          format("expect '\r' after length of the bulk string instead of '{}'",
-                 ch));
+  // 上一段数据以 '\r' 结尾，本段数据以 '\n' 开头
+  if (!header_.empty() && header_.back() == '\r' && *p == '\n') {
+    header_.pop_back();
+    auto status =
+        ParseLen(header_.data(), header_.size(), type, name, max, len);
+    header_.clear();
+    p++;
+    completed = status.ok();
+    return status;
+  }
 
-    case State::kLenN:
-      if (ch != '\n') {
-        return Status(kBadReq, format("expect '\n' after bulk string "
-                                      "length and '\r' instead of '{}'",
-                                      ch));
-      }
+  // 最多在 kMaxHeaderLen 字节内寻找行尾，防止一直缓存没有行尾的数据
+  size_t limit = std::min<size_t>(end - p, kMaxHeaderLen - header_.size());
+  auto crlf = FindCrlf(p, p + limit);
+  if (crlf == nullptr) {
+    if (header_.size() + limit == kMaxHeaderLen) {
+      return Status(kBadReq, format("{} header is too long", name));
+    }
+    header_.append(p, end);
+    p = end;
+    return Status::Ok();
+  }
 
-      if (target_len_ == 0) {
-        state_ = State::kR;
-        return Status::Ok();
-      }
+  Status status = Status::Ok();
+  if (header_.empty()) {
+    status = ParseLen(p, crlf - p, type, name, max, len);
+  } else {
+    header_.append(p, crlf);
+    status = ParseLen(header_.data(), header_.size(), type, name, max, len);
+    header_.clear();
+  }
+  p = crlf + 2;
+  completed = status.ok();
+  return status;
+}
 
-      state_ = State::kData;
-      // 预分配内存
-      value_.reserve(target_len_);
-      return Status::Ok();
+static bool IsBlank(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '\v' ||
+         ch == '\f';
+}
 
-    case State::kData:
-      value_.push_back(ch);
-      cur_len_++;
-      if (cur_len_ == target_len_) {
-        state_ = State::kR;
-      }
-      return Status::Ok();
+// 十六进制数字的值，ch 不是十六进制数字时返回 -1
+static int HexValue(char ch) {
+  if (ch >= '0' && ch <= '9') {
+    return ch - '0';
+  }
+  if (ch >= 'a' && ch <= 'f') {
+    return ch - 'a' + 10;
+  }
+  if (ch >= 'A' && ch <= 'F') {
+    return ch - 'A' + 10;
+  }
+  return -1;
+}
 
-    case State::kR:
-      if (ch == '\r') {
-        state_ = State::kN;
-        return Status::Ok();
+Status ReqParser::SplitInline(string_view line, const Slice& buf) {
+  // 不包含引号时参数就是以空白分隔的各段，直接指向 buf
+  if (line.find_first_of("\"'") == string_view::npos) {
+    size_t i = 0;
+    while (i < line.size()) {
+      while (i < line.size() && IsBlank(line[i])) {
+        i++;
+      }
+      size_t start = i;
+      while (i < line.size() && !IsBlank(line[i])) {
+        i++;
       }
-      return Status(kBadReq, format("expect '\r' after bulk string "
-                                    "value instead of '{}'",
-                                    ch));
-    case State::kN:
-      if (ch == '\n') {
-        *completed = true;
-        return Status::Ok();
+      if (i > start) {
+        req_.Add(line.substr(start, i - start), buf);
       }
-      return Status(kBadReq, format("expect '\n' after bulk string "
-                                    "value and '\r' instead of '{}'",
-                                    ch));
+    }
+    return Status::Ok();
   }
-  return Status::Ok();
-}
 
-Status ReqParser::Parse(const char* buf, size_t len,
-                        vector<vector<string>>& reqs) {
-  for (size_t i = 0; i < len; i++) {
-    bool completed = false;
-    Status status = Step(buf[i], &completed);
-    if (status.error()) {
-      return status;
+  // 去掉引号和转义后参数的总长度不会超过 line 的长度
+  Slice args(line.size());
+  char* out = args.data();
+  const Status unbalanced(kBadReq, "unbalanced quotes in inline request");
+  size_t i = 0;
+  for (;;) {
+    while (i < line.size() && IsBlank(line[i])) {
+      i++;
+    }
+    if (i == line.size()) {
+      break;
     }
 
-    if (completed) {
-      reqs.push_back(std::move(req_));
-      Reset();
+    char* arg = out;
+    bool in_double = false;  // 是否在双引号中
+    bool in_single = false;  // 是否在单引号中
+    for (bool done = false; !done;) {
+      if (!in_double && !in_single) {
+        if (i == line.size() || IsBlank(line[i])) {
+          break;
+        }
+        char ch = line[i++];
+        if (ch == '"') {
+          in_double = true;
+        } else if (ch == '\'') {
+          in_single = true;
+        } else {
+          *out++ = ch;
+        }
+        continue;
+      }
+
+      if (i == line.size()) {
+        return unbalanced;
+      }
+      char ch = line[i];
+      char quote = in_double ? '"' : '\'';
+      if (ch == quote) {
+        // 结束的引号之后必须是空白或者行尾
+        if (i + 1 < line.size() && !IsBlank(line[i + 1])) {
+          return unbalanced;
+        }
+        i++;
+        done = true;
+      } else if (ch == '\\' && i + 1 < line.size() && in_single) {
+        // 单引号中只有 "\'" 是转义
+        if (line[i + 1] == '\'') {
+          *out++ = '\'';
+          i += 2;
+        } else {
+          *out++ = ch;
+          i++;
+        }
+      } else if (ch == '\\' && i + 1 < line.size()) {
+        char next = line[i + 1];
+        if (next == 'x' && i + 3 < line.size() && HexValue(line[i + 2]) >= 0 &&
+            HexValue(line[i + 3]) >= 0) {
+          *out++ = static_cast<char>(HexValue(line[i + 2]) * 16 +
+                                     HexValue(line[i + 3]));
+          i += 4;
+          continue;
+        }
+        switch (next) {
+          case 'n':
+            *out++ = '\n';
+            break;
+          case 'r':
+            *out++ = '\r';
+            break;
+          case 't':
+            *out++ = '\t';
+            break;
+          case 'b':
+            *out++ = '\b';
+            break;
+          case 'a':
+            *out++ = '\a';
+            break;
+          default:
+            *out++ = next;
+            break;
+        }
+        i += 2;
+      } else {
+        *out++ = ch;
+        i++;
+      }
     }
+    req_.Add(string_view(arg, out - arg), args);
   }
   return Status::Ok();
 }
 
-void ReqParser::Reset() {
-  state_ = State::kArrayChar;
-  req_.clear();
-  array_len_ = 0;
-  str_parser_.Reset();
-}
+Status ReqParser::Parse(const Slice& buf, vector<module::Req>& reqs) {
+  const char* p = buf.data();
+  const char* end = p + buf.size();
+  while (p < end) {
+    switch (state_) {
+      case State::kArrayHeader: {
+        if (header_.empty() && *p != '*') {
+          state_ = State::kInline;
+          break;
+        }
+        bool completed;
+        uint64_t n;
+        auto status =
+            ReadHeader(p, end, '*', "array", kMaxStrInReq, completed, n);
+        if (status.error()) {
+          return status;
+        }
+        // 空数组不是一个请求，直接忽略
+        if (completed && n > 0) {
+          array_len_ = n;
+          req_.reserve(n);
+          state_ = State::kBulkHeader;
+        }
+        break;
+      }
 
-Status ReqParser::Step(char ch, bool* completed) {
-  *completed = false;
+      case State::kInline: {
+        auto nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (nl == nullptr) {
+          // 允许行尾的 '\r' 位于下一段数据之前
+          if (inline_.size() + (end - p) > kMaxInlineLen + 1) {
+            return Status(kBadReq, "inline request is too long");
+          }
+          inline_.append(p, end);
+          p = end;
+          break;
+        }
 
-  switch (state_) {
-    case State::kArrayChar:
-      if (ch == '*') {
-        state_ = State::kArrayLenFirstNum;
-        return Status::Ok();
-      }
-      return Status(kBadReq,
-                    format("expect array type char '*' instead of '{}'", ch));
-
-    case State::kArrayLenFirstNum:
-      if (isdigit(ch)) {
-        state_ = State::kArrayLen;
-        array_len_ = ch - '0';
-        return Status::Ok();
+        string_view line(p, nl - p);
+        const Slice* line_buf = &buf;
+        Slice joined;
+        if (!inline_.empty()) {
+          inline_.append(p, nl);
+          joined = Slice(inline_.size());
+          memcpy(joined.data(), inline_.data(), inline_.size());
+          line = string_view(joined.data(), joined.size());
+          line_buf = &joined;
+          inline_.clear();
+        }
+        if (!line.empty() && line.back() == '\r') {
+          line.remove_suffix(1);
+        }
+        if (line.size() > kMaxInlineLen) {
+          return Status(kBadReq, "inline request is too long");
+        }
+        auto status = SplitInline(line, *line_buf);
+        if (status.error()) {
+          return status;
+        }
+        p = nl + 1;
+        // 空行不是一个请求，直接忽略
+        if (!req_.empty()) {
+          reqs.push_back(std::move(req_));
+          req_.clear();
+        }
+        state_ = State::kArrayHeader;
+        break;
       }
-      return Status(kBadReq, format("expect array length instead of '{}'", ch));
 
-    case State::kArrayLen:
-      if (isdigit(ch)) {
-        array_len_ *= 10;
-        array_len_ += ch - '0';
-        if (array_len_ > kMaxStrInReq) {
-          return Status(kBadReq, "array is too long");
+      case State::kBulkHeader: {
+        bool completed;
+        auto status = ReadHeader(p, end, '$', "bulk string", kMaxStrLenInReq,
+                                 completed, bulk_len_);
+        if (status.error()) {
+          return status;
         }
-        return Status::Ok();
-      }
-      if (ch == '\r') {
-        state_ = State::kArrayN;
-        return Status::Ok();
-      }
-      return Status(
-          kBadReq,
-          format("expect '\r' after length of the array instead of '{}'", ch));
-
-    case State::kArrayN:
-      if (ch == '\n') {
-        state_ = State::kStr;
-        // 预分配内存
-        req_.reserve(array_len_);
-        return Status::Ok();
-      }
-      return Status(kBadReq, format("expect '\n' after array "
-                                    "length and '\r' instead of '{}'",
-                                    ch));
-
-    case State::kStr:
-      bool bs_completed = false;
-      Status status = str_parser_.Step(ch, &bs_completed);
-      if (status.error()) {
-        return status;
+        if (!completed) {
+          break;
+        }
+        // 数据部分完整地位于本段数据中时直接引用，否则复制到 bulk_ 中
+        if (static_cast<uint64_t>(end - p) >= bulk_len_) {
+          req_.Add(string_view(p, bulk_len_), buf);
+          p += bulk_len_;
+          end_len_ = 0;
+          state_ = State::kBulkEnd;
+        } else {
+          bulk_ = Slice(bulk_len_);
+          bulk_recvd_ = 0;
+          state_ = State::kBulkData;
+        }
+        break;
       }
 
-      if (!bs_completed) {
-        return Status::Ok();
+      case State::kBulkData: {
+        size_t n = std::min<uint64_t>(end - p, bulk_len_ - bulk_recvd_);
+        memcpy(bulk_.data() + bulk_recvd_, p, n);
+        bulk_recvd_ += n;
+        p += n;
+        if (bulk_recvd_ == bulk_len_) {
+          req_.Add(string_view(bulk_.data(), bulk_len_), bulk_);
+          bulk_ = Slice();
+          end_len_ = 0;
+          state_ = State::kBulkEnd;
+        }
+        break;
       }
 
-      req_.push_back(str_parser_.MoveOut());
-      str_parser_.Reset();
-      if (req_.size() == array_len_) {
-        *completed = true;
-      }
-      return Status::Ok();
+      case State::kBulkEnd:
+        // 结尾的 "\r\n" 可能跨越两段数据
+        for (; p < end && end_len_ < 2; p++, end_len_++) {
+          if (*p != "\r\n"[end_len_]) {
+            return Status(kBadReq,
+                          format("expect '\r\n' after bulk string value "
+                                 "instead of '{}'",
+                                 *p));
+          }
+        }
+        if (end_len_ < 2) {
+          break;
+        }
+        if (req_.size() < array_len_) {
+          state_ = State::kBulkHeader;
+          break;
+        }
+        reqs.push_back(std::move(req_));
+        req_.clear();
+        state_ = State::kArrayHeader;
+        break;
+    }
   }
+
+  // 不完整的请求不能持有本段数据，否则空闲的会话会一直持有接收缓冲区
+  req_.Detach(buf);
   return Status::Ok();
 }
 
@@ -18,34 +18,73 @@
 #include <err/errno.hpp>
 #include <server/server.hpp>
 #include <server/session.hpp>
+#include <server/upgrade.hpp>
 
 using mydss::err::Status;
+using mydss::module::ErrorPiece;
+using mydss::module::Proto;
 using mydss::net::Acceptor;
 using mydss::net::Conn;
 using mydss::net::EndPoint;
+using mydss::util::Slice;
 using std::shared_ptr;
 
 namespace mydss::server {
 
 Status Server::Start() {
   EndPoint ep(config_.type(), config_.ip(), config_.port());
-  acceptor_ = Acceptor::New(loop_, std::move(ep));
-  auto status = acceptor_->Start(config_.backlog());
+  if (config_.type() == net::InetType::kUnix) {
+    ep = EndPoint(config_.type(), config_.path(), 0);
+  }
+  acceptor_ = Acceptor::New(loop_, std::move(ep), config_.sock_opts());
+  auto status = Status::Ok();
+  int fd = Upgrade::TakeListener(Upgrade::Key(config_));
+  if (fd != -1) {
+    status = acceptor_->Inherit(fd);
+  } else {
+    status = acceptor_->Start(config_.backlog(), config_.reuse_port(),
+                              config_.perm());
+  }
   if (status.error()) {
     return status;
   }
+  Upgrade::Register(loop_, shared_from_this());
 
-  auto conn = Conn::New();
-  acceptor_->AsyncAccept(conn,
-                         bind(&Server::OnAccept, shared_from_this(), conn));
+  // 预先分配连接对象，使启动后涌入的连接不需要逐个分配内存
+  Conn::Reserve(kPreallocConns);
+  Session::Reserve(kPreallocConns);
+  Session::StartIdleSweep(loop_, client_.timeout());
+
+  acceptor_->Serve([server = shared_from_this()](shared_ptr<Conn> conn) {
+    OnAccept(server, std::move(conn));
+  });
   return Status::Ok();
 }
 
 void Server::OnAccept(shared_ptr<Server> server, shared_ptr<Conn> conn) {
-  auto session = Session::New(conn);
-  auto new_conn = Conn::New();
-  server->acceptor_->AsyncAccept(new_conn,
-                                 bind(&Server::OnAccept, server, new_conn));
+  // 会话数目由所有线程共享，并发接受的连接可能使其略微超出上限
+  auto max_clients = server->client_.max_clients();
+  if (max_clients > 0 && Session::live() >= max_clients) {
+    Reject(std::move(conn));
+    return;
+  }
+
+  conn->set_zerocopy_threshold(server->config_.zerocopy_threshold());
+  auto session = Session::New(conn, server->config_.output_limit());
+}
+
+void Server::Reject(shared_ptr<Conn> conn) {
+  SPDLOG_DEBUG("reject connection, max number of clients reached");
+  ErrorPiece piece("ERR max number of clients reached");
+  // 连接尚未协商协议版本
+  auto slice = Slice(piece.Size(Proto::kResp2));
+  piece.Serialize(slice.data(), slice.size(), Proto::kResp2);
+  conn->AsyncSend(slice, [conn](Status status) {
+    if (status.error()) {
+      SPDLOG_DEBUG("send rejection failed: {}", status.ToString());
+    }
+    conn->Close();
+  });
 }
 
 }  // namespace mydss::server
@@ -14,6 +14,8 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cstring>
 #include <db/inst.hpp>
 #include <err/errno.hpp>
 #include <server/session.hpp>
@@ -22,11 +24,15 @@ using mydss::db::Inst;
 using mydss::err::ErrnoStr;
 using mydss::err::kEof;
 using mydss::err::Status;
+using mydss::module::BulkStringPiece;
 using mydss::module::Ctx;
 using mydss::module::ErrorPiece;
 using mydss::module::Piece;
+using mydss::module::Proto;
+using mydss::module::SimpleStringPiece;
 using mydss::net::Conn;
 using mydss::util::Slice;
+using std::dynamic_pointer_cast;
 using std::make_shared;
 using std::shared_ptr;
 using std::string;
@@ -37,23 +43,290 @@ using std::placeholders::_2;
 
 namespace mydss::server {
 
-static constexpr size_t kRecvBufSize = 2048;
+// 接收缓冲区的最小和最大大小
+static constexpr size_t kMinRecvBufSize = 4 * 1024;
+static constexpr size_t kMaxRecvBufSize = 512 * 1024;
+// 每接收该次数检查一次是否需要缩小接收缓冲区
+static constexpr int kRecvShrinkInterval = 32;
 
-uint64_t Session::next_id_ = 1;
-unordered_map<uint64_t, shared_ptr<Session>> Session::map_;
+// 输出缓冲区达到该大小时暂停处理和接收客户端的请求，减少到一半以下时恢复，
+// 使不读取回复的客户端无法让服务器无限地缓存回复
+static constexpr size_t kPauseOutputBytes = 256 * 1024;
 
-Session::Session(shared_ptr<Conn> conn) : conn_(conn), id_(next_id_) {
-  next_id_++;
+// 每个线程的对象池中最多保留的空闲 Session 对象的数目
+static constexpr size_t kMaxFreeSessions = 1024;
+
+// 是否为不带参数的 PING，负载均衡器的健康检查频繁发送这样的请求
+// 它不访问数据库，因此由会话直接回复，不必经过 Inst 的锁和命令表，
+// 在 executor_ 模式下也不必交给 executor_ 执行
+static bool IsPing(const module::Req& req) {
+  if (req.size() != 1 || req[0].size() != 4) {
+    return false;
+  }
+  auto name = req[0];
+  return (name[0] | 0x20) == 'p' && (name[1] | 0x20) == 'i' &&
+         (name[2] | 0x20) == 'n' && (name[3] | 0x20) == 'g';
+}
+
+// 所有会话共享 PING 的回复，序列化不修改 Piece，因此可以在多个线程中同时发送
+static const shared_ptr<Piece>& Pong() {
+  static const shared_ptr<Piece> pong = make_shared<SimpleStringPiece>("PONG");
+  return pong;
+}
+
+static util::Pool<Session>& SessionPool() {
+  static thread_local auto pool = util::Pool<Session>::New(kMaxFreeSessions);
+  return *pool;
+}
+
+std::atomic<uint64_t> Session::next_id_ = 1;
+std::atomic<size_t> Session::live_ = 0;
+thread_local unordered_map<uint64_t, shared_ptr<Session>> Session::map_;
+thread_local Session::IdleWheel Session::idle_;
+std::shared_ptr<net::Loop> Session::executor_;
+
+Session::Session(shared_ptr<Conn> conn, const OutputLimit& limit)
+    : conn_(conn),
+      id_(next_id_++),
+      recv_size_(kMinRecvBufSize),
+      limit_(limit) {}
+
+shared_ptr<Session> Session::New(shared_ptr<Conn> conn,
+                                 const OutputLimit& limit) {
+  auto session = SessionPool().Make(std::move(conn), limit);
+  session->Start();
+  return session;
 }
 
+void Session::Reserve(size_t n) { SessionPool().Reserve(n); }
+
 void Session::Start() {
   map_[id_] = shared_from_this();
-  auto slice = Slice(kRecvBufSize);
-  conn_->AsyncRecv(slice,
-                   bind(&Session::OnRecv, shared_from_this(), slice, _1, _2));
+  live_++;
+  if (idle_.timeout > 0) {
+    active_tick_ = idle_.tick;
+    WatchIdle();
+  }
+  Recv();
+}
+
+void Session::StartIdleSweep(std::shared_ptr<net::Loop> loop,
+                             uint64_t timeout) {
+  if (timeout == 0 || idle_.loop == loop.get()) {
+    return;
+  }
+  idle_ = {};
+  idle_.loop = loop.get();
+  idle_.timeout = timeout;
+  // 会话最晚在 timeout + 1 秒后到期，槽的数目需要覆盖这段时间
+  idle_.slots.resize(timeout + 2);
+  loop->RunEvery(1000, &Session::SweepIdle);
+}
+
+void Session::WatchIdle() {
+  // 本秒内的活动可能发生在 active_tick_ 的末尾，因此多等待一秒，
+  // 保证空闲时间不少于 timeout 秒
+  uint64_t deadline = active_tick_ + idle_.timeout + 1;
+  idle_.slots[deadline % idle_.slots.size()].push_back(weak_from_this());
+}
+
+void Session::SweepIdle() {
+  auto& wheel = idle_;
+  wheel.tick++;
+  wheel.due.swap(wheel.slots[wheel.tick % wheel.slots.size()]);
+  for (auto& weak : wheel.due) {
+    auto session = weak.lock();
+    if (session == nullptr || session->conn_->closed()) {
+      continue;
+    }
+    if (session->active_tick_ + wheel.timeout + 1 <= wheel.tick) {
+      SPDLOG_DEBUG("close session {}, idle for {}s", session->id_,
+                   wheel.timeout);
+      session->Close();
+      continue;
+    }
+    session->WatchIdle();
+  }
+  wheel.due.clear();
+}
+
+void Session::Close() {
+  // map_ 可能持有会话的最后一个引用
+  auto self = shared_from_this();
+  if (!conn_->closed()) {
+    conn_->loop()->Cancel(soft_timer_);
+    conn_->Close();
+  }
+  if (map_.erase(id_) > 0) {
+    live_--;
+  }
+}
+
+void Session::Recv() {
+  conn_->AsyncRecv(recv_size_,
+                   bind(&Session::OnRecv, shared_from_this(), _1, _2));
+}
+
+void Session::Process() {
+  if (executor_ != nullptr) {
+    Execute();
+    return;
+  }
+
+  while (next_req_ < reqs_.size()) {
+    if (conn_->unsent_bytes() >= kPauseOutputBytes) {
+      paused_ = true;
+      return;
+    }
+    const auto& req = reqs_[next_req_++];
+    if (IsPing(req)) {
+      Send(Pong());
+    } else {
+      Ctx ctx(this);
+      Inst::GetInst()->Handle(ctx, req);
+    }
+    if (conn_->closed()) {
+      return;
+    }
+  }
+  // 释放请求数组的内存，使等待请求的会话不持有堆内存
+  std::vector<module::Req>().swap(reqs_);
+  next_req_ = 0;
+  Recv();
+}
+
+void Session::Execute() {
+  // 开头的 PING 在会话所在的线程中直接回复
+  while (next_req_ < reqs_.size() && IsPing(reqs_[next_req_])) {
+    if (conn_->unsent_bytes() >= kPauseOutputBytes) {
+      paused_ = true;
+      return;
+    }
+    next_req_++;
+    Send(Pong());
+    if (conn_->closed()) {
+      return;
+    }
+  }
+
+  if (next_req_ == reqs_.size()) {
+    std::vector<module::Req>().swap(reqs_);
+    next_req_ = 0;
+    Recv();
+    return;
+  }
+  if (conn_->unsent_bytes() >= kPauseOutputBytes) {
+    paused_ = true;
+    return;
+  }
+
+  // 每个会话同一时刻最多有一批请求在执行，执行完成前不再接收数据
+  std::vector<module::Req> reqs;
+  reqs.swap(reqs_);
+  reqs.erase(reqs.begin(), reqs.begin() + next_req_);
+  next_req_ = 0;
+  executor_->Post([self = shared_from_this(), loop = conn_->loop(),
+                   reqs = std::move(reqs)]() mutable {
+    Ctx::Replies replies;
+    Ctx ctx(self.get(), &replies);
+    for (const auto& req : reqs) {
+      Inst::GetInst()->Handle(ctx, req);
+      if (ctx.closing()) {
+        break;
+      }
+    }
+    // 会话的内存来自其所在线程的对象池，请求引用的接收缓冲区来自其所在线程的
+    // 缓冲区池，即使连接已经关闭，它们也必须交回会话所在的线程释放
+    loop->Post([self = std::move(self), replies = std::move(replies),
+                reqs = std::move(reqs)]() mutable {
+      reqs.clear();
+      self->OnExecuted(std::move(replies));
+    });
+  });
+}
+
+void Session::OnExecuted(Ctx::Replies replies) {
+  if (conn_->closed()) {
+    return;
+  }
+  for (auto& [piece, proto] : replies) {
+    Send(piece, proto, piece == nullptr);
+    if (piece == nullptr || conn_->closed()) {
+      return;
+    }
+  }
+  Recv();
+}
+
+bool Session::CheckOutputLimit() {
+  size_t bytes = conn_->unsent_bytes();
+  if (limit_.hard > 0 && bytes > limit_.hard) {
+    SPDLOG_WARN("close session {}, output buffer {} exceeds hard limit {}",
+                id_, bytes, limit_.hard);
+    Close();
+    return false;
+  }
+
+  if (limit_.soft == 0 || bytes <= limit_.soft) {
+    soft_since_ = 0;
+    conn_->loop()->Cancel(soft_timer_);
+    soft_timer_ = {};
+    return true;
+  }
+  auto now = net::Loop::Now();
+  if (soft_since_ == 0) {
+    soft_since_ = now;
+  }
+  uint64_t window = limit_.soft_seconds * 1000;
+  if (now - soft_since_ >= window) {
+    SPDLOG_WARN("close session {}, output buffer {} exceeds soft limit {} "
+                "for {}s",
+                id_, bytes, limit_.soft, limit_.soft_seconds);
+    Close();
+    return false;
+  }
+
+  // 客户端不再读取时输出缓冲区不会变化，需要在到期时主动检查
+  if (!soft_timer_.valid()) {
+    std::weak_ptr<Session> weak = shared_from_this();
+    soft_timer_ = conn_->loop()->RunAfter(window - (now - soft_since_), [weak] {
+      auto session = weak.lock();
+      if (session != nullptr && !session->conn_->closed()) {
+        session->soft_timer_ = {};
+        session->CheckOutputLimit();
+      }
+    });
+  }
+  return true;
+}
+
+void Session::ResizeRecvBuf(size_t nbytes) {
+  size_t size = recv_size_;
+  // 缓冲区被填满说明套接字中可能还有更多数据，扩大缓冲区以减少读取次数
+  if (nbytes == size && size < kMaxRecvBufSize) {
+    recv_size_ = size * 2;
+    recv_peak_ = 0;
+    recv_count_ = 0;
+    return;
+  }
+
+  recv_peak_ = std::max(recv_peak_, nbytes);
+  if (++recv_count_ < kRecvShrinkInterval) {
+    return;
+  }
+  // 最近的接收都不足缓冲区的四分之一时缩小缓冲区
+  if (recv_peak_ <= size / 4 && size > kMinRecvBufSize) {
+    recv_size_ = size / 2;
+  }
+  recv_peak_ = 0;
+  recv_count_ = 0;
 }
 
 void Session::Send(shared_ptr<Piece> piece, bool close) {
+  Send(std::move(piece), client_.proto(), close);
+}
+
+void Session::Send(shared_ptr<Piece> piece, Proto proto, bool close) {
   if (piece == nullptr) {
     Slice slice;
     conn_->AsyncSend(
@@ -61,60 +334,108 @@ void Session::Send(shared_ptr<Piece> piece, bool close) {
     return;
   }
 
-  size_t size = piece->Size();
-  auto slice = Slice(size);
+  // 连接使用零拷贝发送时，较大的 bulk string 的值不再复制到新的缓冲区，
+  // 而是由 Conn 直接发送；否则分段发送只会增加 iovec 和引用计数的开销
+  auto bulk = conn_->zerocopy() ? dynamic_pointer_cast<BulkStringPiece>(piece)
+                                : nullptr;
+  if (bulk != nullptr && bulk->value().size() >= conn_->zerocopy_threshold()) {
+    SendBulk(bulk, close);
+  } else {
+    size_t size = piece->Size(proto);
+    // 在 RESP2 中不回复任何数据的 Piece，例如属性
+    if (size == 0) {
+      if (close) {
+        Send(nullptr, proto, true);
+      }
+      return;
+    }
+    auto slice = Slice(size);
 
-  size_t nbytes = piece->Serialize(slice.data(), size);
-  assert(nbytes == size);
+    size_t nbytes = piece->Serialize(slice.data(), size, proto);
+    assert(nbytes == size);
 
-  conn_->AsyncSend(
-      slice, bind(&Session::OnSend, shared_from_this(), slice, close, _1));
+    conn_->AsyncSend(
+        slice, bind(&Session::OnSend, shared_from_this(), slice, close, _1));
+  }
+  if (!conn_->closed()) {
+    CheckOutputLimit();
+  }
 }
 
-void Session::OnRecv(shared_ptr<Session> session, Slice slice, Status status,
-                     int nbytes) {
-  if (status.code() == kEof) {
-    SPDLOG_DEBUG("receive data failed, errno={}, reason='{}'", errno,
-                 ErrnoStr());
-    session->conn_->Close();
-    return;
-  }
+void Session::SendBulk(shared_ptr<BulkStringPiece> piece, bool close) {
+  auto& value = piece->value();
+  auto header_str = fmt::format("${}\r\n", value.size());
+  auto header = Slice(header_str.size());
+  memcpy(header.data(), header_str.data(), header_str.size());
+  // 值的缓冲区由 piece 持有，在发送完成前不会被释放
+  auto body = Slice(shared_ptr<char[]>(piece, value.data()), value.size());
+  auto trailer = Slice(2);
+  memcpy(trailer.data(), "\r\n", 2);
+
+  auto self = shared_from_this();
+  conn_->AsyncSend(header, bind(&Session::OnSend, self, header, false, _1));
+  conn_->AsyncSend(body, bind(&Session::OnSend, self, body, false, _1));
+  conn_->AsyncSend(trailer, bind(&Session::OnSend, self, trailer, close, _1));
+}
+
+void Session::OnRecv(shared_ptr<Session> session, Status status, Slice data) {
+  // 接收失败只影响该连接，例如对端关闭或重置连接，以及启用 keepalive 后
+  // 对端消失时的 ETIMEDOUT 和 EHOSTUNREACH
   if (status.error()) {
-    SPDLOG_CRITICAL("{}", status.ToString());
-    abort();
+    if (status.code() == kEof || status.code() == ECONNRESET) {
+      SPDLOG_DEBUG("close session {}, {}", session->id_, status.ToString());
+    } else {
+      SPDLOG_WARN("close session {}, receive data failed: {}", session->id_,
+                  status.ToString());
+    }
+    session->Close();
+    return;
   }
 
-  vector<vector<string>> reqs;
-  status = session->parser_.Parse(slice.data(), nbytes, reqs);
+  session->active_tick_ = idle_.tick;
+  session->ResizeRecvBuf(data.size());
+
+  // 只有处理完所有请求后才会继续接收，此时 reqs_ 为空
+  // 请求的参数直接引用 data，data 在这些请求处理完并销毁后被放回缓冲区池
+  status = session->parser_.Parse(data, session->reqs_);
   if (status.error()) {
     auto resp = make_shared<ErrorPiece>(status.msg());
     session->Send(resp, true);
     return;
   }
-
-  for (auto& req : reqs) {
-    Ctx ctx(session->id_);
-    Inst::GetInst()->Handle(ctx, req);
-    if (session->conn_->closed()) {
-      return;
-    }
-  }
-
-  session->conn_->AsyncRecv(slice,
-                            bind(&Session::OnRecv, session, slice, _1, _2));
+  session->Process();
 }
 
 void Session::OnSend(std::shared_ptr<Session> session, util::Slice slice,
                      bool close, err::Status status) {
   if (status.error()) {
     SPDLOG_DEBUG("send data failed, errno={}, reason='{}'", errno, ErrnoStr());
-    session->conn_->Close();
+    session->Close();
     return;
   }
 
   if (close) {
     SPDLOG_DEBUG("close the connection");
-    session->conn_->Close();
+    session->Close();
+    return;
+  }
+
+  if (session->conn_->closed()) {
+    return;
+  }
+  session->active_tick_ = idle_.tick;
+  // 输出缓冲区减少后恢复，在回调之外处理请求以免在发送的过程中产生新的回复
+  if (session->paused_ &&
+      session->conn_->unsent_bytes() <= kPauseOutputBytes / 2) {
+    session->paused_ = false;
+    session->conn_->loop()->Defer([session] {
+      if (!session->conn_->closed()) {
+        session->Process();
+      }
+    });
+  }
+  if (session->soft_since_ != 0) {
+    session->CheckOutputLimit();
   }
 }
 
@@ -0,0 +1,474 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <db/inst.hpp>
+#include <err/code.hpp>
+#include <err/errno.hpp>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <server/server.hpp>
+#include <server/session.hpp>
+#include <server/upgrade.hpp>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using fmt::format;
+using mydss::db::Inst;
+using mydss::err::ErrnoStr;
+using mydss::err::kEof;
+using mydss::err::kInvalidData;
+using mydss::err::Status;
+using mydss::net::InetType;
+using mydss::net::Loop;
+using nlohmann::json;
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace mydss::server {
+
+// 一条 SCM_RIGHTS 消息最多可以传递的文件描述符数目
+static constexpr size_t kMaxFds = 253;
+// 新进程成功接管后发送给旧进程的确认字节
+static constexpr char kAckByte = 'A';
+// 旧进程检查会话是否已经全部关闭的间隔，单位为毫秒
+static constexpr int kDrainCheckInterval = 100;
+// 接受交接请求失败后重试的间隔，单位为毫秒
+// 例如文件描述符耗尽时错误会持续一段时间，立即重试只会占满 CPU 并刷屏日志
+static constexpr int kAcceptRetryDelay = 100;
+
+// 从旧进程继承的监听套接字
+struct Inherited {
+  vector<int> fds;
+  size_t next = 0;  // 下一个将被取出的监听套接字的下标
+};
+
+// 正在监听的服务器及其所在的事件循环
+struct Listener {
+  shared_ptr<Loop> loop;
+  shared_ptr<Server> server;
+};
+
+// 以下状态在启动时被多个事件循环线程并发访问
+static std::mutex mutex;
+static unordered_map<string, Inherited> inherited;
+static vector<Listener> listeners;
+// 新进程中与旧进程的连接，用于在接管后通知旧进程
+static int ack_fd = -1;
+
+static Status SendAll(int fd, const void* data, size_t size) {
+  auto p = static_cast<const char*>(data);
+  while (size > 0) {
+    auto nbytes = send(fd, p, size, MSG_NOSIGNAL);
+    if (nbytes == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return {errno, ErrnoStr()};
+    }
+    p += nbytes;
+    size -= nbytes;
+  }
+  return Status::Ok();
+}
+
+static Status RecvAll(int fd, void* data, size_t size) {
+  auto p = static_cast<char*>(data);
+  while (size > 0) {
+    auto nbytes = recv(fd, p, size, 0);
+    if (nbytes == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return {errno, ErrnoStr()};
+    }
+    if (nbytes == 0) {
+      return {kEof, "connection closed by peer"};
+    }
+    p += nbytes;
+    size -= nbytes;
+  }
+  return Status::Ok();
+}
+
+// 创建 path 上的 Unix 域套接字地址
+static Status UnixAddr(const string& path, sockaddr_un& addr) {
+  if (path.size() >= sizeof(addr.sun_path)) {
+    return {ENAMETOOLONG, format("upgrade path '{}' is too long", path)};
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path.c_str(), path.size());
+  return Status::Ok();
+}
+
+string Upgrade::Key(const ServerConfig& config) {
+  switch (config.type()) {
+    case InetType::kIPv4:
+      return format("ipv4 {}:{}", config.ip(), config.port());
+    case InetType::kIPv6:
+      return format("ipv6 [{}]:{}", config.ip(), config.port());
+    case InetType::kUnix:
+      return format("unix {}", config.path());
+  }
+  return {};
+}
+
+// 接收监听套接字及其标识
+// 消息的格式为 4 字节的头部长度和 JSON 格式的头部，监听套接字作为辅助数据
+// 随第一个字节一起传递
+static Status RecvListeners(int sock) {
+  uint32_t len;
+  char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+  iovec iov = {&len, sizeof(len)};
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t nbytes;
+  do {
+    nbytes = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  } while (nbytes == -1 && errno == EINTR);
+  if (nbytes == -1) {
+    return {errno, ErrnoStr()};
+  }
+  if (nbytes == 0) {
+    return {kEof, "connection closed by the running server"};
+  }
+
+  vector<int> fds;
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    auto data = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+    fds.insert(fds.end(), data, data + n);
+  }
+  auto close_all = [&fds] {
+    for (int fd : fds) {
+      close(fd);
+    }
+  };
+  if (msg.msg_flags & MSG_CTRUNC) {
+    close_all();
+    return {kInvalidData, "too many listening sockets"};
+  }
+
+  auto status = RecvAll(sock, reinterpret_cast<char*>(&len) + nbytes,
+                        sizeof(len) - nbytes);
+  if (status.error()) {
+    close_all();
+    return status;
+  }
+  string header(len, '\0');
+  status = RecvAll(sock, header.data(), header.size());
+  if (status.error()) {
+    close_all();
+    return status;
+  }
+
+  auto keys = json::parse(header, nullptr, false);
+  if (!keys.is_array() || keys.size() != fds.size()) {
+    close_all();
+    return {kInvalidData, "invalid listening sockets header"};
+  }
+  for (size_t i = 0; i < fds.size(); i++) {
+    if (!keys[i].is_string()) {
+      close_all();
+      return {kInvalidData, "invalid listening sockets header"};
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (size_t i = 0; i < fds.size(); i++) {
+    inherited[keys[i].get<string>()].fds.push_back(fds[i]);
+  }
+  return Status::Ok();
+}
+
+// 接收并加载数据集，格式为 8 字节的长度和 Inst::Dump 序列化的数据
+static Status RecvDataset(int sock) {
+  uint64_t size;
+  auto status = RecvAll(sock, &size, sizeof(size));
+  if (status.error()) {
+    return status;
+  }
+  string data(size, '\0');
+  status = RecvAll(sock, data.data(), data.size());
+  if (status.error()) {
+    return status;
+  }
+  return Inst::GetInst()->Restore(data);
+}
+
+Status Upgrade::Receive(const string& path) {
+  sockaddr_un addr;
+  auto status = UnixAddr(path, addr);
+  if (status.error()) {
+    return status;
+  }
+
+  int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock == -1) {
+    return {errno, ErrnoStr()};
+  }
+  int ret = connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  if (ret == -1) {
+    status = {errno, format("connect to '{}' failed: {}", path, ErrnoStr())};
+    close(sock);
+    return status;
+  }
+
+  auto start = Loop::Now();
+  status = RecvListeners(sock);
+  if (status.ok()) {
+    status = RecvDataset(sock);
+  }
+  if (status.error()) {
+    close(sock);
+    CloseRemaining();
+    return status;
+  }
+  SPDLOG_INFO("received listening sockets and dataset from '{}' in {}ms",
+              path, Loop::Now() - start);
+  ack_fd = sock;
+  return Status::Ok();
+}
+
+int Upgrade::TakeListener(const string& key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = inherited.find(key);
+  if (it == inherited.end() || it->second.fds.empty()) {
+    return -1;
+  }
+  auto& entry = it->second;
+  if (entry.next < entry.fds.size()) {
+    return entry.fds[entry.next++];
+  }
+  // 所有的监听套接字都已被取出，与第一个线程共享同一个监听套接字，
+  // 而不是重新绑定，因为旧进程可能没有设置 SO_REUSEPORT
+  return dup(entry.fds[0]);
+}
+
+size_t Upgrade::Pending(const string& key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = inherited.find(key);
+  if (it == inherited.end()) {
+    return 0;
+  }
+  return it->second.fds.size() - it->second.next;
+}
+
+size_t Upgrade::CloseRemaining() {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t n = 0;
+  for (auto& [key, entry] : inherited) {
+    for (; entry.next < entry.fds.size(); entry.next++) {
+      close(entry.fds[entry.next]);
+      n++;
+    }
+  }
+  return n;
+}
+
+Status Upgrade::Ack() {
+  assert(ack_fd != -1);
+  auto status = SendAll(ack_fd, &kAckByte, 1);
+  close(ack_fd);
+  ack_fd = -1;
+  return status;
+}
+
+void Upgrade::Register(shared_ptr<Loop> loop, shared_ptr<Server> server) {
+  std::lock_guard<std::mutex> lock(mutex);
+  listeners.push_back({std::move(loop), std::move(server)});
+}
+
+// 将所有监听套接字和数据集的快照交给新进程，并等待新进程的确认
+static Status HandOver(int sock) {
+  vector<int> fds;
+  json keys = json::array();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& listener : listeners) {
+      fds.push_back(listener.server->listen_fd());
+      keys.push_back(Upgrade::Key(listener.server->config()));
+    }
+  }
+  if (fds.size() > kMaxFds) {
+    return {kInvalidData, format("too many listening sockets: {}", fds.size())};
+  }
+
+  auto header = keys.dump();
+  uint32_t len = header.size();
+  iovec iov[2] = {{&len, sizeof(len)}, {header.data(), header.size()}};
+  char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  if (fds.size() > 0) {
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+  }
+  // 头部很小，一次即可发送完毕
+  auto nbytes = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  if (nbytes == -1) {
+    return {errno, ErrnoStr()};
+  }
+  if (static_cast<size_t>(nbytes) != sizeof(len) + header.size()) {
+    return {kInvalidData, "send listening sockets header incompletely"};
+  }
+
+  // 序列化期间持有 Inst 的锁，所有事件循环的命令执行都会暂停，
+  // 暂停的时间与数据集的大小成正比
+  string data;
+  Inst::GetInst()->Dump(data);
+  uint64_t size = data.size();
+  auto status = SendAll(sock, &size, sizeof(size));
+  if (status.error()) {
+    return status;
+  }
+  status = SendAll(sock, data.data(), data.size());
+  if (status.error()) {
+    return status;
+  }
+  SPDLOG_INFO("handed over {} listening sockets and {} bytes of dataset",
+              fds.size(), size);
+
+  char ack;
+  status = RecvAll(sock, &ack, 1);
+  if (status.error()) {
+    return status;
+  }
+  if (ack != kAckByte) {
+    return {kInvalidData, "invalid acknowledgement"};
+  }
+  return Status::Ok();
+}
+
+// 检查请求交接的进程与当前进程的有效用户是否相同
+// 交接会将监听套接字和整个数据集交给对方并使当前进程退出，因此只接受同一用户
+static Status CheckPeer(int conn) {
+  ucred cred;
+  socklen_t len = sizeof(cred);
+  if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+    return {errno, ErrnoStr()};
+  }
+  if (cred.uid != geteuid()) {
+    return {EPERM, format("upgrade requested by uid {}, pid {}, expect uid {}",
+                          cred.uid, cred.pid, geteuid())};
+  }
+  return Status::Ok();
+}
+
+// 停止所有服务器接受连接，等待已有的会话关闭后退出进程
+[[noreturn]] static void Drain(uint64_t drain_timeout) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& listener : listeners) {
+      listener.loop->Post([server = listener.server] { server->Stop(); });
+    }
+  }
+
+  SPDLOG_INFO("stop accepting, wait for {} sessions to close", Session::live());
+  auto deadline = Loop::Now() + drain_timeout;
+  while (Session::live() > 0 && Loop::Now() < deadline) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(kDrainCheckInterval));
+  }
+  SPDLOG_INFO("exit after upgrade, {} sessions remaining", Session::live());
+  // 事件循环线程仍在运行，不能执行静态对象的析构
+  _exit(EXIT_SUCCESS);
+}
+
+Status Upgrade::Serve(const string& path, uint64_t drain_timeout) {
+  sockaddr_un addr;
+  auto status = UnixAddr(path, addr);
+  if (status.error()) {
+    return status;
+  }
+
+  int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock == -1) {
+    return {errno, ErrnoStr()};
+  }
+  // 删除上一个进程遗留的套接字文件
+  unlink(path.c_str());
+  // 在 listen 之前只允许当前用户访问，此时其他进程还无法连接
+  int ret = bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  if (ret == -1 || chmod(path.c_str(), S_IRUSR | S_IWUSR) == -1 ||
+      listen(sock, 1) == -1) {
+    status = {errno, format("listen on '{}' failed: {}", path, ErrnoStr())};
+    close(sock);
+    return status;
+  }
+
+  // 交接过程中的读写都是阻塞的，因此在独立的线程中进行
+  std::thread([sock, drain_timeout] {
+    for (;;) {
+      int conn = accept4(sock, nullptr, nullptr, SOCK_CLOEXEC);
+      if (conn == -1) {
+        if (errno != EINTR && errno != ECONNABORTED) {
+          SPDLOG_ERROR("accept upgrade request failed: {}", ErrnoStr());
+          std::this_thread::sleep_for(
+              std::chrono::milliseconds(kAcceptRetryDelay));
+        }
+        continue;
+      }
+
+      auto status = CheckPeer(conn);
+      if (status.error()) {
+        SPDLOG_WARN("reject upgrade request: {}", status.ToString());
+        close(conn);
+        continue;
+      }
+
+      SPDLOG_INFO("upgrade requested");
+      status = HandOver(conn);
+      close(conn);
+      if (status.ok()) {
+        break;
+      }
+      // 新进程没有成功接管，继续正常运行
+      SPDLOG_WARN("upgrade failed, keep running: {}", status.ToString());
+    }
+    // 不删除套接字文件，新进程会在同一路径上重新监听
+    close(sock);
+    Drain(drain_timeout);
+  }).detach();
+  return Status::Ok();
+}
+
+}  // namespace mydss::server
@@ -0,0 +1,250 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <util/scan.hpp>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace mydss::util {
+
+static const char* FindCrlfScalar(const char* p, const char* end) {
+  while (p < end) {
+    auto cr = static_cast<const char*>(memchr(p, '\r', end - p));
+    if (cr == nullptr || cr + 1 == end) {
+      return nullptr;
+    }
+    if (cr[1] == '\n') {
+      return cr;
+    }
+    p = cr + 1;
+  }
+  return nullptr;
+}
+
+static bool ParseDecScalar(const char* p, size_t len, uint64_t& result) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < len; i++) {
+    auto digit = static_cast<uint8_t>(p[i] - '0');
+    if (digit > 9) {
+      return false;
+    }
+    value = value * 10 + digit;
+  }
+  result = value;
+  return true;
+}
+
+#if defined(__x86_64__)
+
+// 在 mask 标记的 '\r' 中查找后面紧跟 '\n' 的第一个，mask 的第 i 位对应 p[i]
+static const char* MatchCr(const char* p, const char* end, uint32_t mask) {
+  while (mask != 0) {
+    const char* cr = p + __builtin_ctz(mask);
+    if (cr + 1 < end && cr[1] == '\n') {
+      return cr;
+    }
+    mask &= mask - 1;
+  }
+  return nullptr;
+}
+
+// 每次比较一个向量中的 '\r'，再逐个检查其后的字节是否为 '\n'，
+// 请求中的 '\r' 几乎都是行尾的一部分，因此很少需要检查多个候选
+// 剩余不足一个向量的部分逐字节扫描
+// SSE2 是 x86-64 的基本指令集，不需要运行时检测
+static const char* FindCrlfSse(const char* p, const char* end) {
+  const __m128i cr = _mm_set1_epi8('\r');
+  for (; end - p >= 16; p += 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, cr)));
+    if (mask != 0) {
+      auto result = MatchCr(p, end, mask);
+      if (result != nullptr) {
+        return result;
+      }
+    }
+  }
+  return FindCrlfScalar(p, end);
+}
+
+// 头部等较短的行通常在第一个 16 字节中结束，因此先以 SSE2 检查一个向量，
+// 之后每次处理两个 32 字节的向量
+__attribute__((target("avx2"))) static const char* FindCrlfAvx2(
+    const char* p, const char* end) {
+  if (end - p >= 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    auto mask = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    auto result = MatchCr(p, end, mask);
+    if (result != nullptr) {
+      return result;
+    }
+    p += 16;
+  }
+
+  const __m256i cr = _mm256_set1_epi8('\r');
+  for (; end - p >= 64; p += 64) {
+    auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    auto ma = _mm256_cmpeq_epi8(a, cr);
+    auto mb = _mm256_cmpeq_epi8(b, cr);
+    if (_mm256_testz_si256(_mm256_or_si256(ma, mb), _mm256_or_si256(ma, mb))) {
+      continue;
+    }
+    auto result =
+        MatchCr(p, end, static_cast<uint32_t>(_mm256_movemask_epi8(ma)));
+    if (result == nullptr) {
+      result = MatchCr(p + 32, end,
+                       static_cast<uint32_t>(_mm256_movemask_epi8(mb)));
+    }
+    if (result != nullptr) {
+      return result;
+    }
+  }
+  return FindCrlfSse(p, end);
+}
+
+// 将前 len 个字节移动到向量末尾并将其余字节清零的 pshufb 掩码，下标为 len
+struct ShiftMasks {
+  alignas(16) int8_t masks[17][16];
+};
+
+static constexpr ShiftMasks MakeShiftMasks() {
+  ShiftMasks result{};
+  for (int len = 0; len <= 16; len++) {
+    for (int i = 0; i < 16; i++) {
+      // 最高位为 1 的下标使 pshufb 输出 0
+      result.masks[len][i] = static_cast<int8_t>(
+          i < 16 - len ? -128 : i - (16 - len));
+    }
+  }
+  return result;
+}
+
+static constexpr ShiftMasks kShiftMasks = MakeShiftMasks();
+
+// 将数字右对齐到 16 字节中，左侧补 0，然后逐级合并相邻的数字：
+// 2 个 1 位数合并为 2 位数，再依次合并为 4 位数和 8 位数，最后合并两个 8 位数
+__attribute__((target("sse4.1"))) static bool ParseDecSse(const char* p,
+                                                          size_t len,
+                                                          uint64_t& result) {
+  if (len > 16) {
+    return ParseDecScalar(p, len, result);
+  }
+
+  // 16 字节不跨越页边界时直接读取，多读取的字节位于同一页中，不会导致缺页错误，
+  // 它们会被 pshufb 丢弃；否则先复制到栈上
+  __m128i v;
+  if ((reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - 16) {
+    v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  } else {
+    alignas(16) char buf[16];
+    memcpy(buf, p, len);
+    v = _mm_load_si128(reinterpret_cast<const __m128i*>(buf));
+  }
+  v = _mm_shuffle_epi8(
+      _mm_sub_epi8(v, _mm_set1_epi8('0')),
+      _mm_load_si128(reinterpret_cast<const __m128i*>(kShiftMasks.masks[len])));
+
+  // 非数字字符减去 '0' 后作为无符号数大于 9
+  const __m128i nine = _mm_set1_epi8(9);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, nine), nine)) !=
+      0xffff) {
+    return false;
+  }
+
+  v = _mm_maddubs_epi16(
+      v, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+  v = _mm_madd_epi16(v, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+  v = _mm_packus_epi32(v, v);
+  v = _mm_madd_epi16(v, _mm_setr_epi16(10000, 1, 10000, 1, 0, 0, 0, 0));
+  uint64_t high = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+  uint64_t low = static_cast<uint32_t>(_mm_extract_epi32(v, 1));
+  result = high * 100000000 + low;
+  return true;
+}
+
+#endif
+
+// 当前使用的扫描函数
+static struct {
+  Isa isa;
+  const char* (*find_crlf)(const char*, const char*);
+  bool (*parse_dec)(const char*, size_t, uint64_t&);
+} scan = {Isa::kScalar, FindCrlfScalar, ParseDecScalar};
+
+// 在进程启动时选择 CPU 支持的最高指令集
+static const bool kScanInitialized = SetScanIsa(DetectIsa());
+
+Isa DetectIsa() {
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx2")) {
+    return Isa::kAvx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return Isa::kSse;
+  }
+#endif
+  return Isa::kScalar;
+}
+
+Isa ScanIsa() { return scan.isa; }
+
+bool SetScanIsa(Isa isa) {
+  if (isa > DetectIsa()) {
+    return false;
+  }
+  switch (isa) {
+    case Isa::kScalar:
+      scan = {isa, FindCrlfScalar, ParseDecScalar};
+      break;
+#if defined(__x86_64__)
+    case Isa::kSse:
+      scan = {isa, FindCrlfSse, ParseDecSse};
+      break;
+    case Isa::kAvx2:
+      scan = {isa, FindCrlfAvx2, ParseDecSse};
+      break;
+#else
+    default:
+      return false;
+#endif
+  }
+  return true;
+}
+
+const char* IsaName(Isa isa) {
+  switch (isa) {
+    case Isa::kScalar:
+      return "scalar";
+    case Isa::kSse:
+      return "sse";
+    case Isa::kAvx2:
+      return "avx2";
+  }
+  return "unknown";
+}
+
+const char* FindCrlf(const char* p, const char* end) {
+  return scan.find_crlf(p, end);
+}
+
+bool ParseDec(const char* p, size_t len, uint64_t& result) {
+  return scan.parse_dec(p, len, result);
+}
+
+}  // namespace mydss::util
@@ -14,7 +14,7 @@
 
 #include <util/str.hpp>
 
-using std::string;
+using std::string_view;
 
 namespace mydss::util {
 
@@ -31,7 +31,7 @@ size_t U64StrLen(uint64_t u64) {
   return len;
 }
 
-bool StrToI64(const string& str, int64_t* result) {
+bool StrToI64(string_view str, int64_t* result) {
   if (str.empty()) {
     return false;
   }
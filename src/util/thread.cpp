@@ -0,0 +1,153 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <err/errno.hpp>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <util/thread.hpp>
+
+using mydss::err::ErrnoStr;
+using mydss::err::Status;
+using std::string;
+using std::vector;
+
+namespace mydss::util {
+
+// 已注册的线程的名称和线程 ID
+static std::mutex registry_mutex;
+static vector<std::pair<string, pid_t>> registry;
+
+Status PinThread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (ret != 0) {
+    errno = ret;
+    return {ret, ErrnoStr()};
+  }
+  return Status::Ok();
+}
+
+void RegisterThread(const string& name) {
+  // 主线程的名称即进程的名称，ps、pkill 等工具依赖它，因此不修改
+  // 线程名称最长为 15 个字符
+  if (gettid() != getpid()) {
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+  }
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry.emplace_back(name, gettid());
+}
+
+// 将 CPU 集合格式化为 "0-3,6" 的形式
+static string FormatCpus(const cpu_set_t& set) {
+  string result;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &set)) {
+      continue;
+    }
+    int last = cpu;
+    while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set)) {
+      last++;
+    }
+    if (!result.empty()) {
+      result += ',';
+    }
+    result += std::to_string(cpu);
+    if (last > cpu) {
+      result += '-' + std::to_string(last);
+    }
+    cpu = last;
+  }
+  return result;
+}
+
+// 读取 /proc/self/task/<tid> 中的统计信息，线程已经退出时返回 false
+static bool ReadUsage(pid_t tid, ThreadUsage& usage) {
+  string dir = "/proc/self/task/" + std::to_string(tid);
+  std::ifstream stat_file(dir + "/stat");
+  string stat;
+  if (!std::getline(stat_file, stat)) {
+    return false;
+  }
+  // 线程名称中可能包含空格和括号，从最后一个 ')' 之后开始解析，
+  // 其后第 1 个字段为 stat 中的第 3 个字段
+  auto pos = stat.rfind(')');
+  if (pos == string::npos) {
+    return false;
+  }
+  std::istringstream fields(stat.substr(pos + 2));
+  vector<string> values;
+  string value;
+  while (fields >> value) {
+    values.push_back(std::move(value));
+  }
+  // utime、stime 和 processor 分别为第 14、15 和 39 个字段
+  if (values.size() < 37) {
+    return false;
+  }
+  double ticks = sysconf(_SC_CLK_TCK);
+  usage.user = strtoull(values[11].c_str(), nullptr, 10) / ticks;
+  usage.sys = strtoull(values[12].c_str(), nullptr, 10) / ticks;
+  usage.cpu = atoi(values[36].c_str());
+
+  std::ifstream status_file(dir + "/status");
+  string line;
+  while (std::getline(status_file, line)) {
+    auto colon = line.find(':');
+    if (colon == string::npos) {
+      continue;
+    }
+    auto key = line.substr(0, colon);
+    if (key == "voluntary_ctxt_switches") {
+      usage.voluntary = strtoull(line.c_str() + colon + 1, nullptr, 10);
+    } else if (key == "nonvoluntary_ctxt_switches") {
+      usage.involuntary = strtoull(line.c_str() + colon + 1, nullptr, 10);
+    }
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(tid, sizeof(set), &set) == 0) {
+    usage.affinity = FormatCpus(set);
+  }
+  return true;
+}
+
+vector<ThreadUsage> GetThreadUsage() {
+  vector<std::pair<string, pid_t>> threads;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    threads = registry;
+  }
+
+  vector<ThreadUsage> result;
+  for (auto& [name, tid] : threads) {
+    ThreadUsage usage;
+    usage.name = name;
+    usage.tid = tid;
+    if (ReadUsage(tid, usage)) {
+      result.push_back(std::move(usage));
+    }
+  }
+  return result;
+}
+
+}  // namespace mydss::util
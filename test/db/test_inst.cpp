@@ -0,0 +1,97 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cmd/string.hpp>
+#include <cstdint>
+#include <cstring>
+#include <db/inst.hpp>
+#include <memory>
+#include <string>
+
+using mydss::cmd::String;
+using std::make_shared;
+using std::static_pointer_cast;
+using std::string;
+
+namespace mydss::db {
+
+TEST(TestInst, DumpRestore) {
+  Inst::Init(2);
+  auto inst = Inst::GetInst();
+  auto str = make_shared<String>("value");
+  str->SetPTtl(100000);
+  inst->db().objs()["raw"] = str;
+  auto num = make_shared<String>();
+  num->SetI64(-42);
+  inst->db().objs()["int"] = num;
+  ASSERT_TRUE(inst->Select(1));
+  inst->db().objs()["other"] = make_shared<String>("x");
+  // 已经过期的键不会被序列化
+  auto expired = make_shared<String>("y");
+  expired->SetPTtl(0);
+  inst->db().objs()["expired"] = expired;
+
+  string data;
+  inst->Dump(data);
+
+  Inst::Init(2);
+  inst = Inst::GetInst();
+  ASSERT_TRUE(inst->Restore(data).ok());
+
+  auto& objs = inst->db().objs();
+  ASSERT_EQ(objs.size(), 2);
+  auto raw = static_pointer_cast<String>(objs.at("raw"));
+  EXPECT_EQ(raw->Str(), "value");
+  EXPECT_GT(raw->PTtl(), 99000);
+  EXPECT_EQ(static_pointer_cast<String>(objs.at("int"))->I64(), -42);
+  EXPECT_EQ(objs.at("int")->PTtl(), -1);
+
+  ASSERT_TRUE(inst->Select(1));
+  ASSERT_EQ(inst->db().objs().size(), 1);
+  EXPECT_EQ(inst->db().objs().count("other"), 1);
+
+  // 截断或格式未知的数据集
+  EXPECT_TRUE(inst->Restore(data.substr(0, data.size() - 1)).error());
+  EXPECT_TRUE(inst->Restore("garbage").error());
+}
+
+TEST(TestInst, RestoreInvalid) {
+  Inst::Init(1);
+  auto inst = Inst::GetInst();
+  auto num = make_shared<String>();
+  num->SetI64(7);
+  inst->db().objs()["int"] = num;
+  string data;
+  inst->Dump(data);
+  // 数据集的最后是整数的值和 8 字节的过期时间
+  const size_t value_pos = data.size() - sizeof(int64_t) - 1;
+  ASSERT_EQ(data[value_pos], '7');
+
+  Inst::Init(1);
+  inst = Inst::GetInst();
+  auto bad_int = data;
+  bad_int[value_pos] = 'x';
+  EXPECT_TRUE(inst->Restore(bad_int).error());
+
+  for (int64_t pttl : {int64_t{-2}, INT64_MIN, INT64_MAX}) {
+    auto bad_ttl = data;
+    memcpy(bad_ttl.data() + value_pos + 1, &pttl, sizeof(pttl));
+    EXPECT_TRUE(inst->Restore(bad_ttl).error()) << pttl;
+  }
+  EXPECT_TRUE(inst->db().objs().empty());
+}
+
+}  // namespace mydss::db
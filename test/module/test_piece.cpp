@@ -0,0 +1,72 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <module/piece.hpp>
+#include <string>
+
+using std::string;
+
+namespace mydss::module {
+
+// 以 proto 序列化 piece
+static string Serialize(const Piece& piece, Proto proto) {
+  string result(piece.Size(proto), '\0');
+  EXPECT_EQ(piece.Serialize(result.data(), result.size(), proto),
+            result.size());
+  return result;
+}
+
+// 检查 piece 在 RESP2 和 RESP3 中的序列化结果
+static void Check(const Piece& piece, const string& resp2,
+                  const string& resp3) {
+  EXPECT_EQ(Serialize(piece, Proto::kResp2), resp2);
+  EXPECT_EQ(Serialize(piece, Proto::kResp3), resp3);
+}
+
+TEST(TestPiece, Resp2Types) {
+  Check(SimpleStringPiece("OK"), "+OK\r\n", "+OK\r\n");
+  Check(ErrorPiece("ERR x"), "-ERR x\r\n", "-ERR x\r\n");
+  Check(IntegerPiece(-12), ":-12\r\n", ":-12\r\n");
+  Check(BulkStringPiece("ab"), "$2\r\nab\r\n", "$2\r\nab\r\n");
+  Check(ArrayPiece(3), "*3\r\n", "*3\r\n");
+  Check(NullPiece(), "$-1\r\n", "_\r\n");
+}
+
+TEST(TestPiece, Aggregate) {
+  Check(MapPiece(2), "*4\r\n", "%2\r\n");
+  Check(SetPiece(3), "*3\r\n", "~3\r\n");
+  Check(PushPiece(3), "*3\r\n", ">3\r\n");
+  // 属性在 RESP2 中不回复
+  Check(AttributePiece(1), "", "|1\r\n");
+}
+
+TEST(TestPiece, Scalar) {
+  Check(DoublePiece(1.5), "$3\r\n1.5\r\n", ",1.5\r\n");
+  Check(DoublePiece(-0.25), "$5\r\n-0.25\r\n", ",-0.25\r\n");
+  Check(DoublePiece(INFINITY), "$3\r\ninf\r\n", ",inf\r\n");
+  Check(DoublePiece(-INFINITY), "$4\r\n-inf\r\n", ",-inf\r\n");
+  Check(DoublePiece(NAN), "$3\r\nnan\r\n", ",nan\r\n");
+  Check(BooleanPiece(true), ":1\r\n", "#t\r\n");
+  Check(BooleanPiece(false), ":0\r\n", "#f\r\n");
+  Check(BigNumberPiece("3492890328409238509324850943850943825024385"),
+        "$43\r\n3492890328409238509324850943850943825024385\r\n",
+        "(3492890328409238509324850943850943825024385\r\n");
+  Check(VerbatimStringPiece("txt", "Some string"), "$11\r\nSome string\r\n",
+        "=15\r\ntxt:Some string\r\n");
+}
+
+}  // namespace mydss::module
@@ -0,0 +1,101 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <net/acceptor.hpp>
+#include <vector>
+
+using std::shared_ptr;
+using std::vector;
+
+namespace mydss::net {
+
+static constexpr const char* kPath = "/tmp/mydss_test_acceptor.sock";
+
+static int ConnectUnix(const char* path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  EXPECT_NE(fd, -1);
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  int ret = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  EXPECT_EQ(ret, 0);
+  return fd;
+}
+
+TEST(TestAcceptor, DrainBacklog) {
+  auto loop = Loop::New();
+  auto acceptor = Acceptor::New(loop, EndPoint(InetType::kUnix, kPath, 0));
+  ASSERT_TRUE(acceptor->Start(256).ok());
+
+  // 在开始接受连接之前堆积在积压队列中的连接
+  const int n = 100;
+  vector<int> clients;
+  for (int i = 0; i < n; i++) {
+    clients.push_back(ConnectUnix(kPath));
+  }
+
+  // 一次接受积压队列中的所有连接，而不是每轮只接受一个
+  vector<shared_ptr<Conn>> conns;
+  acceptor->Serve([&conns](shared_ptr<Conn> conn) { conns.push_back(conn); });
+  EXPECT_EQ(conns.size(), n);
+
+  // 之后到达的连接在同一次可读事件中全部被接受
+  for (int i = 0; i < n; i++) {
+    clients.push_back(ConnectUnix(kPath));
+  }
+  loop->RunOnce(100);
+  EXPECT_EQ(conns.size(), n * 2);
+
+  for (auto& conn : conns) {
+    conn->Close();
+  }
+  for (int fd : clients) {
+    close(fd);
+  }
+  unlink(kPath);
+}
+
+TEST(TestAcceptor, UnixPath) {
+  auto loop = Loop::New();
+  // 上次运行遗留的套接字文件被删除后重新绑定
+  auto first = Acceptor::New(loop, EndPoint(InetType::kUnix, kPath, 0));
+  ASSERT_TRUE(first->Start(16).ok());
+  first->Stop();
+  auto second = Acceptor::New(loop, EndPoint(InetType::kUnix, kPath, 0));
+  ASSERT_TRUE(second->Start(16).ok());
+  second->Stop();
+  unlink(kPath);
+
+  // 路径上是普通文件时不会被删除
+  FILE* file = fopen(kPath, "w");
+  ASSERT_NE(file, nullptr);
+  fclose(file);
+  auto acceptor = Acceptor::New(loop, EndPoint(InetType::kUnix, kPath, 0));
+  EXPECT_TRUE(acceptor->Start(16).error());
+  struct stat st;
+  ASSERT_EQ(lstat(kPath, &st), 0);
+  EXPECT_TRUE(S_ISREG(st.st_mode));
+  unlink(kPath);
+}
+
+}  // namespace mydss::net
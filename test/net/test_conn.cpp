@@ -0,0 +1,184 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <net/conn.hpp>
+#include <string>
+
+using mydss::err::Status;
+using mydss::util::Slice;
+using std::function;
+using std::shared_ptr;
+using std::string;
+
+namespace mydss::net {
+
+// 通过 socketpair 创建已连接的 Conn，返回对端的套接字
+static int NewConn(shared_ptr<Loop> loop, shared_ptr<Conn>& conn) {
+  int fds[2];
+  int ret = socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+  EXPECT_EQ(ret, 0);
+  // 增大缓冲区，使对端可以一次写入超过读取额度的数据
+  int size = 4 * 1024 * 1024;
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+  conn = Conn::New();
+  conn->Connect(fds[1], EndPoint());
+  EXPECT_TRUE(conn->Attach(loop).ok());
+  return fds[0];
+}
+
+// 通过回环接口建立 TCP 连接，返回对端的套接字
+static int NewTcpConn(shared_ptr<Loop> loop, shared_ptr<Conn>& conn) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  EXPECT_NE(listener, -1);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  EXPECT_EQ(bind(listener, reinterpret_cast<sockaddr*>(&addr), len), 0);
+  EXPECT_EQ(listen(listener, 1), 0);
+  EXPECT_EQ(getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len), 0);
+
+  int peer = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  EXPECT_NE(peer, -1);
+  int ret = connect(peer, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  EXPECT_TRUE(ret == 0 || errno == EINPROGRESS);
+  int sock = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+  EXPECT_NE(sock, -1);
+  close(listener);
+
+  conn = Conn::New();
+  conn->Connect(sock, EndPoint());
+  EXPECT_TRUE(conn->Attach(loop).ok());
+  return peer;
+}
+
+// 在每次接收完成后继续接收，统计接收的字节数
+static void RecvAll(shared_ptr<Conn> conn, Slice slice, size_t& received) {
+  conn->AsyncRecv(slice, [conn, slice, &received](Status status, int64_t n) {
+    if (status.ok()) {
+      received += n;
+      RecvAll(conn, slice, received);
+    }
+  });
+}
+
+TEST(TestConn, DrainUntilEagain) {
+  auto loop = Loop::New();
+  shared_ptr<Conn> conn;
+  int peer = NewConn(loop, conn);
+
+  string data(64 * 1024, 'x');
+  ASSERT_EQ(write(peer, data.data(), data.size()), data.size());
+
+  // 一次可读事件读取套接字中的所有数据，而不是每轮只读取一次
+  size_t received = 0;
+  RecvAll(conn, Slice(2048), received);
+  EXPECT_EQ(received, data.size());
+
+  ASSERT_EQ(write(peer, data.data(), data.size()), data.size());
+  loop->RunOnce(100);
+  EXPECT_EQ(received, data.size() * 2);
+
+  conn->Close();
+  close(peer);
+}
+
+TEST(TestConn, RecvBudget) {
+  auto loop = Loop::New();
+  shared_ptr<Conn> conn;
+  int peer = NewConn(loop, conn);
+
+  string data(Conn::kRecvBudget * 3, 'x');
+  size_t written = 0;
+  while (written < data.size()) {
+    auto n = write(peer, data.data() + written, data.size() - written);
+    ASSERT_GT(n, 0);
+    written += n;
+  }
+
+  // 每轮最多读取 kRecvBudget 字节，剩余的数据在之后的几轮中读取
+  size_t received = 0;
+  RecvAll(conn, Slice(64 * 1024), received);
+  EXPECT_EQ(received, Conn::kRecvBudget);
+  loop->RunOnce(0);
+  EXPECT_EQ(received, Conn::kRecvBudget * 2);
+  loop->RunOnce(0);
+  EXPECT_EQ(received, Conn::kRecvBudget * 3);
+
+  conn->Close();
+  close(peer);
+}
+
+TEST(TestConn, Zerocopy) {
+  auto loop = Loop::New();
+  shared_ptr<Conn> conn;
+  int peer = NewTcpConn(loop, conn);
+  conn->set_zerocopy_threshold(16 * 1024);
+  if (!conn->zerocopy()) {
+    conn->Close();
+    close(peer);
+    GTEST_SKIP() << "SO_ZEROCOPY is not supported";
+  }
+
+  const size_t size = 1024 * 1024;
+  shared_ptr<char[]> data(new char[size]);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<char>(i % 251);
+  }
+  bool sent = false;
+  conn->AsyncSend(Slice(data, size), [&sent](Status status) {
+    EXPECT_TRUE(status.ok());
+    sent = true;
+  });
+
+  string received;
+  char buf[64 * 1024];
+  auto deadline = Loop::Now() + 5000;
+  while (received.size() < size && Loop::Now() < deadline) {
+    auto nbytes = recv(peer, buf, sizeof(buf), MSG_DONTWAIT);
+    if (nbytes > 0) {
+      received.append(buf, nbytes);
+    } else {
+      loop->RunOnce(10);
+    }
+  }
+  EXPECT_TRUE(sent);
+  EXPECT_TRUE(received == string(data.get(), size));
+
+  // 数据在完成通知到达后才被释放，回环接口上内核会复制数据，
+  // 此后连接回退为普通的发送
+  deadline = Loop::Now() + 1000;
+  while (data.use_count() > 1 && Loop::Now() < deadline) {
+    loop->RunOnce(10);
+  }
+  EXPECT_EQ(data.use_count(), 1);
+  EXPECT_FALSE(conn->zerocopy());
+
+  conn->Close();
+  close(peer);
+}
+
+}  // namespace mydss::net
@@ -0,0 +1,110 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <net/loop.hpp>
+#include <thread>
+#include <vector>
+
+using std::thread;
+using std::vector;
+using std::chrono::microseconds;
+
+namespace mydss::net {
+
+TEST(TestLoop, PostFromThreads) {
+  auto loop = Loop::New();
+  const int nthreads = 4;
+  const int nposts = 100000;
+
+  // 每个线程提交的任务按顺序执行
+  vector<int> last(nthreads, -1);
+  bool ordered = true;
+  int done = 0;
+
+  vector<thread> threads;
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < nposts; i++) {
+        loop->Post([&, t, i] {
+          ordered = ordered && last[t] == i - 1;
+          last[t] = i;
+          done++;
+        });
+      }
+    });
+  }
+  while (done < nthreads * nposts) {
+    loop->RunOnce(-1);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(loop->stats().posts, nthreads * nposts);
+}
+
+TEST(TestLoop, PostBatch) {
+  auto loop = Loop::New();
+  size_t n = Loop::kMaxPostsPerIteration + 10;
+  size_t done = 0;
+  for (size_t i = 0; i < n; i++) {
+    loop->Post([&done] { done++; });
+  }
+
+  // 每轮最多执行 kMaxPostsPerIteration 个任务，剩余的任务在下一轮执行
+  loop->RunOnce(0);
+  EXPECT_EQ(done, Loop::kMaxPostsPerIteration);
+  loop->RunOnce(0);
+  EXPECT_EQ(done, n);
+}
+
+TEST(TestLoop, BusyPoll) {
+  for (auto engine : {Engine::kEpoll, Engine::kUring}) {
+    auto loop = Loop::New(Loop::kDefaultMaxEvents, engine);
+    loop->set_busy_poll(2000);
+    ASSERT_NE(loop->busy_stats(), nullptr);
+    EXPECT_EQ(Loop::AllBusyStats().size(), 1);
+    const auto& stats = *loop->busy_stats();
+
+    // 没有事件时忙等待超出时间上限后阻塞等待，直到超时
+    loop->RunOnce(20);
+    EXPECT_GT(stats.spins.load(), 0);
+    EXPECT_GE(stats.spin_time.load(), 2000);
+    EXPECT_EQ(stats.sleeps.load(), 1);
+
+    // 忙等待期间提交的任务不需要阻塞等待即可执行
+    loop->set_busy_poll(1000000);
+    bool done = false;
+    thread t([&] {
+      std::this_thread::sleep_for(microseconds(500));
+      loop->Post([&done] { done = true; });
+    });
+    while (!done) {
+      loop->RunOnce(-1);
+    }
+    t.join();
+    EXPECT_EQ(stats.sleeps.load(), 1);
+    EXPECT_GT(stats.work_time.load() + stats.spin_time.load(), 0);
+
+    loop->set_busy_poll(0);
+    EXPECT_EQ(loop->busy_stats(), nullptr);
+    EXPECT_TRUE(Loop::AllBusyStats().empty());
+  }
+}
+
+}  // namespace mydss::net
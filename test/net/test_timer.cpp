@@ -0,0 +1,216 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <net/loop.hpp>
+#include <net/timer.hpp>
+#include <random>
+#include <vector>
+
+using std::vector;
+
+namespace mydss::net {
+
+TEST(TestTimerWheel, OneShot) {
+  TimerWheel wheel(1000);
+  int fired = 0;
+  wheel.Add(10, [&fired] { fired++; });
+  EXPECT_EQ(wheel.size(), 1);
+
+  EXPECT_EQ(wheel.Advance(1009), 0);
+  EXPECT_EQ(fired, 0);
+  EXPECT_EQ(wheel.Advance(1010), 1);
+  EXPECT_EQ(fired, 1);
+  EXPECT_EQ(wheel.size(), 0);
+  EXPECT_EQ(wheel.Advance(2000), 0);
+}
+
+TEST(TestTimerWheel, ZeroDelay) {
+  TimerWheel wheel(0);
+  int fired = 0;
+  wheel.Add(0, [&fired] { fired++; });
+  EXPECT_EQ(wheel.Advance(0), 0);
+  EXPECT_EQ(wheel.Advance(1), 1);
+  EXPECT_EQ(fired, 1);
+}
+
+TEST(TestTimerWheel, Periodic) {
+  TimerWheel wheel(0);
+  vector<uint64_t> ticks;
+  uint64_t now = 0;
+  auto id = wheel.Add(5, 10, [&] { ticks.push_back(now); });
+
+  for (now = 1; now <= 40; now++) {
+    wheel.Advance(now);
+  }
+  EXPECT_EQ(ticks, (vector<uint64_t>{5, 15, 25, 35}));
+
+  wheel.Cancel(id);
+  EXPECT_EQ(wheel.size(), 0);
+  wheel.Advance(100);
+  EXPECT_EQ(ticks.size(), 4);
+}
+
+TEST(TestTimerWheel, Cancel) {
+  TimerWheel wheel(0);
+  int fired = 0;
+  auto id = wheel.Add(300, [&fired] { fired++; });
+  wheel.Advance(100);
+  wheel.Cancel(id);
+  EXPECT_EQ(wheel.size(), 0);
+  wheel.Advance(1000);
+  EXPECT_EQ(fired, 0);
+
+  // 节点被复用后，旧的句柄不会取消新的定时器
+  wheel.Add(10, [&fired] { fired++; });
+  wheel.Cancel(id);
+  wheel.Cancel(TimerId());
+  EXPECT_EQ(wheel.size(), 1);
+  wheel.Advance(1010);
+  EXPECT_EQ(fired, 1);
+}
+
+TEST(TestTimerWheel, CancelInCallback) {
+  TimerWheel wheel(0);
+  int fired = 0;
+  TimerId id;
+  id = wheel.Add(1, 1, [&] {
+    if (++fired == 3) {
+      wheel.Cancel(id);
+    }
+  });
+  wheel.Advance(100);
+  EXPECT_EQ(fired, 3);
+  EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TestTimerWheel, AddInCallback) {
+  TimerWheel wheel(0);
+  vector<uint64_t> ticks;
+  uint64_t now = 0;
+  wheel.Add(10, [&] {
+    ticks.push_back(now);
+    wheel.Add(0, [&] { ticks.push_back(now); });
+    wheel.Add(1000, [&] { ticks.push_back(now); });
+  });
+
+  for (now = 1; now <= 2000; now++) {
+    wheel.Advance(now);
+  }
+  EXPECT_EQ(ticks, (vector<uint64_t>{10, 11, 1010}));
+}
+
+TEST(TestTimerWheel, Levels) {
+  // 每个定时器都应该恰好在到期的刻度执行
+  const vector<uint64_t> delays = {1,       255,      256,       257,
+                                   65535,   65536,    65537,     100000,
+                                   1 << 24, 20000000, 1ULL << 32, 5ULL << 32};
+  for (uint64_t start : {0ULL, 12345ULL, (1ULL << 32) - 7}) {
+    TimerWheel wheel(start);
+    vector<uint64_t> fired(delays.size(), 0);
+    for (size_t i = 0; i < delays.size(); i++) {
+      wheel.Add(delays[i], [&, i] { fired[i]++; });
+    }
+    for (size_t i = 0; i < delays.size(); i++) {
+      uint64_t expire = start + delays[i];
+      wheel.Advance(expire - 1);
+      EXPECT_EQ(fired[i], 0) << "delay=" << delays[i];
+      wheel.Advance(expire);
+      EXPECT_EQ(fired[i], 1) << "delay=" << delays[i];
+    }
+    EXPECT_EQ(wheel.size(), 0);
+  }
+}
+
+TEST(TestTimerWheel, NextDeadline) {
+  TimerWheel wheel(100);
+  EXPECT_EQ(wheel.NextDeadline(), UINT64_MAX);
+
+  auto id = wheel.Add(20, [] {});
+  EXPECT_EQ(wheel.NextDeadline(), 120);
+
+  // 较高层的定时器在移动前只能确定下一次移动的时间
+  wheel.Cancel(id);
+  wheel.Add(1000, [] {});
+  EXPECT_EQ(wheel.NextDeadline(), 256);
+}
+
+TEST(TestTimerWheel, Random) {
+  std::mt19937_64 rng(42);
+  TimerWheel wheel(0);
+  const size_t n = 10000;
+  vector<uint64_t> expires(n);
+  vector<int64_t> fired_at(n, -1);
+  vector<TimerId> ids(n);
+  vector<bool> cancelled(n, false);
+  uint64_t now = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    uint64_t delay = rng() % (1 << (rng() % 24));
+    expires[i] = delay;
+    ids[i] = wheel.Add(delay, [&, i] { fired_at[i] = now; });
+  }
+  for (size_t i = 0; i < n; i += 7) {
+    wheel.Cancel(ids[i]);
+    cancelled[i] = true;
+  }
+
+  uint64_t prev = 0;
+  while (wheel.size() > 0) {
+    now += rng() % 5000;
+    wheel.Advance(now);
+    for (size_t i = 0; i < n; i++) {
+      if (cancelled[i] || expires[i] > now || expires[i] <= prev) {
+        continue;
+      }
+      // 在推进时间的区间内到期的定时器必须在本次执行
+      ASSERT_EQ(fired_at[i], now) << "i=" << i;
+    }
+    prev = now;
+  }
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_EQ(fired_at[i] == -1, cancelled[i]);
+  }
+}
+
+TEST(TestLoop, RunAfter) {
+  auto loop = Loop::New();
+  bool fired = false;
+  auto start = Loop::Now();
+  loop->RunAfter(20, [&fired] { fired = true; });
+  while (!fired) {
+    loop->RunOnce(-1);
+  }
+  EXPECT_GE(Loop::Now() - start, 20);
+  EXPECT_EQ(loop->stats().timers, 1);
+}
+
+TEST(TestLoop, RunEvery) {
+  auto loop = Loop::New();
+  int fired = 0;
+  TimerId id;
+  id = loop->RunEvery(1, [&] {
+    if (++fired == 5) {
+      loop->Cancel(id);
+    }
+  });
+  while (fired < 5) {
+    loop->RunOnce(-1);
+  }
+  loop->RunOnce(10);
+  EXPECT_EQ(fired, 5);
+}
+
+}  // namespace mydss::net
@@ -0,0 +1,160 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <limit.hpp>
+#include <server/parser.hpp>
+#include <string>
+#include <utility>
+#include <util/buf_pool.hpp>
+#include <vector>
+
+using mydss::module::Req;
+using mydss::util::BufPool;
+using mydss::util::Slice;
+using std::string;
+using std::vector;
+
+namespace mydss::server {
+
+// 将数据复制到一个新的缓冲区中，模拟接收到的一段数据
+static Slice Recv(const char* data, size_t len) {
+  Slice slice(len);
+  memcpy(slice.data(), data, len);
+  return slice;
+}
+
+static Slice Recv(const string& data) { return Recv(data.data(), data.size()); }
+
+static const string kPipeline =
+    "*1\r\n$4\r\nPING\r\n"
+    "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$10\r\nva\r\nl\nue\r\n\r\n"
+    "*0\r\n"
+    "*2\r\n$3\r\nGET\r\n$0\r\n\r\n"
+    "PING\r\n"
+    "\r\n"
+    "set \"a b\" 'c\\'d'\n";
+
+static const vector<Req> kExpected = {{"PING"},
+                                      {"SET", "key", "va\r\nl\nue\r\n"},
+                                      {"GET", ""},
+                                      {"PING"},
+                                      {"set", "a b", "c'd"}};
+
+TEST(TestParser, Pipeline) {
+  ReqParser parser;
+  vector<Req> reqs;
+  ASSERT_TRUE(parser.Parse(Recv(kPipeline), reqs).ok());
+  EXPECT_EQ(reqs, kExpected);
+}
+
+TEST(TestParser, Split) {
+  // 在每一个位置将数据分为两段
+  for (size_t i = 0; i <= kPipeline.size(); i++) {
+    ReqParser parser;
+    vector<Req> reqs;
+    ASSERT_TRUE(parser.Parse(Recv(kPipeline.data(), i), reqs).ok());
+    ASSERT_TRUE(
+        parser.Parse(Recv(kPipeline.data() + i, kPipeline.size() - i), reqs)
+            .ok());
+    EXPECT_EQ(reqs, kExpected) << "split at " << i;
+  }
+
+  // 每次只有一个字节
+  ReqParser parser;
+  vector<Req> reqs;
+  for (char ch : kPipeline) {
+    ASSERT_TRUE(parser.Parse(Recv(&ch, 1), reqs).ok());
+  }
+  EXPECT_EQ(reqs, kExpected);
+}
+
+TEST(TestParser, Ownership) {
+  auto pool = BufPool::New(1);
+  const string data =
+      "*2\r\n$3\r\nGET\r\n$3\r\nkey\r\n"
+      "*2\r\n$3\r\nGET\r\n$3\r\nk";
+  ReqParser parser;
+  vector<Req> reqs;
+  {
+    auto buf = pool->Get(data.size());
+    memcpy(buf.data(), data.data(), data.size());
+    ASSERT_TRUE(parser.Parse(Slice(buf, 0, data.size()), reqs).ok());
+    ASSERT_EQ(reqs.size(), 1);
+    // 完整的请求直接引用接收缓冲区
+    EXPECT_EQ(reqs[0][1].data(), buf.data() + data.find("key"));
+  }
+  // 完整的请求持有接收缓冲区
+  EXPECT_EQ(pool->free_size(), 0);
+  reqs.clear();
+  // 不完整的请求已经复制了所需的数据，不再持有接收缓冲区
+  EXPECT_EQ(pool->free_size(), 1);
+
+  ASSERT_TRUE(parser.Parse(Recv("ey\r\n"), reqs).ok());
+  ASSERT_EQ(reqs.size(), 1);
+  EXPECT_EQ(reqs[0], Req({"GET", "key"}));
+}
+
+TEST(TestParser, Inline) {
+  const vector<std::pair<string, Req>> cases = {
+      {"PING\r\n", {"PING"}},
+      {"  GET \t key  \n", {"GET", "key"}},
+      {"SET k \"\"\r\n", {"SET", "k", ""}},
+      {"SET k \"a\\x41\\n\\\"\\\\\"\r\n", {"SET", "k", "aA\n\"\\"}},
+      {"SET k 'a\\n'\r\n", {"SET", "k", "a\\n"}},
+      {"SET a\"b c\" d\r\n", {"SET", "ab c", "d"}},
+  };
+  for (const auto& [data, expected] : cases) {
+    ReqParser parser;
+    vector<Req> reqs;
+    ASSERT_TRUE(parser.Parse(Recv(data), reqs).ok()) << data;
+    ASSERT_EQ(reqs.size(), 1) << data;
+    EXPECT_EQ(reqs[0], expected) << data;
+  }
+
+  // 不包含引号的内联请求的参数直接引用接收的数据
+  ReqParser parser;
+  vector<Req> reqs;
+  auto buf = Recv("GET key\r\n");
+  ASSERT_TRUE(parser.Parse(buf, reqs).ok());
+  ASSERT_EQ(reqs.size(), 1);
+  EXPECT_EQ(reqs[0][1].data(), buf.data() + 4);
+}
+
+TEST(TestParser, BadReq) {
+  const vector<string> bad = {
+      "*1\r\n+OK\r\n",                 // 元素不是 bulk string
+      "*x\r\n",                        // 长度不是数字
+      "*1\n$4\r\n",                    // 缺少 '\r'
+      "*\r\n",                         // 缺少长度
+      "*1\r\n$3\r\nGETX\r\n",          // 数据比长度长
+      "*1\r\n$65536\r\n",              // 字符串过长
+      "*99999999999999999999999\r\n",  // 数组过长
+      "*" + string(ReqParser::kMaxHeaderLen, '1'),  // 头部过长
+      "GET \"key\r\n",                             // 引号不匹配
+      "GET \"k\"ey\r\n",                           // 引号后不是空白
+      "GET 'key\n",                                 // 引号不匹配
+      string(kMaxInlineLen + 2, 'x'),               // 内联请求过长
+  };
+  for (const auto& data : bad) {
+    ReqParser parser;
+    vector<Req> reqs;
+    EXPECT_TRUE(parser.Parse(Recv(data), reqs).error()) << data;
+    EXPECT_TRUE(reqs.empty());
+  }
+}
+
+}  // namespace mydss::server
@@ -0,0 +1,483 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <config.hpp>
+#include <cstring>
+#include <db/inst.hpp>
+#include <memory>
+#include <module/ctx.hpp>
+#include <module/piece.hpp>
+#include <module/req.hpp>
+#include <net/conn.hpp>
+#include <net/loop.hpp>
+#include <server/server.hpp>
+#include <server/session.hpp>
+#include <string>
+#include <thread>
+
+using mydss::db::Inst;
+using mydss::module::ArrayPiece;
+using mydss::module::AttributePiece;
+using mydss::module::BulkStringPiece;
+using mydss::module::Ctx;
+using mydss::module::IntegerPiece;
+using mydss::module::MapPiece;
+using mydss::module::Req;
+using mydss::net::Conn;
+using mydss::net::EndPoint;
+using mydss::net::InetType;
+using mydss::net::Loop;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+
+namespace mydss::server {
+
+static constexpr const char* kPath = "/tmp/mydss_test_server.sock";
+
+static shared_ptr<Server> StartServer(shared_ptr<Loop> loop,
+                                      ClientConfig client,
+                                      ServerConfig config = {}) {
+  Inst::Init(16);
+  config.set_type(InetType::kUnix);
+  config.set_path(kPath);
+  auto server = Server::New(loop, config, client);
+  EXPECT_TRUE(server->Start().ok());
+  return server;
+}
+
+static int ConnectUnix(const char* path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  EXPECT_NE(fd, -1);
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  int ret = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  EXPECT_EQ(ret, 0);
+  return fd;
+}
+
+// 运行事件循环直到 fd 可读或超过 timeout 毫秒，返回读取到的数据，
+// 连接被关闭时返回空字符串
+static string RunUntilReadable(Loop& loop, int fd, uint64_t timeout) {
+  auto deadline = Loop::Now() + timeout;
+  char buf[256];
+  do {
+    loop.RunOnce(10);
+    auto nbytes = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (nbytes >= 0) {
+      return string(buf, nbytes);
+    }
+  } while (Loop::Now() < deadline);
+  return "timeout";
+}
+
+static string Ping(Loop& loop, int fd) {
+  const char ping[] = "*1\r\n$4\r\nPING\r\n";
+  EXPECT_EQ(write(fd, ping, sizeof(ping) - 1), sizeof(ping) - 1);
+  return RunUntilReadable(loop, fd, 1000);
+}
+
+// 发送 req，读取回复直到以 suffix 结尾，连接被关闭或者超时时返回已读取的数据
+static string Request(Loop& loop, int fd, const string& req,
+                      const string& suffix) {
+  EXPECT_EQ(write(fd, req.data(), req.size()), req.size());
+  string resp;
+  while (resp.size() < suffix.size() ||
+         resp.compare(resp.size() - suffix.size(), suffix.size(), suffix) !=
+             0) {
+    auto data = RunUntilReadable(loop, fd, 1000);
+    if (data.empty() || data == "timeout") {
+      break;
+    }
+    resp += data;
+  }
+  return resp;
+}
+
+// 读取 n 字节的数据，连接被关闭或者超时时返回已读取的数据
+static string ReadBytes(Loop& loop, int fd, size_t n, uint64_t timeout) {
+  auto deadline = Loop::Now() + timeout;
+  string result;
+  char buf[64 * 1024];
+  while (result.size() < n && Loop::Now() < deadline) {
+    auto nbytes = recv(fd, buf, std::min(sizeof(buf), n - result.size()),
+                       MSG_DONTWAIT);
+    if (nbytes == 0) {
+      break;
+    }
+    if (nbytes > 0) {
+      result.append(buf, nbytes);
+    } else {
+      loop.RunOnce(10);
+    }
+  }
+  return result;
+}
+
+// 运行事件循环直到会话的数目为 n，超过 timeout 毫秒时返回 false
+static bool WaitLive(Loop& loop, size_t n, uint64_t timeout) {
+  auto deadline = Loop::Now() + timeout;
+  while (Session::live() != n) {
+    if (Loop::Now() >= deadline) {
+      return false;
+    }
+    loop.RunOnce(10);
+  }
+  return true;
+}
+
+// 以 RESP 数组编码的 SET key value
+static string SetReq(const string& key, const string& value) {
+  return fmt::format("*3\r\n$3\r\nSET\r\n${}\r\n{}\r\n${}\r\n{}\r\n",
+                     key.size(), key, value.size(), value);
+}
+
+// 重复 n 次 GET key
+static string GetReqs(const string& key, int n) {
+  string result;
+  for (int i = 0; i < n; i++) {
+    result += fmt::format("*2\r\n$3\r\nGET\r\n${}\r\n{}\r\n", key.size(), key);
+  }
+  return result;
+}
+
+TEST(TestServer, MaxClients) {
+  auto loop = Loop::New();
+  ClientConfig client;
+  client.set_max_clients(Session::live() + 2);
+  auto server = StartServer(loop, client);
+
+  int a = ConnectUnix(kPath);
+  int b = ConnectUnix(kPath);
+  EXPECT_EQ(Ping(*loop, a), "+PONG\r\n");
+  EXPECT_EQ(Ping(*loop, b), "+PONG\r\n");
+
+  // 超出上限的连接收到错误回复后被关闭
+  int c = ConnectUnix(kPath);
+  EXPECT_EQ(RunUntilReadable(*loop, c, 1000),
+            "-ERR max number of clients reached\r\n");
+  EXPECT_EQ(RunUntilReadable(*loop, c, 1000), "");
+  close(c);
+
+  // 已有的客户端断开后可以接受新的连接
+  close(a);
+  auto deadline = Loop::Now() + 1000;
+  while (Session::live() >= client.max_clients() && Loop::Now() < deadline) {
+    loop->RunOnce(10);
+  }
+  int d = ConnectUnix(kPath);
+  EXPECT_EQ(Ping(*loop, d), "+PONG\r\n");
+
+  close(b);
+  close(d);
+  server->Stop();
+  unlink(kPath);
+}
+
+TEST(TestServer, IdleTimeout) {
+  auto loop = Loop::New();
+  ClientConfig client;
+  client.set_timeout(1);
+  auto server = StartServer(loop, client);
+
+  int idle = ConnectUnix(kPath);
+  int active = ConnectUnix(kPath);
+  auto start = Loop::Now();
+  // 空闲的客户端在 1 到 2 秒之间被断开，持续发送请求的客户端不会被断开
+  string idle_resp = "timeout";
+  for (int i = 0; i < 10 && idle_resp == "timeout"; i++) {
+    EXPECT_EQ(Ping(*loop, active), "+PONG\r\n");
+    idle_resp = RunUntilReadable(*loop, idle, 300);
+  }
+  auto elapsed = Loop::Now() - start;
+  EXPECT_EQ(idle_resp, "");
+  EXPECT_GE(elapsed, 1000);
+  EXPECT_LE(elapsed, 2500);
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(Ping(*loop, active), "+PONG\r\n");
+    RunUntilReadable(*loop, active, 300);
+  }
+
+  close(idle);
+  close(active);
+  server->Stop();
+  unlink(kPath);
+}
+
+TEST(TestServer, OutputLimit) {
+  auto loop = Loop::New();
+  ServerConfig config;
+  // 较小的发送缓冲区使回复主要积压在输出缓冲区中
+  config.sock_opts().sndbuf = 4096;
+  config.output_limit().hard = 192 * 1024;
+  config.output_limit().soft = 64 * 1024;
+  config.output_limit().soft_seconds = 1;
+  auto server = StartServer(loop, {}, config);
+
+  const string value(32 * 1024, 'v');
+  const string reply = fmt::format("${}\r\n{}\r\n", value.size(), value);
+  int writer = ConnectUnix(kPath);
+  EXPECT_EQ(Request(*loop, writer, SetReq("key", value), "\r\n"), "+OK\r\n");
+  const size_t live = Session::live();
+
+  // 不读取回复的客户端在输出缓冲区超过硬限制时立即被断开
+  int hard = ConnectUnix(kPath);
+  EXPECT_TRUE(WaitLive(*loop, live + 1, 1000));
+  auto start = Loop::Now();
+  auto reqs = GetReqs("key", 16);
+  EXPECT_EQ(write(hard, reqs.data(), reqs.size()), reqs.size());
+  EXPECT_TRUE(WaitLive(*loop, live, 1000));
+  EXPECT_LT(Loop::Now() - start, 500);
+  close(hard);
+
+  // 有多个回复的命令在执行过程中超过硬限制时，会话被断开，之后的回复被丢弃
+  int mget = ConnectUnix(kPath);
+  EXPECT_TRUE(WaitLive(*loop, live + 1, 1000));
+  reqs.clear();
+  for (int i = 0; i < 16; i++) {
+    reqs += "*5\r\n$4\r\nMGET\r\n$3\r\nkey\r\n$3\r\nkey\r\n$3\r\nkey\r\n"
+            "$3\r\nkey\r\n";
+  }
+  EXPECT_EQ(write(mget, reqs.data(), reqs.size()), reqs.size());
+  EXPECT_TRUE(WaitLive(*loop, live, 1000));
+  close(mget);
+
+  // 输出缓冲区持续超过软限制 soft_seconds 秒后被断开
+  int soft = ConnectUnix(kPath);
+  EXPECT_TRUE(WaitLive(*loop, live + 1, 1000));
+  start = Loop::Now();
+  reqs = GetReqs("key", 4);
+  EXPECT_EQ(write(soft, reqs.data(), reqs.size()), reqs.size());
+  EXPECT_FALSE(WaitLive(*loop, live, 500));
+  EXPECT_TRUE(WaitLive(*loop, live, 2000));
+  EXPECT_GE(Loop::Now() - start, 1000);
+  close(soft);
+
+  // 在软限制到期前读取回复的客户端不会被断开
+  int drain = ConnectUnix(kPath);
+  EXPECT_TRUE(WaitLive(*loop, live + 1, 1000));
+  EXPECT_EQ(write(drain, reqs.data(), reqs.size()), reqs.size());
+  EXPECT_FALSE(WaitLive(*loop, live, 200));
+  EXPECT_EQ(ReadBytes(*loop, drain, reply.size() * 4, 1000).size(),
+            reply.size() * 4);
+  EXPECT_FALSE(WaitLive(*loop, live, 1500));
+  EXPECT_EQ(Ping(*loop, drain), "+PONG\r\n");
+
+  close(writer);
+  close(drain);
+  server->Stop();
+  unlink(kPath);
+}
+
+TEST(TestServer, RecvError) {
+  auto loop = Loop::New();
+  // 向没有监听的端口发送数据报后，已连接的 UDP 套接字上的 read 返回
+  // ECONNREFUSED，用于模拟 keepalive 探测失败等 EOF 以外的接收错误
+  int closed = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  ASSERT_EQ(bind(closed, reinterpret_cast<sockaddr*>(&addr), len), 0);
+  ASSERT_EQ(getsockname(closed, reinterpret_cast<sockaddr*>(&addr), &len), 0);
+  close(closed);
+  int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  ASSERT_EQ(connect(sock, reinterpret_cast<sockaddr*>(&addr), len), 0);
+  ASSERT_EQ(send(sock, "x", 1, 0), 1);
+
+  auto conn = Conn::New();
+  conn->Connect(sock, EndPoint());
+  ASSERT_TRUE(conn->Attach(loop).ok());
+  const size_t live = Session::live();
+  auto session = Session::New(conn);
+
+  // 只关闭该会话，进程继续运行
+  EXPECT_TRUE(WaitLive(*loop, live, 1000));
+  EXPECT_TRUE(session->closed());
+}
+
+TEST(TestServer, ZerocopyGet) {
+  Inst::Init(16);
+  auto loop = Loop::New();
+  // Unix 域套接字不支持零拷贝发送，因此通过回环接口连接
+  ServerConfig config;
+  config.set_type(InetType::kIPv4);
+  config.set_ip("127.0.0.1");
+  config.set_port(0);
+  config.set_zerocopy_threshold(16 * 1024);
+  auto server = Server::New(loop, config, {});
+  ASSERT_TRUE(server->Start().ok());
+  sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  ASSERT_EQ(
+      getsockname(server->listen_fd(), reinterpret_cast<sockaddr*>(&addr), &len),
+      0);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&addr), len), 0);
+
+  string value(60 * 1024, '\0');
+  for (size_t i = 0; i < value.size(); i++) {
+    value[i] = static_cast<char>('a' + i % 26);
+  }
+  const string reply = fmt::format("${}\r\n{}\r\n", value.size(), value);
+  EXPECT_EQ(Request(*loop, fd, SetReq("key", value), "\r\n"), "+OK\r\n");
+
+  // 第一次回复的值以零拷贝发送，完成通知到达后回环接口上的连接回退为普通的
+  // 发送，之后的回复同样完整
+  auto reqs = GetReqs("key", 1);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(write(fd, reqs.data(), reqs.size()), reqs.size());
+    EXPECT_TRUE(ReadBytes(*loop, fd, reply.size(), 1000) == reply) << i;
+    // 等待完成通知
+    loop->RunOnce(10);
+  }
+  EXPECT_EQ(Ping(*loop, fd), "+PONG\r\n");
+
+  close(fd);
+  server->Stop();
+}
+
+TEST(TestServer, Resp3) {
+  auto loop = Loop::New();
+  auto server = StartServer(loop, {});
+  int fd = ConnectUnix(kPath);
+  const string get = "*2\r\n$3\r\nGET\r\n$7\r\nmissing\r\n";
+  const string modules = "$7\r\nmodules\r\n*0\r\n";
+
+  EXPECT_EQ(Request(*loop, fd, get, "\r\n"), "$-1\r\n");
+
+  // 切换到 RESP3 后回复使用 RESP3 的类型
+  auto resp = Request(*loop, fd, "*2\r\n$5\r\nHELLO\r\n$1\r\n3\r\n", modules);
+  EXPECT_EQ(resp.rfind("%7\r\n$6\r\nserver\r\n$5\r\nmydss\r\n", 0), 0)
+      << resp;
+  EXPECT_NE(resp.find("$5\r\nproto\r\n:3\r\n"), string::npos) << resp;
+  EXPECT_EQ(Request(*loop, fd, get, "\r\n"), "_\r\n");
+
+  // 不支持的版本不改变协议
+  EXPECT_EQ(Request(*loop, fd, "*2\r\n$5\r\nHELLO\r\n$1\r\n4\r\n", "\r\n"),
+            "-NOPROTO unsupported protocol version\r\n");
+  EXPECT_EQ(Request(*loop, fd, get, "\r\n"), "_\r\n");
+
+  // 切换回 RESP2 时 map 被展开为数组
+  resp = Request(*loop, fd,
+                 "*4\r\n$5\r\nHELLO\r\n$1\r\n2\r\n$7\r\nSETNAME\r\n$1\r\nx\r\n",
+                 modules);
+  EXPECT_EQ(resp.rfind("*14\r\n", 0), 0) << resp;
+  EXPECT_EQ(Request(*loop, fd, get, "\r\n"), "$-1\r\n");
+  EXPECT_EQ(Request(*loop, fd, "*2\r\n$6\r\nCLIENT\r\n$7\r\nGETNAME\r\n",
+                    "\r\nx\r\n"),
+            "$1\r\nx\r\n");
+
+  // 属性及其所有的键和值只在 RESP3 中回复
+  Inst::GetInst()->RegisterCmd("ATTR", [](Ctx& ctx, const Req&) {
+    ctx.Reply(make_shared<AttributePiece>(1));
+    ctx.Reply(make_shared<BulkStringPiece>("keys"));
+    ctx.Reply(make_shared<ArrayPiece>(2));
+    ctx.Reply(make_shared<BulkStringPiece>("a"));
+    ctx.Reply(make_shared<MapPiece>(1));
+    ctx.Reply(make_shared<BulkStringPiece>("b"));
+    ctx.Reply(make_shared<IntegerPiece>(1));
+    ctx.Reply(make_shared<BulkStringPiece>("v"));
+  });
+  EXPECT_EQ(Request(*loop, fd, "*1\r\n$4\r\nATTR\r\n", "$1\r\nv\r\n"),
+            "$1\r\nv\r\n");
+  EXPECT_EQ(Request(*loop, fd, get, "\r\n"), "$-1\r\n");
+  Request(*loop, fd, "*2\r\n$5\r\nHELLO\r\n$1\r\n3\r\n", modules);
+  EXPECT_EQ(Request(*loop, fd, "*1\r\n$4\r\nATTR\r\n", "$1\r\nv\r\n"),
+            "|1\r\n$4\r\nkeys\r\n*2\r\n$1\r\na\r\n%1\r\n$1\r\nb\r\n:1\r\n"
+            "$1\r\nv\r\n");
+
+  close(fd);
+  server->Stop();
+  unlink(kPath);
+}
+
+TEST(TestServer, Inline) {
+  auto loop = Loop::New();
+  auto server = StartServer(loop, {});
+  int fd = ConnectUnix(kPath);
+
+  EXPECT_EQ(Request(*loop, fd, "PING\r\n", "\r\n"), "+PONG\r\n");
+  EXPECT_EQ(Request(*loop, fd, "ping\n", "\r\n"), "+PONG\r\n");
+  // 带参数的 PING 仍然由命令表处理
+  EXPECT_EQ(Request(*loop, fd, "PING \"a b\"\r\n", "\r\n"), "$3\r\na b\r\n");
+  EXPECT_EQ(Request(*loop, fd, "GET missing\r\n", "\r\n"), "$-1\r\n");
+  // 内联命令与 RESP 数组可以混合在同一段流水线中
+  EXPECT_EQ(Request(*loop, fd, "PING\r\n*1\r\n$4\r\nPING\r\nPING\r\n",
+                    "+PONG\r\n+PONG\r\n+PONG\r\n"),
+            "+PONG\r\n+PONG\r\n+PONG\r\n");
+
+  close(fd);
+  server->Stop();
+  unlink(kPath);
+}
+
+TEST(TestServer, ThreadedIo) {
+  // 命令在另一个线程中执行，回复交回会话所在的线程发送
+  auto executor = Loop::New();
+  Session::SetExecutor(executor);
+  std::thread([executor] { executor->Run(); }).detach();
+
+  auto loop = Loop::New();
+  auto server = StartServer(loop, {});
+  int fd = ConnectUnix(kPath);
+  string reqs =
+      "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$1\r\nv\r\n"
+      "*2\r\n$3\r\nGET\r\n$1\r\nk\r\n"
+      "*3\r\n$6\r\nCLIENT\r\n$7\r\nSETNAME\r\n$1\r\nx\r\n"
+      "*2\r\n$6\r\nCLIENT\r\n$7\r\nGETNAME\r\n"
+      "*2\r\n$3\r\nGET\r\n$1\r\nx\r\n"
+      // 同一批请求中 HELLO 之前的回复仍然使用 RESP2
+      "*2\r\n$5\r\nHELLO\r\n$1\r\n3\r\n"
+      "*2\r\n$3\r\nGET\r\n$1\r\nx\r\n"
+      "*1\r\n$4\r\nQUIT\r\n"
+      "*1\r\n$4\r\nPING\r\n";
+  ASSERT_EQ(write(fd, reqs.data(), reqs.size()), reqs.size());
+
+  // QUIT 之后的请求不会被执行
+  string resp;
+  for (;;) {
+    auto data = RunUntilReadable(*loop, fd, 1000);
+    if (data.empty() || data == "timeout") {
+      EXPECT_EQ(data, "");
+      break;
+    }
+    resp += data;
+  }
+  const string before = "+OK\r\n$1\r\nv\r\n+OK\r\n$1\r\nx\r\n$-1\r\n%7\r\n";
+  const string after = "$7\r\nmodules\r\n*0\r\n_\r\n+OK\r\n";
+  ASSERT_GE(resp.size(), before.size() + after.size()) << resp;
+  EXPECT_EQ(resp.substr(0, before.size()), before);
+  EXPECT_EQ(resp.substr(resp.size() - after.size()), after);
+
+  close(fd);
+  server->Stop();
+  Session::SetExecutor(nullptr);
+  unlink(kPath);
+}
+
+}  // namespace mydss::server
@@ -0,0 +1,94 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <util/scan.hpp>
+
+using std::string;
+using std::to_string;
+
+namespace mydss::util {
+
+// 对当前 CPU 支持的每个指令集执行 test
+template <typename Test>
+static void ForEachIsa(Test test) {
+  for (auto isa : {Isa::kScalar, Isa::kSse, Isa::kAvx2}) {
+    if (!SetScanIsa(isa)) {
+      continue;
+    }
+    SCOPED_TRACE(IsaName(isa));
+    test();
+  }
+  ASSERT_TRUE(SetScanIsa(DetectIsa()));
+}
+
+TEST(TestScan, FindCrlf) {
+  ForEachIsa([] {
+    // "\r\n" 出现在各种长度的数据中的每个位置，包括跨越向量边界的位置
+    for (size_t len = 2; len <= 200; len++) {
+      for (size_t pos = 0; pos + 2 <= len; pos++) {
+        string data(len, 'x');
+        // 单独的 '\r' 和 '\n' 不是行尾
+        data[0] = '\n';
+        if (pos > 0) {
+          data[pos - 1] = '\r';
+        }
+        data.replace(pos, 2, "\r\n");
+        auto end = data.data() + data.size();
+        ASSERT_EQ(FindCrlf(data.data(), end), data.data() + pos)
+            << "len=" << len << " pos=" << pos;
+        // 不包括 '\n' 时找不到
+        ASSERT_EQ(FindCrlf(data.data(), data.data() + pos + 1), nullptr);
+      }
+    }
+    string empty;
+    EXPECT_EQ(FindCrlf(empty.data(), empty.data()), nullptr);
+  });
+}
+
+TEST(TestScan, ParseDec) {
+  ForEachIsa([] {
+    uint64_t value = 1;
+    for (size_t len = 1; len <= 19; len++) {
+      string digits = to_string(value);
+      ASSERT_EQ(digits.size(), len);
+      uint64_t result = 0;
+      ASSERT_TRUE(ParseDec(digits.data(), digits.size(), result));
+      EXPECT_EQ(result, value);
+
+      // 最大的 len 位数
+      string nines(len, '9');
+      ASSERT_TRUE(ParseDec(nines.data(), nines.size(), result));
+      EXPECT_EQ(to_string(result), nines);
+
+      // 每个位置上的非数字字符
+      for (size_t i = 0; i < len; i++) {
+        for (char ch : {'/', ':', '-', ' ', '\r', '\xff'}) {
+          string bad = nines;
+          bad[i] = ch;
+          EXPECT_FALSE(ParseDec(bad.data(), bad.size(), result));
+        }
+      }
+      value = value * 10 + len % 10;
+    }
+
+    uint64_t result = 1;
+    ASSERT_TRUE(ParseDec("0000", 4, result));
+    EXPECT_EQ(result, 0);
+  });
+}
+
+}  // namespace mydss::util
@@ -0,0 +1,61 @@
+// Copyright 2022 Vincil Lau
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <time.h>
+
+#include <thread>
+#include <util/thread.hpp>
+
+namespace mydss::util {
+
+// 调用线程的 CPU 时间，单位为毫秒
+static uint64_t ThreadCpuMs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+TEST(TestThread, PinAndUsage) {
+  std::thread([] {
+    ASSERT_TRUE(PinThread(0).ok());
+    RegisterThread("test-pinned");
+    // 消耗至少 50 毫秒的 CPU 时间，CPU 时间的精度为时钟周期，一般为 10 毫秒
+    // 按线程的 CPU 时间而不是经过的时间计时，使机器繁忙时结果仍然稳定
+    volatile uint64_t sum = 0;
+    while (ThreadCpuMs() < 50) {
+      sum = sum + 1;
+    }
+
+    bool found = false;
+    for (const auto& usage : GetThreadUsage()) {
+      if (usage.name != "test-pinned") {
+        continue;
+      }
+      found = true;
+      EXPECT_EQ(usage.tid, gettid());
+      EXPECT_EQ(usage.cpu, 0);
+      EXPECT_EQ(usage.affinity, "0");
+      EXPECT_GT(usage.user + usage.sys, 0);
+    }
+    EXPECT_TRUE(found);
+  }).join();
+
+  // 已经退出的线程不再出现
+  for (const auto& usage : GetThreadUsage()) {
+    EXPECT_NE(usage.name, "test-pinned");
+  }
+}
+
+}  // namespace mydss::util
@@ -18,4 +18,9 @@ target("test_main")
     add_files("test_main.cpp")
     add_packages("gtest", "spdlog")
 
+includes("db")
 includes("err")
+includes("module")
+includes("net")
+includes("server")
+includes("util")
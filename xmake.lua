@@ -34,6 +34,7 @@ target("mydss")
 
     add_deps("mydss_")
     add_links("mydss_")
+    add_syslinks("pthread")
     add_packages("fmt", "nlohmann_json", "spdlog")
 
 target("mydss_")
@@ -53,4 +54,5 @@ target("mydss_")
 
     add_packages("fmt", "nlohmann_json", "spdlog")
 
+includes("bench")
 includes("test")